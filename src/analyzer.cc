@@ -0,0 +1,418 @@
+#include "analyzer.h"
+#include "node.h"
+#include "macro_analyzer.h"
+#include "object_management.h"
+#include "object.h"
+#include "environment.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <unordered_map>
+#include <string>
+#include <algorithm>
+
+namespace ajimu {
+namespace vm {
+
+using values::ObjectManagement;
+using values::Object;
+
+//
+// Lexical scope in analyzing, for local syntax definitions and parameters
+// shadowing.
+//
+class Analyzer::Scope {
+public:
+	Scope(Analyzer *owns, Object *params)
+		: owns_(owns)
+		, outer_(owns->scope_)
+		, params_(params)
+		, expanded_(owns->obm_->Constant(values::kEmptyList)) {
+		owns_->scope_ = this;
+	}
+
+	~Scope() {
+		owns_->scope_ = outer_;
+	}
+
+	Scope *Outer() const { return outer_; }
+
+	bool Binds(const Object *name) const {
+		for (Object *i = params_; !owns_->obm_->Null(i); i = cdr(i)) {
+			if (car(i) == name)
+				return true;
+		}
+		return false;
+	}
+
+	Object *Syntax(const Object *name) const {
+		auto iter = syntax_.find(name->Symbol());
+		return iter == syntax_.end() ? nullptr : iter->second;
+	}
+
+	void DefineSyntax(const Object *name, Object *syntax) {
+		syntax_[name->Symbol()] = syntax;
+	}
+
+	// The expansions must be reachable as long as the nodes refer to them,
+	// but the source can not be touched: it may be the quoted data.
+	Object *Expanded() const { return expanded_; }
+
+	void Keep(Object *expanded) {
+		expanded_ = owns_->obm_->Cons(expanded, expanded_);
+	}
+
+private:
+	Scope(const Scope &) = delete;
+	void operator = (const Scope &) = delete;
+
+	Analyzer *owns_;
+	Scope *outer_;
+	Object *params_;
+	Object *expanded_;
+	std::unordered_map<std::string, Object*> syntax_;
+}; // class Analyzer::Scope
+
+#define Kof(i) obm_->Constant(::ajimu::values::k##i)
+inline bool IsSelfEvaluating(Object *expr) {
+	switch (Object::TypeOf(expr)) {
+	case values::BOOLEAN:
+	case values::FIXED:
+	case values::REAL:
+	case values::CHARACTER:
+	case values::STRING:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+Node *Analyzer::Analyze(Object *expr, Environment *env, Object **expanded) {
+	env_ = env;
+	Scope top(this, Kof(EmptyList));
+	Node *node = AnalyzeExpr(expr);
+	env_ = nullptr;
+	if (expanded)
+		*expanded = top.Expanded();
+	if (node && env == obm_->GlobalEnvironment()) {
+		std::vector<Object*> bound;
+		ResolveGlobals(node, &bound);
+	}
+	return node;
+}
+
+void Analyzer::ResolveGlobals(Node *node, std::vector<Object*> *bound) {
+	switch (node->NodeKind()) {
+	case Node::kVariable: {
+			auto var = static_cast<Variable*>(node);
+			if (std::find(bound->begin(), bound->end(), var->Symbol()) ==
+					bound->end())
+				var->SetGlobal();
+		}
+		break;
+	case Node::kDefinition:
+	case Node::kAssignment:
+		ResolveGlobals(static_cast<Assignment*>(node)->Value(), bound);
+		break;
+	case Node::kIf:
+		ResolveGlobals(static_cast<If*>(node)->Predicate(), bound);
+		ResolveGlobals(static_cast<If*>(node)->Consequent(), bound);
+		ResolveGlobals(static_cast<If*>(node)->Alternative(), bound);
+		break;
+	case Node::kSequence:
+	case Node::kAnd:
+	case Node::kOr:
+		for (auto action : static_cast<Sequence*>(node)->Actions())
+			ResolveGlobals(action, bound);
+		break;
+	case Node::kApplication:
+		ResolveGlobals(static_cast<Application*>(node)->Operator(), bound);
+		for (auto operand : static_cast<Application*>(node)->Operands())
+			ResolveGlobals(operand, bound);
+		break;
+	case Node::kLambda: {
+			auto lambda = static_cast<Lambda*>(node);
+			size_t outer = bound->size();
+			bound->insert(bound->end(), lambda->Names().begin(),
+					lambda->Names().end());
+			ForEachDefinition(lambda->Body(), [bound] (Object *name) {
+				bound->push_back(name);
+			});
+			ResolveGlobals(lambda->Body(), bound);
+			bound->resize(outer);
+		}
+		break;
+	case Node::kConstant:
+	case Node::kSyntaxDefinition:
+		break;
+	}
+}
+
+Node *Analyzer::AnalyzeExpr(Object *expr) {
+	if (!expr || obm_->Null(expr)) {
+		RaiseError("Bad eval! no one can be evaluated.");
+		return nullptr;
+	}
+	if (IsSelfEvaluating(expr))
+		return new Constant(expr);
+	if (Object::IsSymbol(expr))
+		return new Variable(expr);
+	if (!Object::IsPair(expr)) {
+		RaiseError("Bad eval! no one can be evaluated.");
+		return nullptr;
+	}
+	// The special forms take it apart by car and cdr, check its shape first.
+	int length = ListLength(expr);
+	if (length < 0) {
+		RaiseError("Bad expression, it is not a list.");
+		return nullptr;
+	}
+
+	Object *tag = car(expr);
+	if (Object::IsSymbol(tag)) {
+		if (tag == Kof(QuoteSymbol)) {
+			if (length != 2) {
+				RaiseError("Bad quote, need one datum.");
+				return nullptr;
+			}
+			return new Constant(cadr(expr)); // Text of quotation
+		}
+		if (tag == Kof(DefineSymbol))
+			return AnalyzeDefinition(expr, length);
+		if (tag == Kof(LambdaSymbol)) {
+			if (length < 3) {
+				RaiseError("Bad lambda, need parameters and body.");
+				return nullptr;
+			}
+			return AnalyzeLambda(cadr(expr), cddr(expr));
+		}
+		if (tag == Kof(SetSymbol))
+			return AnalyzeAssignment(expr, length);
+		if (tag == Kof(IfSymbol))
+			return AnalyzeIf(expr, length);
+		if (tag == Kof(AndSymbol))
+			return AnalyzeSequence(cdr(expr), Node::kAnd);
+		if (tag == Kof(OrSymbol))
+			return AnalyzeSequence(cdr(expr), Node::kOr);
+		if (tag == Kof(BeginSymbol))
+			return AnalyzeSequence(cdr(expr), Node::kSequence);
+		if (tag == Kof(DefineSyntax))
+			return AnalyzeSyntaxDefinition(expr, length);
+
+		Object *syntax = LookupSyntax(tag);
+		if (syntax)
+			return AnalyzeSyntax(syntax, expr);
+	}
+	return AnalyzeApplication(expr);
+}
+
+Node *Analyzer::AnalyzeDefinition(Object *expr, int length) {
+	if (length < 3) {
+		RaiseError("Bad definition, need name and value.");
+		return nullptr;
+	}
+	Object *var;
+	Node *val;
+	if (Object::IsSymbol(cadr(expr))) {
+		if (length != 3) {
+			RaiseError("Bad definition, need only one value.");
+			return nullptr;
+		}
+		var = cadr(expr);
+		val = AnalyzeExpr(caddr(expr));
+	} else {
+		// (define (name params ...) body ...)
+		if (obm_->Null(cadr(expr)) || !Object::IsPair(cadr(expr)) ||
+				!Object::IsSymbol(caadr(expr))) {
+			RaiseError("Bad definition, need name.");
+			return nullptr;
+		}
+		var = caadr(expr);
+		val = AnalyzeLambda(cdadr(expr), cddr(expr));
+	}
+	if (!val)
+		return nullptr;
+	return new Assignment(Node::kDefinition, var, val);
+}
+
+Node *Analyzer::AnalyzeAssignment(Object *expr, int length) {
+	if (length != 3) {
+		RaiseError("set! : Need variable and value.");
+		return nullptr;
+	}
+	Object *var = cadr(expr); // cadr: assignment variable
+	if (!Object::IsSymbol(var)) {
+		RaiseError("set! : Unexpected symbol.");
+		return nullptr;
+	}
+	Node *val = AnalyzeExpr(caddr(expr)); // caddr: assignment values
+	if (!val)
+		return nullptr;
+	return new Assignment(Node::kAssignment, var, val);
+}
+
+Node *Analyzer::AnalyzeSyntaxDefinition(Object *expr, int length) {
+	if (length != 3) {
+		RaiseError("Bad syntax definition, need name and rules.");
+		return nullptr;
+	}
+	Object *name = cadr(expr);
+	if (!Object::IsSymbol(name)) {
+		RaiseError("Bad syntax definition, need name.");
+		return nullptr;
+	}
+	// Make it visible for the rest expressions in this scope.
+	scope_->DefineSyntax(name, expr);
+	return new SyntaxDefinition(name, expr);
+}
+
+Node *Analyzer::AnalyzeIf(Object *expr, int length) {
+	if (length != 3 && length != 4) {
+		RaiseError("Bad if, need predicate and consequent.");
+		return nullptr;
+	}
+	Node *predicate = AnalyzeExpr(cadr(expr)); // cadr: if predicate
+	if (!predicate)
+		return nullptr;
+	Node *consequent = AnalyzeExpr(caddr(expr)); // caddr: consequent
+	if (!consequent) {
+		predicate->Unref();
+		return nullptr;
+	}
+	Node *alternative = cdddr(expr) == Kof(EmptyList) ?
+		new Constant(Kof(False)) : AnalyzeExpr(cadddr(expr));
+	if (!alternative) {
+		predicate->Unref();
+		consequent->Unref();
+		return nullptr;
+	}
+	return new If(predicate, consequent, alternative);
+}
+
+Node *Analyzer::AnalyzeLambda(Object *params, Object *body) {
+	std::vector<Object*> names;
+	for (Object *i = params; i != Kof(EmptyList); i = cdr(i)) {
+		if (!Object::IsPair(i) || !Object::IsSymbol(car(i))) {
+			RaiseError("Parameters must be symbol.");
+			return nullptr;
+		}
+		for (Object *k = params; k != i; k = cdr(k)) {
+			if (car(k) == car(i)) {
+				RaiseErrorf("Duplicated parameter \"%s\".",
+						car(i)->Symbol());
+				return nullptr;
+			}
+		}
+		names.push_back(car(i));
+	}
+	if (body == Kof(EmptyList)) {
+		RaiseError("Bad lambda, body can not be empty.");
+		return nullptr;
+	}
+	Scope scope(this, params);
+	Node *seq = AnalyzeSequence(body, Node::kSequence);
+	if (!seq)
+		return nullptr;
+	// The inner lambda node is owned by the outer one.
+	if (scope.Expanded() != Kof(EmptyList))
+		scope.Outer()->Keep(scope.Expanded());
+	return new Lambda(params, std::move(names), body, scope.Expanded(), seq);
+}
+
+Node *Analyzer::AnalyzeSequence(Object *actions, int kind) {
+	if (actions == Kof(EmptyList)) {
+		switch (kind) {
+		case Node::kAnd:
+			return new Constant(Kof(True));
+		case Node::kOr:
+			return new Constant(Kof(False));
+		default:
+			RaiseError("Bad begin block, no any action.");
+			return nullptr;
+		}
+	}
+	Sequence *seq = new Sequence(static_cast<Node::Kind>(kind));
+	while (actions != Kof(EmptyList)) {
+		Node *action = AnalyzeExpr(car(actions));
+		if (!action) {
+			seq->Unref();
+			return nullptr;
+		}
+		seq->Append(action);
+		actions = cdr(actions);
+	}
+	return seq;
+}
+
+Node *Analyzer::AnalyzeApplication(Object *expr) {
+	Node *op = AnalyzeExpr(car(expr)); // car: operator
+	if (!op)
+		return nullptr;
+	Application *app = new Application(op);
+	Object *operands = cdr(expr); // cdr: operands
+	while (operands != Kof(EmptyList)) {
+		Node *operand = AnalyzeExpr(car(operands));
+		if (!operand) {
+			app->Unref();
+			return nullptr;
+		}
+		app->Append(operand);
+		operands = cdr(operands);
+	}
+	return app;
+}
+
+Node *Analyzer::AnalyzeSyntax(Object *syntax, Object *expr) {
+	Object *expanded = macro_->Extend(syntax, expr);
+	if (!expanded) {
+		RaiseErrorf("Bad syntax, no rule matched for \"%s\".",
+				car(expr)->Symbol());
+		return nullptr;
+	}
+	scope_->Keep(expanded);
+	return AnalyzeExpr(expanded);
+}
+
+int Analyzer::ListLength(Object *list) const {
+	int length = 0;
+	while (list != Kof(EmptyList)) {
+		if (!Object::IsPair(list))
+			return -1;
+		list = cdr(list);
+		length++;
+	}
+	return length;
+}
+
+Object *Analyzer::LookupSyntax(Object *name) const {
+	for (Scope *i = scope_; i != nullptr; i = i->Outer()) {
+		Object *syntax = i->Syntax(name);
+		if (syntax)
+			return syntax;
+		if (i->Binds(name))
+			return nullptr; // Shadowed by parameter.
+	}
+	if (!env_)
+		return nullptr;
+	Environment::Handle handle(name->Symbol(), env_);
+	if (!handle.Valid())
+		return nullptr;
+	Object *syntax = handle.Get();
+	if (Object::IsPair(syntax) && car(syntax) == Kof(DefineSyntax))
+		return syntax;
+	return nullptr;
+}
+
+void Analyzer::RaiseErrorf(const char *fmt, ...) {
+	char buf[1024] = {0};
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	RaiseError(buf);
+}
+
+#undef Kof
+} // namespace vm
+} // namespace ajimu
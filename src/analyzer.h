@@ -0,0 +1,92 @@
+#ifndef AJIMU_VM_ANALYZER_H
+#define AJIMU_VM_ANALYZER_H
+
+#include <functional>
+#include <vector>
+
+namespace ajimu {
+namespace values {
+class ObjectManagement;
+class Object;
+} // namespace values
+namespace vm {
+class Node;
+class MacroAnalyzer;
+class Environment;
+
+//
+// Syntax analyzer: Classify the s-expression only once, and make a
+// executable node tree for Mach.
+//
+class Analyzer {
+public:
+	typedef std::function<void (const char *, Analyzer *)> Observer;
+
+	Analyzer(values::ObjectManagement *obm, MacroAnalyzer *macro)
+		: obm_(obm)
+		, macro_(macro)
+		, env_(nullptr)
+		, scope_(nullptr) {
+	}
+
+	void AddObserver(const Observer &fn) {
+		observer_.push_back(fn);
+	}
+
+	// Analyze expression, the macros be looked up in env.
+	// The list of macro expansions out of lambdas be returned in expanded,
+	// the caller keeps it reachable with the node tree.
+	// Return nullptr if has any error.
+	Node *Analyze(values::Object *expr, Environment *env,
+			values::Object **expanded = nullptr);
+
+private:
+	class Scope;
+
+	Analyzer(const Analyzer &) = delete;
+	void operator = (const Analyzer &) = delete;
+
+	Node *AnalyzeExpr(values::Object *expr);
+
+	Node *AnalyzeDefinition(values::Object *expr, int length);
+
+	Node *AnalyzeAssignment(values::Object *expr, int length);
+
+	Node *AnalyzeSyntaxDefinition(values::Object *expr, int length);
+
+	Node *AnalyzeIf(values::Object *expr, int length);
+
+	Node *AnalyzeLambda(values::Object *params, values::Object *body);
+
+	Node *AnalyzeSequence(values::Object *actions, int kind);
+
+	Node *AnalyzeApplication(values::Object *expr);
+
+	Node *AnalyzeSyntax(values::Object *syntax, values::Object *expr);
+
+	values::Object *LookupSyntax(values::Object *name) const;
+
+	// Length of the proper list, or -1 if it is not.
+	int ListLength(values::Object *list) const;
+
+	// Mark the variables not bound by any lambda of toplevel, the names in
+	// bound are bound by the outer lambdas.
+	void ResolveGlobals(Node *node, std::vector<values::Object*> *bound);
+
+	void RaiseError(const char *err) {
+		for (Observer fn : observer_) fn(err, this);
+	}
+
+	void RaiseErrorf(const char *fmt, ...);
+
+	values::ObjectManagement *obm_;
+	MacroAnalyzer *macro_;
+	Environment *env_;
+	Scope *scope_;
+	std::vector<Observer> observer_;
+}; // class Analyzer
+
+} // namespace vm
+} // namespace ajimu
+
+#endif //AJIMU_VM_ANALYZER_H
@@ -0,0 +1,171 @@
+#include "analyzer.h"
+#include "node.h"
+#include "macro_analyzer.h"
+#include "lexer.h"
+#include "environment.h"
+#include "object_management.h"
+#include "gmock/gmock.h"
+
+namespace ajimu {
+namespace vm {
+
+using values::ObjectManagement;
+using values::Object;
+
+class AnalyzerTest : public ::testing::Test {
+protected:
+	virtual void SetUp() override {
+		obm_ = new ObjectManagement();
+		obm_->Init();
+		factory_ = new MacroAnalyzer(obm_);
+		analyzer_ = new Analyzer(obm_, factory_);
+		analyzer_->AddObserver([this] (const char *err, Analyzer *) {
+			printf("error: %s\n", err);
+		});
+		lexer_ = new Lexer(obm_);
+	}
+
+	virtual void TearDown() override {
+		delete lexer_;
+		lexer_ = nullptr;
+		delete analyzer_;
+		analyzer_ = nullptr;
+		delete factory_;
+		factory_ = nullptr;
+		delete obm_;
+		obm_ = nullptr;
+	}
+
+	Object *Read(const char *script) {
+		lexer_->Feed(script, strlen(script));
+		return lexer_->Next();
+	}
+
+	Node *Analyze(const char *script) {
+		return analyzer_->Analyze(Read(script),
+				obm_->GlobalEnvironment());
+	}
+
+	ObjectManagement *obm_;
+	MacroAnalyzer *factory_;
+	Analyzer *analyzer_;
+	Lexer *lexer_;
+};
+
+TEST_F(AnalyzerTest, Sanity) {
+	Node *node = Analyze("1");
+	ASSERT_EQ(Node::kConstant, node->NodeKind());
+	ASSERT_EQ(1, Object::Fixed(static_cast<Constant*>(node)->Value()));
+	node->Unref();
+
+	node = Analyze("'(1 2)");
+	ASSERT_EQ(Node::kConstant, node->NodeKind());
+	ASSERT_TRUE(Object::IsPair(static_cast<Constant*>(node)->Value()));
+	node->Unref();
+
+	node = Analyze("foo");
+	ASSERT_EQ(Node::kVariable, node->NodeKind());
+	ASSERT_STREQ("foo", static_cast<Variable*>(node)->Symbol()->Symbol());
+	node->Unref();
+
+	node = Analyze("(if #t 1)");
+	ASSERT_EQ(Node::kIf, node->NodeKind());
+	ASSERT_EQ(Node::kConstant,
+			static_cast<If*>(node)->Alternative()->NodeKind());
+	node->Unref();
+
+	ASSERT_EQ(nullptr, Analyze("()"));
+}
+
+TEST_F(AnalyzerTest, Lambda) {
+	Node *node = Analyze("(define (foo a b) (+ a b) (* a b))");
+	ASSERT_EQ(Node::kDefinition, node->NodeKind());
+
+	Node *val = static_cast<Assignment*>(node)->Value();
+	ASSERT_EQ(Node::kLambda, val->NodeKind());
+
+	Node *body = static_cast<Lambda*>(val)->Body();
+	ASSERT_EQ(Node::kSequence, body->NodeKind());
+	ASSERT_EQ(2U, static_cast<Sequence*>(body)->Actions().size());
+	node->Unref();
+
+	ASSERT_EQ(nullptr, Analyze("(lambda (a 1) a)"));
+	ASSERT_EQ(nullptr, Analyze("(lambda (a))"));
+	ASSERT_EQ(nullptr, Analyze("(lambda (a b a) a)"));
+	ASSERT_EQ(nullptr, Analyze("(lambda)"));
+	ASSERT_EQ(nullptr, Analyze("(lambda (a . b) a)"));
+}
+
+TEST_F(AnalyzerTest, BadShape) {
+	ASSERT_EQ(nullptr, Analyze("(quote)"));
+	ASSERT_EQ(nullptr, Analyze("(quote 1 2)"));
+	ASSERT_EQ(nullptr, Analyze("(define)"));
+	ASSERT_EQ(nullptr, Analyze("(define a)"));
+	ASSERT_EQ(nullptr, Analyze("(define a 1 2)"));
+	ASSERT_EQ(nullptr, Analyze("(define () 1)"));
+	ASSERT_EQ(nullptr, Analyze("(define (1) 1)"));
+	ASSERT_EQ(nullptr, Analyze("(set!)"));
+	ASSERT_EQ(nullptr, Analyze("(set! a)"));
+	ASSERT_EQ(nullptr, Analyze("(if)"));
+	ASSERT_EQ(nullptr, Analyze("(if #t)"));
+	ASSERT_EQ(nullptr, Analyze("(if #t 1 2 3)"));
+	ASSERT_EQ(nullptr, Analyze("(define-syntax)"));
+	ASSERT_EQ(nullptr, Analyze("(begin 1 . 2)"));
+	ASSERT_EQ(nullptr, Analyze("(+ 1 . 2)"));
+}
+
+TEST_F(AnalyzerTest, GlobalVariable) {
+	Node *node = Analyze("(lambda (a) (define b a) (lambda (c) (+ a b c d)))");
+	ASSERT_EQ(Node::kLambda, node->NodeKind());
+	auto body = static_cast<Sequence*>(static_cast<Lambda*>(node)->Body());
+	auto inner = static_cast<Lambda*>(body->Actions().back());
+	ASSERT_EQ(Node::kLambda, inner->NodeKind());
+	auto app = static_cast<Application*>(
+			static_cast<Sequence*>(inner->Body())->Actions().back());
+	ASSERT_EQ(Node::kApplication, app->NodeKind());
+
+	// + and d are not bound by lambdas.
+	ASSERT_TRUE(static_cast<Variable*>(app->Operator())->Global());
+	const char *kBound[] = { "a", "b", "c" };
+	for (int i = 0; i < 3; ++i) {
+		auto var = static_cast<Variable*>(app->Operands()[i]);
+		ASSERT_STREQ(kBound[i], var->Symbol()->Symbol());
+		ASSERT_FALSE(var->Global());
+	}
+	ASSERT_TRUE(static_cast<Variable*>(app->Operands()[3])->Global());
+	node->Unref();
+
+	// Not in global environment, it may be bound by the frames.
+	Environment env(obm_->GlobalEnvironment());
+	node = analyzer_->Analyze(Read("foo"), &env);
+	ASSERT_EQ(Node::kVariable, node->NodeKind());
+	ASSERT_FALSE(static_cast<Variable*>(node)->Global());
+	node->Unref();
+}
+
+TEST_F(AnalyzerTest, Syntax) {
+	Object *syntax = Read(
+		"(define-syntax when"
+		"	(syntax-rules ()"
+		"		((_ test expr ...)"
+		"			(if test (begin expr ...)))))"
+	);
+	obm_->GlobalEnvironment()->Define("when", syntax);
+
+	Object *expr = Read("(when #t 1 2)");
+	Node *node = analyzer_->Analyze(expr, obm_->GlobalEnvironment());
+	ASSERT_EQ(Node::kIf, node->NodeKind());
+	node->Unref();
+	// The source be not touched by expanding
+	ASSERT_EQ("(when #t 1 2)", Object::ToString(expr, obm_));
+
+	// Shadowed by parameter
+	node = Analyze("(lambda (when) (when 1))");
+	ASSERT_EQ(Node::kLambda, node->NodeKind());
+	ASSERT_EQ(Node::kApplication, static_cast<Sequence*>(
+				static_cast<Lambda*>(node)->Body())->Actions()[0]->NodeKind());
+	node->Unref();
+}
+
+} // namespace vm
+} // namespace ajimu
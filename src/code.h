@@ -0,0 +1,144 @@
+#ifndef AJIMU_VM_CODE_H
+#define AJIMU_VM_CODE_H
+
+#include "glog/logging.h"
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ajimu {
+namespace values {
+class Object;
+} // namespace values
+namespace vm {
+class Lambda;
+
+//
+// Compiled bytecode of a toplevel expression or a lambda body.
+// Instruction format: [ argument : 24 bits ][ opcode : 8 bits ]
+//
+class Code {
+public:
+	enum OpCode {
+		kConstant,         // push constants[a]
+		kLoadLocal,        // push value of slot at address a
+		kLoadName,         // push value of symbol constants[a], search frames
+		kLoadGlobal,       // push value of symbol constants[a] in global
+		kStoreLocal,       // set! slot at address a
+		kStoreName,        // set! symbol constants[a] in frames
+		kStoreGlobal,      // set! symbol constants[a] in global
+		kDefine,           // define symbol constants[a] in current frame
+		kDefineLocal,      // define slot a in current frame
+		kClosure,          // push closure of lambdas[a]
+		kPop,              // drop the top of stack
+		kJump,             // goto a
+		kJumpIfFalse,      // pop, goto a if it's #f
+		kJumpIfFalseOrPop, // goto a if top is #f, or pop it
+		kJumpIfTrueOrPop,  // goto a if top is #t, or pop it
+		kCall,             // call procedure with a arguments
+		kTailCall,         // call procedure with a arguments, reuse frame
+		kReturn,           // return the top of stack
+	};
+
+	enum {
+		MAX_ARGUMENT = (1 << 24) - 1,
+		MAX_DEPTH    = (1 << 8) - 1,
+		MAX_SLOT     = (1 << 16) - 1,
+	};
+
+	Code() {}
+
+	static uint32_t Make(OpCode op, int arg) {
+		DCHECK_GE(arg, 0);
+		DCHECK_LE(arg, MAX_ARGUMENT);
+		return (static_cast<uint32_t>(arg) << 8) | static_cast<uint32_t>(op);
+	}
+
+	static OpCode Op(uint32_t ins) {
+		return static_cast<OpCode>(ins & 0xffU);
+	}
+
+	static int Arg(uint32_t ins) {
+		return static_cast<int>(ins >> 8);
+	}
+
+	// Lexical address of local variable: [ depth : 8 bits ][ slot : 16 bits ]
+	// depth: How many frames up from current frame.
+	// slot:  Index of variable in the frame.
+	static int MakeAddress(int depth, int slot) {
+		DCHECK_LE(depth, MAX_DEPTH);
+		DCHECK_LE(slot, MAX_SLOT);
+		return (depth << 16) | slot;
+	}
+
+	static int Depth(int address) {
+		return address >> 16;
+	}
+
+	static int Slot(int address) {
+		return address & MAX_SLOT;
+	}
+
+	size_t Emit(OpCode op, int arg = 0) {
+		ins_.push_back(Make(op, arg));
+		return ins_.size() - 1;
+	}
+
+	// Fill the argument of a emitted instruction, for forward jumping.
+	void Patch(size_t i, int arg) {
+		ins_[i] = Make(Op(ins_[i]), arg);
+	}
+
+	int AddConstant(values::Object *o) {
+		auto iter = index_.find(o);
+		if (iter != index_.end())
+			return iter->second;
+		constants_.push_back(o);
+		cells_.push_back(-1);
+		index_.insert(std::make_pair(o, constants_.size() - 1));
+		return static_cast<int>(constants_.size() - 1);
+	}
+
+	int AddLambda(Lambda *lambda) {
+		lambdas_.push_back(lambda);
+		return static_cast<int>(lambdas_.size() - 1);
+	}
+
+	// Names of frame slots: parameters first, then the variables defined
+	// in body, so the slots are fixed before running.
+	void AddName(values::Object *symbol) {
+		names_.push_back(symbol);
+	}
+
+	const std::vector<values::Object*> &Names() const { return names_; }
+
+	const uint32_t *Begin() const { return ins_.data(); }
+
+	size_t Size() const { return ins_.size(); }
+
+	uint32_t At(size_t i) const { return ins_[i]; }
+
+	values::Object *ConstantAt(int i) const { return constants_[i]; }
+
+	Lambda *LambdaAt(int i) const { return lambdas_[i]; }
+
+	// Inline cache of the global variable constants[i]: index of its cell
+	// in global environment, -1 if not be resolved.
+	int *CellAt(int i) { return &cells_[i]; }
+
+private:
+	Code(const Code &) = delete;
+	void operator = (const Code &) = delete;
+
+	std::vector<uint32_t> ins_;
+	std::vector<values::Object*> constants_;
+	std::vector<int> cells_; // Caches of constants
+	std::unordered_map<values::Object*, int> index_;
+	std::vector<Lambda*> lambdas_; // Owned by the node tree.
+	std::vector<values::Object*> names_;
+}; // class Code
+
+} // namespace vm
+} // namespace ajimu
+
+#endif //AJIMU_VM_CODE_H
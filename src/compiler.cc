@@ -0,0 +1,220 @@
+#include "compiler.h"
+#include "code.h"
+#include "node.h"
+#include "object_management.h"
+#include "object.h"
+#include <unordered_map>
+#include <vector>
+
+namespace ajimu {
+namespace vm {
+
+using values::ObjectManagement;
+using values::Object;
+
+//
+// Variables bound in a lambda: parameters and internal definitions.
+// The slots are in the same order as the frame be built at calling:
+// parameters first, then the internal definitions.
+//
+class Compiler::Scope {
+public:
+	Scope(Compiler *owns, Lambda *lambda)
+		: owns_(owns)
+		, outer_(owns->scope_) {
+		for (Object *i = lambda->Params(); !owns_->obm_->Null(i);
+				i = cdr(i))
+			Bind(car(i));
+		ForEachDefinition(lambda->Body(), [this] (Object *name) {
+			Bind(name);
+		});
+		owns_->scope_ = this;
+	}
+
+	~Scope() {
+		owns_->scope_ = outer_;
+	}
+
+	Scope *Outer() const { return outer_; }
+
+	// Slot of the name, -1 if not bound in this scope.
+	int SlotOf(Object *name) const {
+		auto iter = index_.find(name);
+		return iter == index_.end() ? -1 : iter->second;
+	}
+
+	void CopyNames(Code *code) const {
+		for (auto name : slots_)
+			code->AddName(name);
+	}
+
+private:
+	Scope(const Scope &) = delete;
+	void operator = (const Scope &) = delete;
+
+	// Redefined name shares one slot, as Environment::Define does.
+	void Bind(Object *name) {
+		if (index_.find(name) != index_.end())
+			return;
+		slots_.push_back(name);
+		index_.insert(std::make_pair(name, slots_.size() - 1));
+	}
+
+	Compiler *owns_;
+	Scope *outer_;
+	std::vector<Object*> slots_;
+	std::unordered_map<Object*, int> index_;
+}; // class Compiler::Scope
+
+Code *Compiler::Compile(Node *node, bool global) {
+	global_ = global;
+	code_ = new Code();
+	CompileNode(node, false);
+	code_->Emit(Code::kReturn);
+
+	Code *code = code_;
+	code_ = nullptr;
+	return code;
+}
+
+void Compiler::CompileNode(Node *node, bool tail) {
+	switch (node->NodeKind()) {
+	case Node::kConstant:
+		code_->Emit(Code::kConstant, code_->AddConstant(
+					static_cast<Constant*>(node)->Value()));
+		break;
+
+	case Node::kVariable:
+		CompileVariable(static_cast<Variable*>(node)->Symbol(),
+				Code::kLoadLocal, Code::kLoadName, Code::kLoadGlobal);
+		break;
+
+	case Node::kAssignment: {
+			auto assign = static_cast<Assignment*>(node);
+			CompileNode(assign->Value(), false);
+			CompileVariable(assign->Symbol(),
+					Code::kStoreLocal, Code::kStoreName, Code::kStoreGlobal);
+		}
+		break;
+
+	case Node::kDefinition: {
+			auto def = static_cast<Assignment*>(node);
+			CompileNode(def->Value(), false);
+			CompileDefinition(def->Symbol());
+		}
+		break;
+
+	case Node::kSyntaxDefinition: {
+			auto def = static_cast<SyntaxDefinition*>(node);
+			code_->Emit(Code::kConstant, code_->AddConstant(def->Syntax()));
+			CompileDefinition(def->Name());
+		}
+		break;
+
+	case Node::kLambda:
+		CompileLambda(static_cast<Lambda*>(node));
+		break;
+
+	case Node::kIf: {
+			auto branch = static_cast<If*>(node);
+			CompileNode(branch->Predicate(), false);
+			size_t alternative = code_->Emit(Code::kJumpIfFalse);
+			CompileNode(branch->Consequent(), tail);
+			if (tail) {
+				// Both branches return by themselves.
+				code_->Patch(alternative, code_->Size());
+				CompileNode(branch->Alternative(), true);
+				return;
+			}
+			size_t end = code_->Emit(Code::kJump);
+			code_->Patch(alternative, code_->Size());
+			CompileNode(branch->Alternative(), false);
+			code_->Patch(end, code_->Size());
+		}
+		break;
+
+	case Node::kSequence:
+	case Node::kAnd:
+	case Node::kOr:
+		CompileSequence(node, tail);
+		return;
+
+	case Node::kApplication: {
+			auto app = static_cast<Application*>(node);
+			CompileNode(app->Operator(), false);
+			for (auto operand : app->Operands())
+				CompileNode(operand, false);
+			code_->Emit(tail ? Code::kTailCall : Code::kCall,
+					static_cast<int>(app->Operands().size()));
+		}
+		return;
+	}
+	if (tail)
+		code_->Emit(Code::kReturn);
+}
+
+void Compiler::CompileVariable(Object *symbol, int local_op, int name_op,
+		int global_op) {
+	int op = global_ ? global_op : name_op;
+	int depth = 0;
+	for (Scope *i = scope_; i != nullptr; i = i->Outer(), ++depth) {
+		int slot = i->SlotOf(symbol);
+		if (slot < 0)
+			continue;
+		if (depth <= Code::MAX_DEPTH && slot <= Code::MAX_SLOT) {
+			code_->Emit(static_cast<Code::OpCode>(local_op),
+					Code::MakeAddress(depth, slot));
+			return;
+		}
+		op = name_op; // Too far to address, lookup it by name.
+		break;
+	}
+	code_->Emit(static_cast<Code::OpCode>(op), code_->AddConstant(symbol));
+}
+
+void Compiler::CompileDefinition(Object *symbol) {
+	int slot = scope_ ? scope_->SlotOf(symbol) : -1;
+	if (slot >= 0 && slot <= Code::MAX_SLOT)
+		code_->Emit(Code::kDefineLocal, slot);
+	else
+		code_->Emit(Code::kDefine, code_->AddConstant(symbol));
+}
+
+void Compiler::CompileSequence(Node *node, bool tail) {
+	auto &actions = static_cast<Sequence*>(node)->Actions();
+	std::vector<size_t> jumps;
+	for (size_t i = 0; i < actions.size() - 1; ++i) {
+		CompileNode(actions[i], false);
+		switch (node->NodeKind()) {
+		case Node::kAnd:
+			jumps.push_back(code_->Emit(Code::kJumpIfFalseOrPop));
+			break;
+		case Node::kOr:
+			jumps.push_back(code_->Emit(Code::kJumpIfTrueOrPop));
+			break;
+		default:
+			code_->Emit(Code::kPop);
+			break;
+		}
+	}
+	CompileNode(actions.back(), tail); // The last one is tail expr.
+	for (auto jump : jumps)
+		code_->Patch(jump, code_->Size());
+	if (tail && !jumps.empty())
+		code_->Emit(Code::kReturn);
+}
+
+void Compiler::CompileLambda(Lambda *lambda) {
+	code_->Emit(Code::kClosure, code_->AddLambda(lambda));
+
+	Code *outer = code_;
+	Scope scope(this, lambda);
+	code_ = new Code();
+	scope.CopyNames(code_);
+	CompileNode(lambda->Body(), true);
+	lambda->SetCode(code_);
+	code_ = outer;
+}
+
+} // namespace vm
+} // namespace ajimu
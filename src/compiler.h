@@ -0,0 +1,60 @@
+#ifndef AJIMU_VM_COMPILER_H
+#define AJIMU_VM_COMPILER_H
+
+namespace ajimu {
+namespace values {
+class ObjectManagement;
+class Object;
+} // namespace values
+namespace vm {
+class Node;
+class Lambda;
+class Code;
+
+//
+// Bytecode compiler: Compile the analyzed node tree to bytecode.
+// Lambdas in the tree be compiled also, the code is owned by the lambda.
+//
+class Compiler {
+public:
+	explicit Compiler(values::ObjectManagement *obm)
+		: obm_(obm)
+		, code_(nullptr)
+		, scope_(nullptr)
+		, global_(true) {
+	}
+
+	// Compile a toplevel expression.
+	// global: Evaluating in global environment, so the variables be not
+	//         bound by any lambda are global variables.
+	Code *Compile(Node *node, bool global);
+
+private:
+	class Scope;
+
+	Compiler(const Compiler &) = delete;
+	void operator = (const Compiler &) = delete;
+
+	void CompileNode(Node *node, bool tail);
+
+	// Resolve the variable to lexical address if it's bound by lambda,
+	// or lookup it by name at runtime.
+	void CompileVariable(values::Object *symbol,
+			int local_op, int name_op, int global_op);
+
+	void CompileDefinition(values::Object *symbol);
+
+	void CompileSequence(Node *node, bool tail);
+
+	void CompileLambda(Lambda *lambda);
+
+	values::ObjectManagement *obm_;
+	Code *code_;
+	Scope *scope_;
+	bool global_;
+}; // class Compiler
+
+} // namespace vm
+} // namespace ajimu
+
+#endif //AJIMU_VM_COMPILER_H
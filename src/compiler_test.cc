@@ -0,0 +1,130 @@
+#include "compiler.h"
+#include "code.h"
+#include "analyzer.h"
+#include "node.h"
+#include "macro_analyzer.h"
+#include "lexer.h"
+#include "object_management.h"
+#include "gmock/gmock.h"
+#include <memory>
+
+namespace ajimu {
+namespace vm {
+
+using values::ObjectManagement;
+using values::Object;
+
+class CompilerTest : public ::testing::Test {
+protected:
+	virtual void SetUp() override {
+		obm_ = new ObjectManagement();
+		obm_->Init();
+		factory_ = new MacroAnalyzer(obm_);
+		analyzer_ = new Analyzer(obm_, factory_);
+		lexer_ = new Lexer(obm_);
+		compiler_ = new Compiler(obm_);
+	}
+
+	virtual void TearDown() override {
+		delete compiler_;
+		compiler_ = nullptr;
+		delete lexer_;
+		lexer_ = nullptr;
+		delete analyzer_;
+		analyzer_ = nullptr;
+		delete factory_;
+		factory_ = nullptr;
+		delete obm_;
+		obm_ = nullptr;
+	}
+
+	Node *Analyze(const char *script) {
+		lexer_->Feed(script, strlen(script));
+		return analyzer_->Analyze(lexer_->Next(),
+				obm_->GlobalEnvironment());
+	}
+
+	ObjectManagement *obm_;
+	MacroAnalyzer *factory_;
+	Analyzer *analyzer_;
+	Lexer *lexer_;
+	Compiler *compiler_;
+};
+
+TEST_F(CompilerTest, Sanity) {
+	Node *node = Analyze("(+ 1 2)");
+	std::unique_ptr<Code> code(compiler_->Compile(node, true));
+	ASSERT_EQ(5U, code->Size());
+	ASSERT_EQ(Code::kLoadGlobal, Code::Op(code->At(0)));
+	ASSERT_EQ(Code::kConstant,   Code::Op(code->At(1)));
+	ASSERT_EQ(Code::kConstant,   Code::Op(code->At(2)));
+	ASSERT_EQ(Code::kCall,       Code::Op(code->At(3)));
+	ASSERT_EQ(2,                 Code::Arg(code->At(3)));
+	ASSERT_EQ(Code::kReturn,     Code::Op(code->At(4)));
+	node->Unref();
+}
+
+TEST_F(CompilerTest, TailCall) {
+	Node *node = Analyze("(lambda (f a) (if a (f a) (f #f)))");
+	std::unique_ptr<Code> code(compiler_->Compile(node, true));
+	ASSERT_EQ(Code::kClosure, Code::Op(code->At(0)));
+
+	Lambda *lambda = code->LambdaAt(Code::Arg(code->At(0)));
+	Code *body = lambda->Code();
+	ASSERT_NE(nullptr, body);
+	// Parameters are local, both branches make tail call.
+	ASSERT_EQ(Code::kLoadLocal,   Code::Op(body->At(0)));
+	ASSERT_EQ(Code::kJumpIfFalse, Code::Op(body->At(1)));
+	ASSERT_EQ(Code::kTailCall,    Code::Op(body->At(4)));
+	ASSERT_EQ(5,                  Code::Arg(body->At(1)));
+	ASSERT_EQ(Code::kTailCall,    Code::Op(body->At(body->Size() - 1)));
+	node->Unref();
+}
+
+TEST_F(CompilerTest, LocalDefinition) {
+	Node *node = Analyze("(lambda (a) (define x 1) x)");
+	std::unique_ptr<Code> code(compiler_->Compile(node, true));
+	Code *body = code->LambdaAt(0)->Code();
+	ASSERT_EQ(2U, body->Names().size());
+	ASSERT_STREQ("a", body->Names()[0]->Symbol());
+	ASSERT_STREQ("x", body->Names()[1]->Symbol());
+
+	ASSERT_EQ(Code::kDefineLocal, Code::Op(body->At(1)));
+	ASSERT_EQ(1,                  Code::Arg(body->At(1)));
+	ASSERT_EQ(Code::kLoadLocal,   Code::Op(body->At(3)));
+	ASSERT_EQ(Code::MakeAddress(0, 1), Code::Arg(body->At(3)));
+	node->Unref();
+}
+
+TEST_F(CompilerTest, LexicalAddress) {
+	Node *node = Analyze("(lambda (a b) (lambda (c) (set! a (+ b c))))");
+	std::unique_ptr<Code> code(compiler_->Compile(node, true));
+	Code *body = code->LambdaAt(0)->Code();
+	ASSERT_EQ(Code::kClosure, Code::Op(body->At(0)));
+
+	Code *inner = code->LambdaAt(0)->Code()->LambdaAt(0)->Code();
+	ASSERT_EQ(Code::kLoadGlobal, Code::Op(inner->At(0))); // +
+	ASSERT_EQ(Code::kLoadLocal,  Code::Op(inner->At(1))); // b
+	ASSERT_EQ(Code::MakeAddress(1, 1), Code::Arg(inner->At(1)));
+	ASSERT_EQ(Code::kLoadLocal,  Code::Op(inner->At(2))); // c
+	ASSERT_EQ(Code::MakeAddress(0, 0), Code::Arg(inner->At(2)));
+	ASSERT_EQ(Code::kStoreLocal, Code::Op(inner->At(4))); // a
+	ASSERT_EQ(Code::MakeAddress(1, 0), Code::Arg(inner->At(4)));
+	node->Unref();
+}
+
+TEST_F(CompilerTest, NameLookup) {
+	// Not global environment, unbound variable be looked up by name.
+	lexer_->Feed("(lambda (a) (+ a b))", 20);
+	Node *node = analyzer_->Analyze(lexer_->Next(),
+			obm_->GlobalEnvironment());
+	std::unique_ptr<Code> code(compiler_->Compile(node, false));
+	Code *body = code->LambdaAt(0)->Code();
+	ASSERT_EQ(Code::kLoadName,  Code::Op(body->At(0)));
+	ASSERT_EQ(Code::kLoadLocal, Code::Op(body->At(1)));
+	ASSERT_EQ(Code::kLoadName,  Code::Op(body->At(2)));
+	node->Unref();
+}
+
+} // namespace vm
+} // namespace ajimu
@@ -0,0 +1,77 @@
+#ifndef AJIMU_VM_CONTINUATION_H
+#define AJIMU_VM_CONTINUATION_H
+
+#include "mach.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+namespace ajimu {
+namespace values {
+class Object;
+} // namespace values
+namespace vm {
+class Code;
+class Environment;
+
+//
+// Captured continuation. It resumes the activation `serial' of the run
+// `run', by resetting the control stack and the stacks of values and
+// environments to their counts, then the value be pushed at pc.
+//
+// The escape-only one keeps only the counts, so capturing is O(1), it is
+// valid until the frame `serial' be popped. The full one copies the
+// stacks of its run from the bases, it can be re-entered after the frame
+// be popped, or out of its run: it be installed into the current run.
+//
+// The tree engine only has the escape-only one, `run' is the catch point.
+//
+struct Continuation {
+	bool full;        // The stacks be copied
+	uint64_t run;     // The run captured it
+	uint64_t serial;  // Serial of the frame to resume
+	size_t depth;     // Index of the frame to resume
+	size_t vals;      // Count of values stack at resuming
+	size_t envs;      // Count of environments stack at resuming
+	Code *code;       // Resume point, owned by a closure in stack
+	const uint32_t *pc;
+	Environment *env;
+	values::Object *winders; // Of dynamic-wind, at capturing
+
+	// Copy of stacks from the bases of run, only for the full one.
+	std::vector<Mach::CallFrame> frames;
+	std::vector<values::Object*> saved_vals;
+	std::vector<Environment*> saved_envs;
+	// The toplevel code of run and its source, the frames may be resumed
+	// after the run.
+	std::shared_ptr<Code> toplevel;
+	values::Object *source;
+	// The full ones be installed into the run, their code be running.
+	values::Object *installed;
+
+	// For gc: Visit all objects and environments be kept.
+	template<class ObjCallback, class EnvCallback>
+	void ForEach(ObjCallback obj_callback, EnvCallback env_callback) const {
+		obj_callback(winders);
+		if (source)
+			obj_callback(source);
+		if (installed)
+			obj_callback(installed);
+		if (env)
+			env_callback(env);
+		for (const auto &frame : frames)
+			env_callback(frame.env);
+		for (auto val : saved_vals) {
+			if (val)
+				obj_callback(val);
+		}
+		for (auto saved : saved_envs)
+			env_callback(saved);
+	}
+}; // struct Continuation
+
+} // namespace vm
+} // namespace ajimu
+
+#endif //AJIMU_VM_CONTINUATION_H
@@ -2,9 +2,13 @@
 #define AJIMU_VM_ENVIRONMENT_H
 
 #include "reachable.h"
+#include "object.h"
 #include "glog/logging.h"
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include <memory>
+#include <new>
 
 namespace ajimu {
 namespace values {
@@ -13,72 +17,156 @@ class Object;
 } // namespace values
 namespace vm {
 
+//
+// Two kinds of environment:
+// Dictionary: Variables be defined by name, for global environment and
+//             the tree engine.
+// Frame:      Fixed slots be allocated with environment in one block, for
+//             closure calling. The names of slots are owned by the code of
+//             closure, so the frame keeps the closure reachable. Variables
+//             defined out of slots (by eval) fall into dictionary.
+//
 class Environment : public values::Reachable {
 public:
 	class Handle;
 
 	Environment(Environment *top) // Only for test
 		: values::Reachable(nullptr, values::Reachable::WHITE_BIT0)
-		, top_(top) {
+		, top_(top)
+		, closure_(nullptr)
+		, names_(nullptr)
+		, size_(0) {
 	}
 
 	Environment(Environment *top, values::Reachable *next, unsigned white)
 		: values::Reachable(next, white)
-		, top_(top) {
+		, top_(top)
+		, closure_(nullptr)
+		, names_(nullptr)
+		, size_(0) {
 	}
 
 	~Environment() {}
 
+	// Construct frame and its slots in one block.
+	// chunk: The block, size must be SizeOf(names->size())
+	// names: Names of slots, the size of frame.
+	static Environment *NewFrame(void *chunk, Environment *top,
+			values::Object *closure,
+			const std::vector<values::Object*> *names,
+			values::Reachable *next, unsigned white) {
+		size_t size = names->size();
+		auto env = new (chunk) Environment(top, next, white);
+		env->closure_ = closure;
+		env->names_   = names;
+		env->size_    = size;
+		return env;
+	}
+
+	static size_t SizeOf(size_t slots) {
+		return sizeof(Environment) + slots * sizeof(values::Object *);
+	}
+
+	size_t AllocatedSize() const {
+		return SizeOf(size_);
+	}
+
 	size_t Define(const std::string &name, values::Object *val) {
-		auto iter = map_.find(name);
+		for (size_t i = 0; i < size_; ++i) {
+			if (name == (*names_)[i]->Symbol()) {
+				Slots()[i] = DCHECK_NOTNULL(val);
+				return i;
+			}
+		}
+		if (!dict_)
+			dict_.reset(new Dictionary());
+		auto iter = dict_->index.find(name);
 		/*if (Next() == nullptr)
 			DLOG(ERROR) << "name: " << name << " object:" << val;
 		*/
-		if (iter == map_.end()) {
-			var_.push_back(DCHECK_NOTNULL(val));
-			map_.insert(std::make_pair(name, var_.size() - 1));
+		if (iter == dict_->index.end()) {
+			dict_->var.push_back(DCHECK_NOTNULL(val));
+			dict_->index.insert(std::make_pair(name, Count() - 1));
 		} else {
-			var_[iter->second] = DCHECK_NOTNULL(val);
+			dict_->var[iter->second - size_] = DCHECK_NOTNULL(val);
 			return iter->second;
 		}
-		return var_.size() - 1;
+		return Count() - 1;
 	}
 
 	values::Object *Lookup(const std::string &name) const {
-		auto iter = map_.find(name);
-		if (iter == map_.end())
-			return nullptr;
-		return var_[iter->second];
+		int i = IndexOf(name);
+		return i < 0 ? nullptr : At(i);
+	}
+
+	// Index of the variable for At(), -1 if not defined. The variable is
+	// never moved or removed, so the index is the cell of it: be cached
+	// by the callers, and redefining updates it in place.
+	int IndexOf(const std::string &name) const {
+		for (size_t i = 0; i < size_; ++i) {
+			if (name == (*names_)[i]->Symbol())
+				return static_cast<int>(i);
+		}
+		if (!dict_)
+			return -1;
+		auto iter = dict_->index.find(name);
+		if (iter == dict_->index.end())
+			return -1;
+		return static_cast<int>(iter->second);
 	}
 
 	Environment *Next() const {
 		return top_;
 	}
 
+	// The closure of frame, nullptr for dictionary.
+	values::Object *Closure() const {
+		return closure_;
+	}
+
 	size_t Count() const {
-		return var_.size();
+		return dict_ ? size_ + dict_->var.size() : size_;
 	}
 
 	values::Object *At(size_t i) const {
-		DCHECK_LE(i, var_.size());
-		return var_.at(i);
+		DCHECK_LT(i, Count());
+		return i < size_ ? Slots()[i] : dict_->var[i - size_];
 	}
 
-	const std::vector<values::Object*> &Values() const {
-		return var_;
+	void Set(size_t i, values::Object *val) {
+		DCHECK_LT(i, Count());
+		if (i < size_)
+			Slots()[i] = DCHECK_NOTNULL(val);
+		else
+			dict_->var[i - size_] = DCHECK_NOTNULL(val);
 	}
 
+	// Names defined in dictionary, excludes the slots.
 	const std::unordered_map<std::string, size_t> &Entries() const {
-		return map_;
+		static const std::unordered_map<std::string, size_t> kEmpty;
+		return dict_ ? dict_->index : kEmpty;
+	}
+
+	values::Object **Slots() const {
+		return reinterpret_cast<values::Object **>(
+				const_cast<Environment *>(this + 1));
 	}
 
 private:
+	struct Dictionary {
+		std::unordered_map<std::string, size_t> index; // <name, index>
+		std::vector<values::Object*> var;
+	};
+
 	Environment(const Environment &) = delete;
 	void operator = (const Environment &) = delete;
 
 	Environment *top_;
-	std::unordered_map<std::string, size_t> map_; // <name, index>
-	std::vector<values::Object*> var_;
+	values::Object *closure_;
+	const std::vector<values::Object*> *names_;
+	size_t size_;
+	std::unique_ptr<Dictionary> dict_;
+	// Slots follow here for frame
 }; // class Environment
 
 class Environment::Handle {
@@ -101,6 +189,11 @@ public:
 		cur_->Define(name, val);
 	}
 
+	// The environment holds the found variable.
+	Environment *Owner() const {
+		return cur_;
+	}
+
 private:
 	Handle(const Handle &) = delete;
 	void operator = (const Handle &) = delete;
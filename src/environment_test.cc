@@ -1,4 +1,5 @@
 #include "environment.h"
+#include "object_management.h"
 #include "gmock/gmock.h"
 
 namespace ajimu {
@@ -38,6 +39,45 @@ TEST(EnvironmentTest, Sanity) {
 		ASSERT_TRUE(handle.Valid());
 		ASSERT_EQ(kBaz, handle.Get());
 	}
+
+	// The index is stable, redefining updates it in place.
+	ASSERT_EQ(0, l1.IndexOf("foo"));
+	ASSERT_EQ(-1, l1.IndexOf("baz"));
+	l1.Define("baz", kBaz);
+	l1.Define("foo", kBar);
+	ASSERT_EQ(0, l1.IndexOf("foo"));
+	ASSERT_EQ(1, l1.IndexOf("baz"));
+	ASSERT_EQ(kBar, l1.At(0));
+}
+
+TEST(EnvironmentTest, Frame) {
+	values::ObjectManagement obm;
+	obm.Init();
+	std::vector<Object*> names{obm.NewSymbol("a"), obm.NewSymbol("b")};
+
+	Environment top(nullptr);
+	std::unique_ptr<char[]> chunk(new char[Environment::SizeOf(2)]);
+	Environment *frame = Environment::NewFrame(chunk.get(), &top, nullptr,
+			&names, nullptr, values::Reachable::WHITE_BIT0);
+	ASSERT_EQ(2U, frame->Count());
+	frame->Slots()[0] = kFoo;
+	frame->Slots()[1] = kBaz;
+
+	ASSERT_EQ(kFoo, frame->Lookup("a"));
+	ASSERT_EQ(kBaz, frame->Lookup("b"));
+	ASSERT_EQ(nullptr, frame->Lookup("c"));
+
+	// Define in slot
+	ASSERT_EQ(1U, frame->Define("b", kBar));
+	ASSERT_EQ(kBar, frame->At(1));
+
+	// Define out of slots
+	ASSERT_EQ(2U, frame->Define("c", kFoo));
+	ASSERT_EQ(3U, frame->Count());
+	ASSERT_EQ(kFoo, frame->Lookup("c"));
+	ASSERT_EQ(kFoo, frame->At(2));
+	ASSERT_EQ(1U, frame->Entries().size());
+	frame->~Environment();
 }
 
 } // namespace vm
@@ -19,6 +19,10 @@ public:
 
 	int Run();
 
+	vm::Mach *Mach() const {
+		return mach_.get();
+	}
+
 private:
 	EvalApplication(const EvalApplication &) = delete;
 	void operator = (const EvalApplication &) = delete;
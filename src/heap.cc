@@ -0,0 +1,61 @@
+#include "heap.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace ajimu {
+namespace values {
+
+Heap::Heap()
+	: pages_(nullptr)
+	, page_count_(0)
+	, large_count_(0) {
+	memset(classes_, 0, sizeof(classes_));
+}
+
+Heap::~Heap() {
+	Page *i = pages_, *p;
+	while (i) {
+		p = i;
+		i = i->next;
+		free(p);
+	}
+	DLOG_IF(WARNING, large_count_ != 0) << large_count_
+		<< " large chunks not be freed.";
+}
+
+void *Heap::AllocateSlow(int k) {
+	void *blob = nullptr;
+	if (posix_memalign(&blob, kPageSize, kPageSize) != 0) {
+		LOG(FATAL) << "Heap page allocation fail.";
+		return nullptr;
+	}
+	Page *page = static_cast<Page *>(blob);
+	page->next       = pages_;
+	page->size_class = k;
+	pages_ = page;
+	++page_count_;
+
+	// The rest of last page be wasted, it's less than one chunk.
+	SizeClass *sc = &classes_[k];
+	sc->top   = static_cast<char *>(blob) + kAlignment; // Skip the header
+	sc->limit = static_cast<char *>(blob) + kPageSize;
+	DCHECK_LE(sizeof(Page), static_cast<size_t>(kAlignment));
+
+	void *chunk = sc->top;
+	sc->top += SizeOf(k);
+	return chunk;
+}
+
+void *Heap::AllocateLarge(size_t size) {
+	++large_count_;
+	return malloc(size);
+}
+
+void Heap::FreeLarge(void *p) {
+	DCHECK_GT(large_count_, 0U);
+	--large_count_;
+	free(p);
+}
+
+} // namespace values
+} // namespace ajimu
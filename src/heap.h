@@ -0,0 +1,114 @@
+#ifndef AJIMU_VALUES_HEAP_H
+#define AJIMU_VALUES_HEAP_H
+
+#include "glog/logging.h"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ajimu {
+namespace values {
+
+//
+// Page based, size segregated heap for objects, environments and strings.
+// Small chunks are allocated from the free list of its size class first,
+// or bumping the pointer in the current page of the size class. Large
+// chunks fall back to malloc.
+// The size of chunk must be passed to Free(), the heap does not record it.
+//
+class Heap {
+public:
+	enum {
+		kPageShift      = 16,
+		kPageSize       = 1 << kPageShift, // 64 KB
+		kAlignmentShift = 4,
+		kAlignment      = 1 << kAlignmentShift,
+		kMaxSmallSize   = 512,
+		kNumSizeClasses = kMaxSmallSize >> kAlignmentShift,
+	};
+
+	Heap();
+
+	~Heap();
+
+	void *Allocate(size_t size) {
+		if (size > kMaxSmallSize)
+			return AllocateLarge(size);
+		int k = ClassOf(size);
+		SizeClass *sc = &classes_[k];
+		if (sc->free) {
+			Chunk *chunk = sc->free;
+			sc->free = chunk->next;
+			return chunk;
+		}
+		size_t n = SizeOf(k);
+		if (sc->top + n <= sc->limit) {
+			void *chunk = sc->top;
+			sc->top += n;
+			return chunk;
+		}
+		return AllocateSlow(k);
+	}
+
+	void Free(void *p, size_t size) {
+		if (size > kMaxSmallSize) {
+			FreeLarge(p);
+			return;
+		}
+		SizeClass *sc = &classes_[ClassOf(size)];
+		Chunk *chunk = static_cast<Chunk *>(p);
+		chunk->next = sc->free;
+		sc->free = chunk;
+	}
+
+	size_t PageCount() const {
+		return page_count_;
+	}
+
+	size_t LargeCount() const {
+		return large_count_;
+	}
+
+	static int ClassOf(size_t size) {
+		DCHECK_LE(size, static_cast<size_t>(kMaxSmallSize));
+		return size == 0 ? 0 : static_cast<int>((size - 1) >> kAlignmentShift);
+	}
+
+	static size_t SizeOf(int k) {
+		return static_cast<size_t>(k + 1) << kAlignmentShift;
+	}
+
+private:
+	Heap(const Heap &) = delete;
+	void operator = (const Heap &) = delete;
+
+	struct Chunk {
+		Chunk *next;
+	};
+
+	struct Page {
+		Page *next;
+		int size_class;
+	};
+
+	struct SizeClass {
+		Chunk *free;
+		char  *top;
+		char  *limit;
+	};
+
+	void *AllocateSlow(int k);
+
+	void *AllocateLarge(size_t size);
+
+	void FreeLarge(void *p);
+
+	SizeClass classes_[kNumSizeClasses];
+	Page *pages_;
+	size_t page_count_;
+	size_t large_count_;
+}; // class Heap
+
+} // namespace values
+} // namespace ajimu
+
+#endif //AJIMU_VALUES_HEAP_H
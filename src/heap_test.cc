@@ -0,0 +1,110 @@
+#include "heap.h"
+#include "object.h"
+#include "gmock/gmock.h"
+#include <unordered_set>
+#include <chrono>
+
+namespace ajimu {
+namespace values {
+
+TEST(HeapTest, Sanity) {
+	Heap heap;
+	ASSERT_EQ(0, Heap::ClassOf(1));
+	ASSERT_EQ(0, Heap::ClassOf(16));
+	ASSERT_EQ(1, Heap::ClassOf(17));
+	ASSERT_EQ(16U, Heap::SizeOf(0));
+
+	void *a = heap.Allocate(sizeof(Object));
+	void *b = heap.Allocate(sizeof(Object));
+	ASSERT_EQ(1U, heap.PageCount());
+	ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(a) % Heap::kAlignment);
+	ASSERT_EQ(Heap::SizeOf(Heap::ClassOf(sizeof(Object))),
+			static_cast<size_t>(static_cast<char *>(b) -
+				static_cast<char *>(a)));
+
+	// Freed chunk be reused first
+	heap.Free(a, sizeof(Object));
+	ASSERT_EQ(a, heap.Allocate(sizeof(Object)));
+
+	// Other size class in other page
+	void *c = heap.Allocate(Heap::kMaxSmallSize);
+	ASSERT_NE(nullptr, c);
+	ASSERT_EQ(2U, heap.PageCount());
+	heap.Free(c, Heap::kMaxSmallSize);
+}
+
+TEST(HeapTest, Large) {
+	Heap heap;
+	void *p = heap.Allocate(Heap::kMaxSmallSize + 1);
+	ASSERT_NE(nullptr, p);
+	ASSERT_EQ(1U, heap.LargeCount());
+	ASSERT_EQ(0U, heap.PageCount());
+	heap.Free(p, Heap::kMaxSmallSize + 1);
+	ASSERT_EQ(0U, heap.LargeCount());
+}
+
+TEST(HeapTest, ManyPages) {
+	Heap heap;
+	std::vector<void *> chunks;
+	for (int i = 0; i < 10000; ++i) {
+		void *p = heap.Allocate(sizeof(Object));
+		memset(p, 0xcc, sizeof(Object));
+		chunks.push_back(p);
+	}
+	size_t pages = heap.PageCount();
+	ASSERT_LT(1U, pages);
+	for (auto chunk : chunks)
+		heap.Free(chunk, sizeof(Object));
+	for (int i = 0; i < 10000; ++i)
+		heap.Allocate(sizeof(Object));
+	ASSERT_EQ(pages, heap.PageCount());
+}
+
+//
+// Allocation throughput: the old way of ObjectManagement::AllocateObject
+// (operator new and erase from a hash set) vs. the heap.
+//
+static const int kNumAlloced = 40;
+static const int kNumCount = 300000;
+
+template<class Callback>
+static long long Microseconds(Callback callback) {
+	auto start = std::chrono::steady_clock::now();
+	callback();
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(HeapTest, Benchmark) {
+	struct FakeObject { char padding[sizeof(Object)]; };
+
+	std::unordered_set<void *> freed;
+	long long before = Microseconds([&freed] () {
+		for (int i = 0; i < kNumCount; ++i) {
+			FakeObject *alloced[kNumAlloced];
+			for (int j = 0; j < kNumAlloced; ++j) {
+				alloced[j] = new FakeObject();
+				freed.erase(alloced[j]);
+			}
+			for (auto elem : alloced)
+				delete elem;
+		}
+	});
+
+	Heap heap;
+	long long after = Microseconds([&heap] () {
+		for (int i = 0; i < kNumCount; ++i) {
+			FakeObject *alloced[kNumAlloced];
+			for (int j = 0; j < kNumAlloced; ++j)
+				alloced[j] = new (heap.Allocate(sizeof(FakeObject)))
+					FakeObject();
+			for (auto elem : alloced)
+				heap.Free(elem, sizeof(FakeObject));
+		}
+	});
+	printf("new + freed set: %lld us, heap: %lld us, %d allocations\n",
+			before, after, kNumAlloced * kNumCount);
+}
+
+} // namespace values
+} // namespace ajimu
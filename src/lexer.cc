@@ -14,7 +14,8 @@ Lexer::Lexer(ObjectManagement *obm)
 	: obm_(obm)
 	, cur_(nullptr)
 	, end_(nullptr)
-	, line_(0) {
+	, line_(0)
+	, max_depth_(DEFAULT_MAX_DEPTH) {
 }
 
 void Lexer::Feed(const char *input, size_t len) {
@@ -29,53 +30,104 @@ void Lexer::Feed(const char *input, size_t len) {
 Object *Lexer::Next() {
 	DCHECK(cur_ != nullptr) << "Need call Feed() first!";
 
-	EatWhiteSpace();
-	while(!Eof()) {
-		switch (*cur_) {
-		case '#':
-			++cur_;
-			switch (*cur_++) {
-			case 't':
-				return Kof(True);
-			case 'f':
-				return Kof(False);
-			case '\\':
-				return ReadCharacter();
-			default:
-				RaiseError("Unknown # boolean or character.");
-			}
+	std::vector<Open> opens;
+	for (;;) {
+		if (!EatWhiteSpace())
 			return nullptr;
-		case '\"':
-			return ReadString();
-		case '(':
-			++cur_;
-			return ReadPair();
-		case '-': case '+':
-			if (IsDelimiter(cur_[1]))
-				return ReadSymbol();
-			return ReadNumber();
-		case '.':
-			if (isdigit(cur_[1]))
-				return ReadReal(0LL, +1);
-			return ReadSymbol();
-		case '\'':
-			++cur_;
-			return obm_->Cons(Kof(QuoteSymbol),
-					obm_->Cons(Next(), Kof(EmptyList)));
-		case ';':
+		Open *top = opens.empty() ? nullptr : &opens.back();
+		if (top && top->tail && *cur_ != ')') {
+			RaiseError("Where was trailing right paren?");
+			return nullptr;
+		}
+
+		Object *datum;
+		if (*cur_ == ';') {
 			while (!Eof() && *cur_++ != '\n')
 				(void)0;
+			continue;
+		} else if (*cur_ == '(' || *cur_ == '\'') {
+			if (opens.size() >= max_depth_) {
+				RaiseErrorf("Too deep nesting, Maximum is : %zu .",
+						max_depth_);
+				return nullptr;
+			}
+			opens.push_back(Open { *cur_++ == '\'', false, {}, nullptr });
+			continue;
+		} else if (*cur_ == ')' && top && !top->quote &&
+				(!top->dotted || top->tail)) { // End of list
+			++cur_;
+			datum = top->tail ? top->tail : Kof(EmptyList);
+			for (size_t i = top->elems.size(); i-- > 0;)
+				datum = obm_->Cons(top->elems[i], datum);
+			opens.pop_back();
+		} else if (*cur_ == '.' && top && !top->quote && !top->dotted &&
+				!top->elems.empty() && !(cur_[1] == '.' && cur_[2] == '.')) {
+			++cur_;
+			if (!IsDelimiter(*cur_)) {
+				RaiseError("Do not followed by delimiter.");
+				return nullptr;
+			}
+			top->dotted = true;
+			continue;
+		} else {
+			datum = ReadAtom();
+			if (!datum)
+				return nullptr;
+		}
+
+		// Give the datum to the innermost open one.
+		for (;;) {
+			if (opens.empty())
+				return datum;
+			Open *open = &opens.back();
+			if (open->quote) {
+				datum = obm_->Cons(Kof(QuoteSymbol),
+						obm_->Cons(datum, Kof(EmptyList)));
+				opens.pop_back();
+				continue;
+			}
+			if (open->dotted)
+				open->tail = datum;
+			else
+				open->elems.push_back(datum);
 			break;
+		}
+	}
+}
+
+Object *Lexer::ReadAtom() {
+	switch (*cur_) {
+	case '#':
+		++cur_;
+		switch (*cur_++) {
+		case 't':
+			return Kof(True);
+		case 'f':
+			return Kof(False);
+		case '\\':
+			return ReadCharacter();
 		default:
-			if (isdigit(*cur_))
-				return ReadNumber();
-			else if (IsInitial(*cur_))
-				return ReadSymbol();
-			RaiseErrorf("Unknown token. char: \"%c\"", *cur_);
-			goto final;
+			RaiseError("Unknown # boolean or character.");
 		}
+		return nullptr;
+	case '\"':
+		return ReadString();
+	case '-': case '+':
+		if (IsDelimiter(cur_[1]))
+			return ReadSymbol();
+		return ReadNumber();
+	case '.':
+		if (isdigit(cur_[1]))
+			return ReadReal(0LL, +1);
+		return ReadSymbol();
+	default:
+		if (isdigit(*cur_))
+			return ReadNumber();
+		else if (IsInitial(*cur_))
+			return ReadSymbol();
+		RaiseErrorf("Unknown token. char: \"%c\"", *cur_);
+		break;
 	}
-final:
 	return nullptr;
 }
 
@@ -108,41 +160,6 @@ Object *Lexer::ReadCharacter() {
 	return ExpectDelimiter() ? obm_->NewCharacter(c) : nullptr;
 }
 
-Object *Lexer::ReadPair() {
-	if (!EatWhiteSpace())
-		return nullptr;
-	if (*cur_ == ')') { // Is empty list(pair) ?
-		++cur_;
-		return Kof(EmptyList);
-	}
-	Object *car = Next();
-	if (!car)
-		return nullptr;
-	if (!EatWhiteSpace())
-		return nullptr;
-	if (cur_[0] != '.') {
-		Object *cdr = ReadPair();
-		return obm_->Cons(car, cdr);
-	}
-	if (cur_[1] == '.' && cur_[2] == '.') {
-		Object *cdr = ReadPair();
-		return obm_->Cons(car, cdr);
-	}
-	++cur_;
-	if (!IsDelimiter(*cur_)) {
-		RaiseError("Do not followed by delimiter.");
-		return nullptr;
-	}
-	Object *cdr = Next();
-	if (!cdr || !EatWhiteSpace())
-		return nullptr;
-	if (*cur_++ != ')') {
-		RaiseError("Where was trailing right paren?");
-		return nullptr;
-	}
-	return obm_->Cons(car, cdr);
-}
-
 Object *Lexer::ReadNumber() {
 	long long sign = 1;
 	if (*cur_ == '-') {
@@ -19,6 +19,8 @@ public:
 
 	enum {
 		MAX_SYMBOL_LEN = 160,
+		// Nested lists and quotations deeper than it raise error.
+		DEFAULT_MAX_DEPTH = 1024 * 1024,
 	};
 
 	Lexer(values::ObjectManagement *obm);
@@ -29,9 +31,13 @@ public:
 
 	void Feed(const char *input, size_t len);
 
-	values::Object *Next();
+	size_t MaxDepth() const { return max_depth_; }
+
+	void SetMaxDepth(size_t depth) { max_depth_ = depth; }
 
-	values::Object *ReadPair();
+	// Read a datum, the nested ones be read by an explicit stack, not by
+	// recursion.
+	values::Object *Next();
 
 	values::Object *ReadCharacter();
 
@@ -58,10 +64,22 @@ public:
 	static bool IsInitial(int c);
 
 private:
+	// Open list or quotation in reading
+	struct Open {
+		bool quote;  // Waiting for the datum of quotation
+		bool dotted; // After `.', waiting for the tail
+		std::vector<values::Object*> elems;
+		values::Object *tail; // nullptr if not be read yet
+	};
+
+	// Read a datum which is not list or quotation.
+	values::Object *ReadAtom();
+
 	values::ObjectManagement *obm_;
 	const char *cur_;
 	const char *end_;
 	int line_;
+	size_t max_depth_;
 	std::vector<Observer> observer_;
 
 	void RaiseError(const char *err) {
@@ -41,15 +41,15 @@ TEST_F(LexerTest, Sanity) {
 
 	Object *ob = lexer_->Next();
 	ASSERT_TRUE(ob != nullptr);
-	ASSERT_EQ(values::BOOLEAN, ob->OwnedType());
-	ASSERT_FALSE(ob->Boolean());
+	ASSERT_EQ(values::BOOLEAN, Object::TypeOf(ob));
+	ASSERT_FALSE(Object::Boolean(ob));
 
 	input = "#t";
 	lexer_->Feed(input.c_str(), input.size());
 	ob = lexer_->Next();
 	ASSERT_TRUE(ob != nullptr);
-	ASSERT_EQ(values::BOOLEAN, ob->OwnedType());
-	ASSERT_TRUE(ob->Boolean());
+	ASSERT_EQ(values::BOOLEAN, Object::TypeOf(ob));
+	ASSERT_TRUE(Object::Boolean(ob));
 
 	input = "#x";
 	lexer_->Feed(input.c_str(), input.size());
@@ -62,15 +62,15 @@ TEST_F(LexerTest, Character) {
 	lexer_->Feed(input.c_str(), input.size());
 	Object *ob = lexer_->Next();
 	ASSERT_TRUE(ob != nullptr);
-	ASSERT_EQ(values::CHARACTER, ob->OwnedType());
-	ASSERT_EQ(' ', ob->Character());
+	ASSERT_EQ(values::CHARACTER, Object::TypeOf(ob));
+	ASSERT_EQ(' ', Object::Character(ob));
 
 	input = "#\\newline";
 	lexer_->Feed(input.c_str(), input.size());
 	ob = lexer_->Next();
 	ASSERT_TRUE(ob != nullptr);
-	ASSERT_EQ(values::CHARACTER, ob->OwnedType());
-	ASSERT_EQ('\n', ob->Character());
+	ASSERT_EQ(values::CHARACTER, Object::TypeOf(ob));
+	ASSERT_EQ('\n', Object::Character(ob));
 
 	input = "#\\n #\\s #\\a #\\! #\\?";
 	static const char expected[] = {'n', 's', 'a', '!', '?'};
@@ -78,7 +78,7 @@ TEST_F(LexerTest, Character) {
 	for (char c : expected) {
 		ob = lexer_->Next();
 		ASSERT_TRUE(ob != nullptr);
-		ASSERT_EQ(c, ob->Character());
+		ASSERT_EQ(c, Object::Character(ob));
 	}
 }
 
@@ -87,8 +87,8 @@ TEST_F(LexerTest, Fixed) {
 	lexer_->Feed(input.c_str(), input.size());
 	Object *ob = lexer_->Next();
 	ASSERT_TRUE(ob != nullptr);
-	ASSERT_EQ(values::FIXED, ob->OwnedType());
-	ASSERT_EQ(-1LL, ob->Fixed());
+	ASSERT_EQ(values::FIXED, Object::TypeOf(ob));
+	ASSERT_EQ(-1LL, Object::Fixed(ob));
 
 	input = "0 1 2 3 4 5 112 -112 65535 +1024 -1024";
 	static const long long expected[] = {
@@ -98,7 +98,7 @@ TEST_F(LexerTest, Fixed) {
 	for (long long ll : expected) {
 		ob = lexer_->Next();
 		ASSERT_TRUE(ob != nullptr) << "Unexpected: " << ll;
-		ASSERT_EQ(ll, ob->Fixed());
+		ASSERT_EQ(ll, Object::Fixed(ob));
 	}
 }
 
@@ -106,7 +106,7 @@ TEST_F(LexerTest, Real) {
 	std::string input("0.1");
 	lexer_->Feed(input.c_str(), input.size());
 	Object *ob = lexer_->Next();
-	ASSERT_EQ(values::REAL, ob->OwnedType());
+	ASSERT_EQ(values::REAL, Object::TypeOf(ob));
 	ASSERT_DOUBLE_EQ(0.1, ob->Real());
 
 	input = ".1 0.0002 1000.0001 +0.1 -0.1 -100000.00001";
@@ -144,15 +144,15 @@ TEST_F(LexerTest, Pair) {
 	lexer_->Feed(input.c_str(), input.size());
 	Object *ob = lexer_->Next();
 	ASSERT_TRUE(ob != nullptr);
-	ASSERT_EQ(values::PAIR, ob->OwnedType());
+	ASSERT_EQ(values::PAIR, Object::TypeOf(ob));
 
 	input = "(#f . #t)";
 	lexer_->Feed(input.c_str(), input.size());
 	ob = lexer_->Next();
 	ASSERT_TRUE(ob != nullptr);
-	ASSERT_EQ(values::PAIR, ob->OwnedType());
-	ASSERT_FALSE(ob->Car()->Boolean());
-	ASSERT_TRUE(ob->Cdr()->Boolean());
+	ASSERT_EQ(values::PAIR, Object::TypeOf(ob));
+	ASSERT_FALSE(Object::Boolean(ob->Car()));
+	ASSERT_TRUE(Object::Boolean(ob->Cdr()));
 
 	input = "(#t #f ())";
 	lexer_->Feed(input.c_str(), input.size());
@@ -173,10 +173,62 @@ TEST_F(LexerTest, List) {
 	lexer_->Feed(input.c_str(), input.size());
 	Object *ob = lexer_->Next();
 	ASSERT_NE(nullptr, ob);
-	ASSERT_TRUE(ob->IsPair());
-	ASSERT_TRUE(ob->Car()->IsSymbol()); // define
-	ASSERT_TRUE(cadr(ob)->IsSymbol());  // x
-	ASSERT_TRUE(caddr(ob)->IsFixed());   // 1
+	ASSERT_TRUE(Object::IsPair(ob));
+	ASSERT_TRUE(Object::IsSymbol(ob->Car())); // define
+	ASSERT_TRUE(Object::IsSymbol(cadr(ob)));  // x
+	ASSERT_TRUE(Object::IsFixed(caddr(ob)));   // 1
+}
+
+TEST_F(LexerTest, LongList) {
+	std::string input("(");
+	for (int i = 0; i < 1000000; ++i)
+		input.append("1 ");
+	input.append(". 2)");
+	lexer_->Feed(input.c_str(), input.size());
+	Object *ob = lexer_->Next();
+	ASSERT_NE(nullptr, ob);
+	int n = 0;
+	for (; Object::IsPair(ob); ob = ob->Cdr())
+		++n;
+	ASSERT_EQ(1000000, n);
+	ASSERT_EQ(2, Object::Fixed(ob));
+}
+
+TEST_F(LexerTest, DeepList) {
+	// Nested lists and quotations be read without recursion.
+	std::string input;
+	for (int i = 0; i < 200000; ++i)
+		input.append(i % 2 ? "'(" : "(1 ");
+	for (int i = 0; i < 200000; ++i)
+		input.append(")");
+	lexer_->Feed(input.c_str(), input.size());
+	Object *ob = lexer_->Next();
+	ASSERT_NE(nullptr, ob);
+	// (1 '((1 '(...))))
+	int n = 0;
+	for (;;) {
+		ASSERT_EQ(1, Object::Fixed(car(ob)));
+		ASSERT_EQ(obm_->Constant(values::kEmptyList), cddr(ob));
+		ob = cadr(ob);
+		ASSERT_EQ(obm_->Constant(values::kQuoteSymbol), car(ob));
+		ob = cadr(ob);
+		n += 2;
+		if (ob == obm_->Constant(values::kEmptyList))
+			break;
+		ob = car(ob);
+	}
+	ASSERT_EQ(200000, n);
+
+	// Deeper than the limit raise error.
+	lexer_->SetMaxDepth(100);
+	input.assign(101, '(');
+	input.append(101, ')');
+	lexer_->Feed(input.c_str(), input.size());
+	ASSERT_EQ(nullptr, lexer_->Next());
+	input.assign(100, '(');
+	input.append(100, ')');
+	lexer_->Feed(input.c_str(), input.size());
+	ASSERT_NE(nullptr, lexer_->Next());
 }
 
 TEST_F(LexerTest, String) {
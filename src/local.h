@@ -2,7 +2,8 @@
 #define AJIMU_VM_LOCAL_H
 
 #include "glog/logging.h"
-#include <deque>
+#include <stddef.h>
+#include <vector>
 
 namespace ajimu {
 namespace values {
@@ -11,46 +12,216 @@ class Object;
 namespace vm {
 class Environment;
 
+//
+// The root stack of vm. It's made of contiguous chunks, the top is a raw
+// pointer in current chunk, so push, pop and peek are only one compare
+// in the common case. The chunks be kept for reusing until destroying,
+// so the positions of scopes are always valid.
+//
 template<class T>
 class Local {
 public:
 	class Persisted;
 
-	Local() {}
+	enum {
+		kChunkShift = 10,
+		kChunkSize  = 1 << kChunkShift, // 1024 entries
+	};
+
+	struct Chunk {
+		Chunk *prev;
+		Chunk *next;
+		size_t base; // Entries in the chunks before this one
+		T *slots[kChunkSize];
+	};
+
+	// Scope marker: the top of stack.
+	struct Position {
+		Chunk *chunk;
+		T **top;
+	};
+
+	Local()
+		: first_(NewChunk(nullptr))
+		, chunk_(first_)
+		, top_(first_->slots)
+		, limit_(first_->slots + kChunkSize)
+		, unchanged_(0) {
+	}
 
 	~Local() {
-		DCHECK_EQ(0U, val_.size())
+		DCHECK_EQ(0U, Count())
 			<< "Stack is not balanced! Remain:"
-			<< val_.size();
-	}
-
-	const std::deque<T*> &Values() const {
-		return val_;
+			<< Count();
+		Chunk *i = first_, *p;
+		while (i) {
+			p = i;
+			i = i->next;
+			delete p;
+		}
 	}
 
 	size_t Count() const {
-		return val_.size();
+		return chunk_->base + (top_ - chunk_->slots);
 	}
 
 	void Push(T *o) {
-		val_.push_back(o);
+		if (top_ == limit_)
+			Grow();
+		*top_++ = o;
 	}
 
 	void Pop(size_t n) {
 		DCHECK_GE(Count(), n);
-		val_.resize(Count() - n);
+		if (n <= static_cast<size_t>(top_ - chunk_->slots))
+			top_ -= n;
+		else
+			PopSlow(n);
+		Lower(Count());
 	}
 
 	T *Last(size_t i) const {
 		DCHECK_GT(Count(), i);
-		return val_.at(Count() - i - 1);
+		if (i < static_cast<size_t>(top_ - chunk_->slots))
+			return top_[-1 - static_cast<ptrdiff_t>(i)];
+		return LastSlow(i);
+	}
+
+	void Set(size_t i, T *o) {
+		DCHECK_GT(Count(), i);
+		if (i < static_cast<size_t>(top_ - chunk_->slots))
+			top_[-1 - static_cast<ptrdiff_t>(i)] = o;
+		else
+			SetSlow(i, o);
+		Lower(Count() - 1 - i);
+	}
+
+	// The last n entries as an array from the lower one, nullptr if they
+	// are not in one chunk. It is read only, the writing be not seen by
+	// Unchanged().
+	T **Top(size_t n) const {
+		DCHECK_GE(Count(), n);
+		if (n <= static_cast<size_t>(top_ - chunk_->slots))
+			return top_ - n;
+		return nullptr;
+	}
+
+	// Append the entries in [from, to) to out, from the lower one.
+	void CopyTo(size_t from, size_t to, std::vector<T*> *out) const {
+		DCHECK_LE(from, to);
+		DCHECK_GE(Count(), to);
+		Chunk *c = chunk_;
+		while (c->base > from)
+			c = DCHECK_NOTNULL(c->prev);
+		out->reserve(out->size() + (to - from));
+		for (size_t i = from; i < to; ++i) {
+			if (i - c->base == kChunkSize)
+				c = c->next;
+			out->push_back(c->slots[i - c->base]);
+		}
+	}
+
+	Position Mark() const {
+		return Position{chunk_, top_};
+	}
+
+	// Pop all entries be pushed after the marked position.
+	void Reset(const Position &pos) {
+		DCHECK_GE(Count(), pos.chunk->base + (pos.top - pos.chunk->slots));
+		chunk_ = pos.chunk;
+		top_   = pos.top;
+		limit_ = chunk_->slots + kChunkSize;
+		Lower(Count());
+	}
+
+	// For minor gc: The entries below it are not popped or set since the
+	// last MarkUnchanged(), so they refer to the ones be promoted by the
+	// last minor gc, only the entries above it need be scanned.
+	size_t Unchanged() const { return unchanged_; }
+
+	void MarkUnchanged() { unchanged_ = Count(); }
+
+	// For gc: Visit all entries from the bottom, chunk by chunk.
+	template<class Callback>
+	void ForEach(Callback callback) const {
+		ForEachFrom(0, callback);
+	}
+
+	// Visit the entries from the index to the top.
+	template<class Callback>
+	void ForEachFrom(size_t from, Callback callback) const {
+		DCHECK_GE(Count(), from);
+		Chunk *c = chunk_;
+		while (c->base > from)
+			c = DCHECK_NOTNULL(c->prev);
+		for (T **i = c->slots + (from - c->base);; c = c->next) {
+			T **end = c == chunk_ ? top_ : c->slots + kChunkSize;
+			for (; i < end; ++i)
+				callback(*i);
+			if (c == chunk_)
+				break;
+			i = c->next->slots;
+		}
 	}
 
 private:
 	Local(const Local &) = delete;
 	void operator = (const Local &) = delete;
 
-	std::deque<T*> val_;
+	static Chunk *NewChunk(Chunk *prev) {
+		Chunk *chunk = new Chunk;
+		chunk->prev = prev;
+		chunk->next = nullptr;
+		chunk->base = prev ? prev->base + kChunkSize : 0;
+		return chunk;
+	}
+
+	void Grow() {
+		if (!chunk_->next)
+			chunk_->next = NewChunk(chunk_);
+		chunk_ = chunk_->next;
+		top_   = chunk_->slots;
+		limit_ = chunk_->slots + kChunkSize;
+	}
+
+	void PopSlow(size_t n) {
+		while (n > static_cast<size_t>(top_ - chunk_->slots)) {
+			n -= top_ - chunk_->slots;
+			chunk_ = DCHECK_NOTNULL(chunk_->prev);
+			top_   = chunk_->slots + kChunkSize;
+		}
+		top_ -= n;
+		limit_ = chunk_->slots + kChunkSize;
+	}
+
+	T *LastSlow(size_t i) const {
+		return *SlotSlow(i);
+	}
+
+	void SetSlow(size_t i, T *o) {
+		*SlotSlow(i) = o;
+	}
+
+	void Lower(size_t count) {
+		if (count < unchanged_)
+			unchanged_ = count;
+	}
+
+	T **SlotSlow(size_t i) const {
+		i -= top_ - chunk_->slots;
+		Chunk *c = DCHECK_NOTNULL(chunk_->prev);
+		while (i >= kChunkSize) {
+			i -= kChunkSize;
+			c = DCHECK_NOTNULL(c->prev);
+		}
+		return &c->slots[kChunkSize - 1 - i];
+	}
+
+	Chunk *first_;
+	Chunk *chunk_; // Current chunk
+	T **top_;      // Next free entry in current chunk
+	T **limit_;    // End of current chunk
+	size_t unchanged_; // Count of the bottom entries not changed
 }; // class Local
 
 template<class T>
@@ -58,12 +229,11 @@ class Local<T>::Persisted {
 public:
 	Persisted(Local *local)
 		: local_(local)
-		, keeped_(local->Count()) {
+		, keeped_(local->Mark()) {
 	}
 
 	~Persisted() {
-		DCHECK_GE(local_->Count(), keeped_);
-		local_->Pop(local_->Count() - keeped_);
+		local_->Reset(keeped_);
 	}
 
 private:
@@ -71,11 +241,10 @@ private:
 	void operator = (const Persisted &) = delete;
 
 	Local *local_;
-	size_t keeped_;
+	Position keeped_;
 }; // class Local::Persisted
 
 } // namespace vm
 } // namespace ajimu
 
 #endif //AJIMU_VM_LOCAL_H
-
@@ -47,6 +47,85 @@ TEST_F(LocalTest, Sanity) {
 	ASSERT_EQ(0U, local_->Count());
 }
 
+TEST_F(LocalTest, Chunks) {
+	const size_t n = Local<Object>::kChunkSize * 2 + 3;
+	for (size_t i = 0; i < n; ++i)
+		local_->Push(P(i));
+	ASSERT_EQ(n, local_->Count());
+	for (size_t i = 0; i < n; ++i)
+		ASSERT_EQ(P(n - 1 - i), local_->Last(i));
+
+	size_t visited = 0;
+	local_->ForEach([this, &visited] (Object *o) {
+		ASSERT_EQ(P(visited), o);
+		++visited;
+	});
+	ASSERT_EQ(n, visited);
+
+	// Pop across the chunks.
+	local_->Pop(Local<Object>::kChunkSize + 5);
+	ASSERT_EQ(n - Local<Object>::kChunkSize - 5, local_->Count());
+	ASSERT_EQ(P(local_->Count() - 1), local_->Last(0));
+	local_->Pop(local_->Count());
+	ASSERT_EQ(0U, local_->Count());
+}
+
+TEST_F(LocalTest, Persisted) {
+	local_->Push(P(1));
+	{
+		Local<Object>::Persisted persisted(local_);
+		auto pos = local_->Mark();
+		for (size_t i = 0; i < Local<Object>::kChunkSize; ++i)
+			local_->Push(P(2));
+		local_->Reset(pos);
+		ASSERT_EQ(1U, local_->Count());
+		for (size_t i = 0; i < Local<Object>::kChunkSize; ++i)
+			local_->Push(P(3));
+	}
+	ASSERT_EQ(1U, local_->Count());
+	ASSERT_EQ(P(1), local_->Last(0));
+	local_->Pop(1);
+}
+
+TEST_F(LocalTest, Unchanged) {
+	const size_t n = Local<Object>::kChunkSize * 2 + 3;
+	for (size_t i = 0; i < n; ++i)
+		local_->Push(P(i));
+	ASSERT_EQ(0U, local_->Unchanged());
+	local_->MarkUnchanged();
+	ASSERT_EQ(n, local_->Unchanged());
+
+	// Pushing keeps the bottom unchanged.
+	local_->Push(P(n));
+	ASSERT_EQ(n, local_->Unchanged());
+	size_t visited = 0;
+	local_->ForEachFrom(local_->Unchanged(), [this, &visited] (Object *o) {
+		ASSERT_EQ(P(n), o);
+		++visited;
+	});
+	ASSERT_EQ(1U, visited);
+
+	// Popping and setting lower it.
+	local_->Pop(2);
+	ASSERT_EQ(n - 1, local_->Unchanged());
+	local_->Set(Local<Object>::kChunkSize, P(0));
+	ASSERT_EQ(n - 2 - Local<Object>::kChunkSize, local_->Unchanged());
+	visited = 0;
+	local_->ForEachFrom(local_->Unchanged(), [&visited] (Object *) {
+		++visited;
+	});
+	ASSERT_EQ(Local<Object>::kChunkSize + 1, visited);
+
+	auto pos = local_->Mark();
+	for (int i = 0; i < 3; ++i)
+		local_->Push(P(i));
+	local_->MarkUnchanged();
+	ASSERT_EQ(n + 2, local_->Unchanged());
+	local_->Reset(pos);
+	ASSERT_EQ(n - 1, local_->Unchanged());
+	local_->Pop(local_->Count());
+}
+
 } // namespace vm
 } // namespace ajimu
 
@@ -2,14 +2,21 @@
 #include "object_management.h"
 #include "object.h"
 #include "macro_analyzer.h"
+#include "analyzer.h"
+#include "compiler.h"
+#include "code.h"
+#include "continuation.h"
+#include "node.h"
 #include "environment.h"
 #include "local.h"
 #include "lexer.h"
 #include "string.h"
+#include "stack_scanner.h"
 #include "utils.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 
 namespace ajimu {
 namespace vm {
@@ -37,83 +44,63 @@ private:
 	std::stack<T> *stack_;
 };
 
-inline values::PrimitiveMethodPtr UnsafeCast2Method(const char *k) {
-	union {
-		const char *input;
-		values::PrimitiveMethodPtr output;
-	};
-	input = k;
-	return output;
-}
-
-static auto kApply = UnsafeCast2Method(":apply:");
-static auto kEval =  UnsafeCast2Method(":eval:");
-
-#define Kof(i) obm_->Constant(::ajimu::values::k##i)
-inline bool IsTaggedList(Object *expr, Object *tag) {
-	Object  *first;
-	if (expr->IsPair()) {
-		first = car(expr);
-		return first->IsSymbol() && first == tag;
-	}
-	return false;
-}
-
-inline bool IsSelfEvaluating(Object *expr) {
-	switch (expr->OwnedType()) {
-	case values::BOOLEAN:
-	case values::FIXED:
-	case values::REAL:
-	case values::CHARACTER:
-	case values::STRING:
-		return true;
-	default:
-		break;
-	}
-	return false;
-}
-
-inline bool IsVariable(Object *expr) {
-	return expr->IsSymbol();
-}
-
-inline bool IsDefinition(Object *expr, ObjectManagement *obm_) {
-	return IsTaggedList(expr, Kof(DefineSymbol));
-}
-
-inline bool IsLambda(Object *expr, ObjectManagement *obm_) {
-	return IsTaggedList(expr, Kof(LambdaSymbol));
-}
-
-inline bool IsBegin(Object *expr, ObjectManagement *obm_) {
-	return IsTaggedList(expr, Kof(BeginSymbol));
-}
-
-inline bool IsQuoted(Object *expr, ObjectManagement *obm_) {
-	return IsTaggedList(expr, Kof(QuoteSymbol));
-}
-
-inline bool IsAssignment(Object *expr, ObjectManagement *obm_) {
-	return IsTaggedList(expr, Kof(SetSymbol));
-}
-
-inline bool IsIf(Object *expr, ObjectManagement *obm_) {
-	return IsTaggedList(expr, Kof(IfSymbol));
-}
+using ::ajimu::values::PrimitiveProc;
 
-inline bool IsAnd(Object *expr, ObjectManagement *obm_) {
-	return IsTaggedList(expr, Kof(AndSymbol));
-}
+// Dealt by the vm, they have no method.
+static const PrimitiveProc kApply = { "apply", nullptr, 2, -1, };
+static const PrimitiveProc kEval  = { "eval",  nullptr, 1,  2, };
+static const PrimitiveProc kCallCC = {
+	"call-with-current-continuation", nullptr, 1, 1,
+};
+static const PrimitiveProc kCallEC = {
+	"call-with-escape-continuation", nullptr, 1, 1,
+};
 
-inline bool IsOr(Object *expr, ObjectManagement *obm_) {
-	return IsTaggedList(expr, Kof(OrSymbol));
-}
-
-inline Object *MakeLambda(Object *params, Object *body,
-		ObjectManagement *obm_) {
-	return obm_->Cons(Kof(LambdaSymbol), obm_->Cons(params, body));
-}
+// Procedures in scheme, be evaluated in bytecode after initializing.
+static const char kPrelude[] =
+	"(define (dynamic-wind before thunk after)"
+	"  (before)"
+	"  (ajimu.set-winders! (cons (cons before after) (ajimu.winders)))"
+	"  ((lambda (rv)"
+	"     (ajimu.set-winders! (cdr (ajimu.winders)))"
+	"     (after)"
+	"     rv) (thunk)))"
+	// Travel between the winders: call the afters from the innermost
+	// one, to the common tail; then the befores to the target one.
+	"(define (ajimu.wind-length l)"
+	"  (if (null? l) 0 (+ 1 (ajimu.wind-length (cdr l)))))"
+	"(define (ajimu.wind-tail l n)"
+	"  (if (> n 0) (ajimu.wind-tail (cdr l) (- n 1)) l))"
+	"(define (ajimu.wind-same a b)"
+	"  (if (eq? a b) a (ajimu.wind-same (cdr a) (cdr b))))"
+	"(define (ajimu.wind-common a b)"
+	"  ((lambda (la lb)"
+	"     (ajimu.wind-same (ajimu.wind-tail a (- la lb))"
+	"                      (ajimu.wind-tail b (- lb la))))"
+	"   (ajimu.wind-length a) (ajimu.wind-length b)))"
+	"(define (ajimu.wind-out from common)"
+	"  (if (eq? from common) #t"
+	"      (begin (ajimu.set-winders! (cdr from))"
+	"             ((cdr (car from)))"
+	"             (ajimu.wind-out (cdr from) common))))"
+	"(define (ajimu.wind-in to common)"
+	"  (if (eq? to common) #t"
+	"      (begin (ajimu.wind-in (cdr to) common)"
+	"             ((car (car to)))"
+	"             (ajimu.set-winders! to))))"
+	"(define (ajimu.resume k v to)"
+	"  ((lambda (common)"
+	"     (ajimu.wind-out (ajimu.winders) common)"
+	"     (ajimu.wind-in to common))"
+	"   (ajimu.wind-common (ajimu.winders) to))"
+	"  (k v))"
+	"(define call/cc call-with-current-continuation)"
+	"(define call/ec call-with-escape-continuation)";
+
+// Operands be evaluated to the native stack, if it is scanned by gc.
+static const size_t kMaxHeldOperands = 8;
 
+#define Kof(i) obm_->Constant(::ajimu::values::k##i)
 inline Object *PrepareApplyOperands(Object *args, ObjectManagement *obm_) {
 	if (cdr(args) == Kof(EmptyList))
 		return car(args);
@@ -128,9 +115,19 @@ Mach::Mach()
 	: obm_(new ObjectManagement())
 	, local_val_(new Local<Object>())
 	, local_env_(new Local<Environment>())
+	, serial_(0)
+	, winders_(nullptr)
+	, escape_to_(nullptr)
+	, escape_val_(nullptr)
+	, resume_(nullptr)
+	, installed_(nullptr)
 	, global_env_(nullptr)
+	, engine_(kBytecode)
+	, auto_seal_(false)
 	, error_(0)
-	, call_level_(0) {
+	, call_level_(0)
+	, max_call_depth_(DEFAULT_MAX_CALL_DEPTH)
+	, stack_guard_(0) {
 }
 
 Mach::~Mach() {
@@ -151,6 +148,11 @@ Object *Mach::Last(size_t i) const {
 	return local_val_->Last(i);
 }
 
+void Mach::Hold(Object *o) {
+	if (!obm_->GcConservative())
+		local_val_->Push(o);
+}
+
 int Mach::Line() const {
 	return lex_->Line();
 }
@@ -160,67 +162,93 @@ Object *Mach::Feed(const char *input) {
 }
 
 bool Mach::Init() {
-	static const struct PrimitiveEntry {
-		const char *name;
-		values::PrimitiveMethodPtr method;
-	} kProcs[] = {
+	// { name, method, min args, max args }, -1 is variadic.
+	static const PrimitiveProc kProcs[] = {
 		// Type system procedures:
-		{ "boolean?", &Mach::IsBoolean, },
-		{ "symbol?",  &Mach::IsSymbol,  },
-		{ "char?",    &Mach::IsChar,    },
-		{ "vector?",  &Mach::IsVector,  },
-		{ "port?",    &Mach::IsPort,    },
-		{ "null?",    &Mach::IsNull,    },
-		{ "pair?",    &Mach::IsPair,    },
-		{ "integer?", &Mach::IsInteger, },
-		{ "real?",   &Mach::IsReal,   },
-		{ "string?",  &Mach::IsString,  },
-		{ "bytevector?", &Mach::IsByteVector, },
-		{ "procedure?",  &Mach::IsProcedure,  },
+		{ "boolean?", &Mach::IsBoolean, 1, 1, },
+		{ "symbol?",  &Mach::IsSymbol,  1, 1, },
+		{ "char?",    &Mach::IsChar,    1, 1, },
+		{ "vector?",  &Mach::IsVector,  1, 1, },
+		{ "port?",    &Mach::IsPort,    1, 1, },
+		{ "null?",    &Mach::IsNull,    1, 1, },
+		{ "pair?",    &Mach::IsPair,    1, 1, },
+		{ "integer?", &Mach::IsInteger, 1, 1, },
+		{ "real?",   &Mach::IsReal,     1, 1, },
+		{ "string?",  &Mach::IsString,  1, 1, },
+		{ "bytevector?", &Mach::IsByteVector, 1, 1, },
+		{ "procedure?",  &Mach::IsProcedure,  1, 1, },
+
+		// Equivalence predicates:
+		{ "eq?", &Mach::Eq, 2, 2, },
 
 		// Arithmetic procedures:
-		{ "+", &Mach::Add, },
-		{ "-", &Mach::Dec, },
-		{ "*", &Mach::Mul, },
-		{ "/", &Mach::Div, },
-		{ "=", &Mach::NumberEqual, },
-		{ ">", &Mach::NumberGreat, },
-		{ "<", &Mach::NumberLess,  },
-
-		// Evaluting
-		{ "apply", kApply, },
-		{ "eval",  kEval,  },
+		{ "+", &Mach::Add, 0, -1, },
+		{ "-", &Mach::Dec, 1, -1, },
+		{ "*", &Mach::Mul, 1, -1, },
+		{ "/", &Mach::Div, 1, -1, },
+		{ "=", &Mach::NumberEqual, 1, -1, },
+		{ ">", &Mach::NumberGreat, 1, -1, },
+		{ "<", &Mach::NumberLess,  1, -1, },
 
 		// List procedures:
-		{ "cons", &Mach::Cons, },
-		{ "car",  &Mach::Car,  },
-		{ "cdr",  &Mach::Cdr,  },
-		{ "list", &Mach::List, },
-		{ "set-car!", &Mach::SetCar, },
-		{ "set-cdr!", &Mach::SetCdr, },
+		{ "cons", &Mach::Cons, 2, 2, },
+		{ "car",  &Mach::Car,  1, 1, },
+		{ "cdr",  &Mach::Cdr,  1, 1, },
+		{ "list", &Mach::List, 0, -1, },
+		{ "set-car!", &Mach::SetCar, 2, 2, },
+		{ "set-cdr!", &Mach::SetCdr, 2, 2, },
 
 		// Ouput:
-		{ "display", &Mach::Display, },
+		{ "display", &Mach::Display, 1, 1, },
 
 		// File
-		{ "load", &Mach::Load, },
+		{ "load", &Mach::Load, 1, 1, },
 
 		// Error Handling
-		{ "error", &Mach::Error, },
+		{ "error", &Mach::Error, 0, -1, },
 
 		// Ajimu extensions:
-		{ "ajimu.gc.allocated", &Mach::AjimuGcAllocated, },
-		{ "ajimu.gc.state", &Mach::AjimuGcState, },
+		{ "ajimu.gc.allocated", &Mach::AjimuGcAllocated, 0, 0, },
+		{ "ajimu.gc.state", &Mach::AjimuGcState, 0, 0, },
+		{ "ajimu.gc.threshold", &Mach::AjimuGcThreshold, 0, 0, },
+		{ "ajimu.gc.stats", &Mach::AjimuGcStats, 0, 0, },
+		{ "ajimu.gc.growth", &Mach::AjimuGcGrowth, 0, 1, },
+		{ "ajimu.gc.min-heap", &Mach::AjimuGcMinHeap, 0, 1, },
+		{ "ajimu.gc.max-heap", &Mach::AjimuGcMaxHeap, 0, 1, },
+		{ "ajimu.gc.seal", &Mach::AjimuGcSeal, 0, 0, },
+		{ "ajimu.winders", &Mach::AjimuWinders, 0, 0, },
+		{ "ajimu.set-winders!", &Mach::AjimuSetWinders, 1, 1, },
 	};
 
 	obm_->Init();
 	// Register primitive proc(s)
-	for (const PrimitiveEntry &i : kProcs) {
-		obm_->NewPrimitive(i.name, i.method);
-	}
+	for (const PrimitiveProc &i : kProcs)
+		obm_->NewPrimitive(&i);
+	// Evaluting
+	obm_->NewPrimitive(&kApply);
+	obm_->NewPrimitive(&kEval);
+	// Control
+	obm_->NewPrimitive(&kCallCC);
+	obm_->NewPrimitive(&kCallEC);
+	winders_   = Kof(EmptyList);
+	installed_ = Kof(EmptyList);
+	obm_->AddRoot(&winders_);
+	obm_->AddRoot(&escape_to_);
+	obm_->AddRoot(&escape_val_);
+	obm_->AddRoot(&resume_);
+	obm_->AddRoot(&installed_);
 
 	// Initialize macro analyzer
 	factory_.reset(new MacroAnalyzer(obm_.get()));
+
+	// Initialize syntax analyzer
+	analyzer_.reset(new Analyzer(obm_.get(), factory_.get()));
+	analyzer_->AddObserver([this] (const char *err, Analyzer *) {
+		RaiseError(err);
+	});
+
+	// Initialize bytecode compiler
+	compiler_.reset(new Compiler(obm_.get()));
 	
 	// Initialize Lexer
 	lex_.reset(new Lexer(obm_.get()));
@@ -228,18 +256,35 @@ bool Mach::Init() {
 		RaiseError(err);
 	});
 	global_env_ = obm_->GlobalEnvironment();
+	values::StackScanner stack;
+	stack_guard_ = stack.Limit() + kNativeStackReserve;
+
+	// The closures of prelude can be called by both engines.
+	Engine engine = engine_;
+	engine_ = kBytecode;
+	Lexer prelude(obm_.get());
+	prelude.Feed(kPrelude, sizeof(kPrelude) - 1);
+	for (Object *o; (o = prelude.Next()) != nullptr;) {
+		if (!Eval(o, global_env_))
+			return false;
+	}
+	engine_ = engine;
+	resume_ = global_env_->Lookup("ajimu.resume");
+	if (auto_seal_)
+		obm_->RequestSeal();
 	return true;
 }
 
 Object *Mach::Feed(const char *input, size_t len) {
 	lex_->Feed(input, len);
 	values::Object *o, *rv = nullptr;
+	int error = error_;
 	while ((o = lex_->Next()) != nullptr) {
 		rv = Eval(o, global_env_);
 		if (!rv)
 			return nullptr;
 	}
-	return rv;
+	return error_ == error ? rv : nullptr; // Or the lexer raised error
 }
 
 Object *Mach::EvalFile(const char *name) {
@@ -263,255 +308,776 @@ Object *Mach::EvalFile(const char *name) {
 	// Eval it!
 	StackPersisted<std::string> persisted(&file_level_, name);
 	Lexer lex(obm_.get());
+	lex.AddObserver([this] (const char *err, Lexer *) {
+		RaiseError(err);
+	});
 	lex.Feed(buf.get(), size);
-	Object *o, *rv;
+	Object *o, *rv = Kof(EmptyList);
+	int error = error_;
 	while ((o = lex.Next()) != nullptr) {
 		rv = Eval(o, GlobalEnvironment());
 		if (!rv)
 			return nullptr;
 	}
-	return rv;
+	return error_ == error ? rv : nullptr; // Or the lexer raised error
 }
 
 Object *Mach::Eval(Object *expr, Environment *env) {
+	Local<Object>::Persisted persisted(local_val_.get());
+
+	// Keep the source and the expansions reachable, the node tree refer
+	// to them.
+	Push(expr);
+	Object *expanded = Kof(EmptyList);
+	Node *node = analyzer_->Analyze(expr, env, &expanded);
+	if (!node)
+		return nullptr;
+	Push(expanded);
+	Object *rv;
+	if (engine_ == kBytecode) {
+		// Shared with the full continuations, they may resume it after
+		// this eval. The lambdas of code are owned by the node tree.
+		node->Ref();
+		std::shared_ptr<Code> code(
+				compiler_->Compile(node, env == global_env_),
+				[node] (Code *code) {
+					delete code;
+					node->Unref();
+				});
+		rv = Run(code, expanded == Kof(EmptyList) ?
+				expr : obm_->Cons(expr, expanded), env);
+	} else {
+		rv = Execute(node, env);
+	}
+	node->Unref();
+	// The afters of dynamic-wind be skipped by error.
+	if (!rv && runs_.empty() && call_level_ == 0) {
+		winders_    = Kof(EmptyList);
+		escape_to_  = nullptr;
+		escape_val_ = nullptr;
+	}
+	return rv;
+}
+
+Object *Mach::Execute(Node *node, Environment *env) {
 	utils::ScopedCounter<int>     counter(&call_level_);
 	Local<Object>::Persisted      persisted_val(local_val_.get());
 	Local<Environment>::Persisted persisted_env(local_env_.get());
+	const auto val_base = local_val_->Mark();
+	const auto env_base = local_env_->Mark();
+	// Be in memory for conservative gc, the body node is owned by it.
+	Object *volatile closure = nullptr;
+	if (!CheckCallDepth(call_level_))
+		return nullptr;
 
 newenv:
 	local_env_->Push(env);
 tailcall:
-	local_val_->Push(expr);
 	obm_->GcTick(local_val_.get(), local_env_.get());
 
-	// Sample statement
-	if (obm_->Null(expr))
-		goto fail;
-	if (IsSelfEvaluating(expr))
-		return expr;
-	if (IsVariable(expr))
-		return LookupVariable(expr, env);
-	if (IsDefinition(expr, obm_.get()))
-		return EvalDefinition(expr, env);
-	if (IsLambda(expr, obm_.get()))
-		return obm_->NewClosure(cadr(expr), cddr(expr), env);
-	if (IsQuoted(expr, obm_.get()))
-		return cadr(expr); // Text of quotation
-	if (IsAssignment(expr, obm_.get()))
-		return EvalAssignment(expr, env);
+	switch (node->NodeKind()) {
+	case Node::kConstant:
+		return static_cast<Constant*>(node)->Value();
 
-	// If statement
-	if (IsIf(expr, obm_.get())) {
-		expr = Eval(cadr(expr), env) != Kof(False) ? // cadr: if predicate
-			caddr(expr) : // caddr: consequent
-			// if Alternative
-			cdddr(expr) == Kof(EmptyList) ? Kof(False) : cadddr(expr);
-		Pop(1);
-		goto tailcall;
-	}
+	case Node::kVariable: {
+			auto var = static_cast<Variable*>(node);
+			if (var->Global())
+				return LookupGlobal(var->Symbol(), var->Cell());
+			return LookupVariable(var->Symbol(), env);
+		}
 
-	// And Or statement
-	if (IsAnd(expr, obm_.get())) {
-		expr = cdr(expr); // cdr: and tests
-		if (expr == Kof(EmptyList))
-			return Kof(True);
-		while (cdr(expr) != Kof(EmptyList)) {  // Is not last expr?
-			Object *rv = Eval(car(expr), env); // car: first expr
-			if (!rv)
+	case Node::kDefinition: {
+			auto def = static_cast<Assignment*>(node);
+			Object *val = Execute(def->Value(), env);
+			if (!val)
 				return nullptr;
-			if (rv == Kof(False))
-				return Kof(False);
-			expr = cdr(expr); // cdr: rest expr
+			env->Define(def->Symbol()->Symbol(), val);
+			obm_->WriteBarrier(env, val);
 		}
-		expr = car(expr);
-		Pop(1);
-		goto tailcall;
-	}
+		return Kof(OkSymbol);
 
-	if (IsOr(expr, obm_.get())) {
-		expr = cdr(expr); // cdr: or tests
-		if (expr == Kof(EmptyList))
-			return Kof(False);
-		while (cdr(expr) != Kof(EmptyList)) { // Is not last expr?
-			Object *rv = Eval(car(expr), env); // car: first expr
+	case Node::kAssignment: {
+			auto assign = static_cast<Assignment*>(node);
+			Object *val = Execute(assign->Value(), env);
+			if (!val)
+				return nullptr;
+			return ExecuteAssignment(assign->Symbol(), val, env);
+		}
+
+	case Node::kSyntaxDefinition: {
+			auto def = static_cast<SyntaxDefinition*>(node);
+			env->Define(def->Name()->Symbol(), def->Syntax());
+			obm_->WriteBarrier(env, def->Syntax());
+		}
+		return Kof(OkSymbol);
+
+	case Node::kLambda:
+		return obm_->NewClosure(static_cast<Lambda*>(node), env);
+
+	// If statement
+	case Node::kIf: {
+			auto branch = static_cast<If*>(node);
+			Object *rv = Execute(branch->Predicate(), env);
 			if (!rv)
 				return nullptr;
-			if (rv == Kof(True))
-				return Kof(True);
-			expr = cdr(expr); // cdr: rest expr
+			node = rv != Kof(False) ?
+				branch->Consequent() : branch->Alternative();
 		}
-		expr = car(expr);
-		Pop(1);
 		goto tailcall;
-	}
 
+	// And Or statement
+	case Node::kAnd:
+	case Node::kOr:
 	// Begin block
-	if (IsBegin(expr, obm_.get())) {
-		expr = cdr(expr); // cdr: begin action
-		while (cdr(expr) != Kof(EmptyList)) { // Is last action?
-			if (!Eval(car(expr), env)) // car: first action
-				return nullptr;
-			expr = cdr(expr);     // cdr: rest actions
+	case Node::kSequence: {
+			auto &actions = static_cast<Sequence*>(node)->Actions();
+			for (size_t i = 0; i < actions.size() - 1; ++i) {
+				Object *rv = Execute(actions[i], env);
+				if (!rv)
+					return nullptr;
+				if (node->NodeKind() == Node::kAnd && rv == Kof(False))
+					return Kof(False);
+				if (node->NodeKind() == Node::kOr && rv == Kof(True))
+					return Kof(True);
+			}
+			node = actions.back(); // The last one is tail expr.
 		}
-		expr = car(expr);
-		Pop(1);
 		goto tailcall;
-	}
 
-	// Syntax transfer
-	if (expr->IsPair()) {
-		if (car(expr) == Kof(DefineSyntax))
-			return EvalSyntaxDefinition(expr, env);
-		Object *name = car(expr);
-		if (name->IsSymbol()) {
-			Object *syntax = LookupVariable(name, env);
-			if (!syntax)
-				return nullptr;
-			if (syntax->IsPair() &&
-					car(syntax) == Kof(DefineSyntax)) {
-				Object *o = factory_->Extend(syntax, expr);
-				if (o) {
-					expr = o;
-					Pop(1);
-					goto tailcall;
+	// Exec block
+	case Node::kApplication: {
+			auto app = static_cast<Application*>(node);
+			Object *proc = Execute(app->Operator(), env);
+			if (!proc)
+				return nullptr; // May be error.
+			Hold(proc);
+			// No list of arguments for the primitive and closure.
+			if (Object::IsPrimitive(proc) && proc->Primitive()->method)
+				return ExecutePrimitive(proc->Primitive(), app->Operands(),
+						env);
+			int argc = static_cast<int>(app->Operands().size());
+			if (Object::IsClosure(proc)) {
+				// Bind from stack, no list of arguments.
+				if (!EvalOperands(app->Operands(), env, nullptr))
+					return nullptr;
+			} else {
+				Object *args = ListOfValues(app->Operands(), env);
+				if (!args)
+					return nullptr;
+				Hold(args);
+				if (Object::IsPrimitive(proc) && proc->Primitive() == &kApply) {
+					if (app->Operands().size() < 2) {
+						RaiseError("apply : Need a procedure and a list.");
+						return nullptr;
+					}
+					proc = car(args);
+					args = PrepareApplyOperands(cdr(args), obm_.get());
+					Hold(proc);
+					Hold(args);
+					Object *rest = args;
+					while (rest != Kof(EmptyList) && Object::IsPair(rest))
+						rest = cdr(rest);
+					if (rest != Kof(EmptyList)) {
+						RaiseError("apply : The last one is not a list.");
+						return nullptr;
+					}
+				}
+				if (Object::IsPrimitive(proc)) {
+					if (proc->Primitive() == &kEval) {
+						// TODO env  = MakeEnvironment() cadr
+						return args != Kof(EmptyList) ?
+							Eval(car(args), env) : nullptr;
+					}
+					if (proc->Primitive() == &kCallCC ||
+							proc->Primitive() == &kCallEC)
+						return CallWithEscape(proc->Primitive(), args);
+					if (!proc->Primitive()->method) {
+						RaiseErrorf("%s : Can not be applied.",
+								proc->Primitive()->name);
+						return nullptr;
+					}
+					return ApplyPrimitive(proc->Primitive(), args);
+				}
+				if (Object::IsContinuation(proc))
+					return Throw(proc, args);
+				if (!Object::IsClosure(proc)) {
+					RaiseError("Unknown procedure type.");
+					return nullptr;
 				}
+				for (argc = 0; args != Kof(EmptyList); args = cdr(args))
+					Push(car(args)), ++argc;
 			}
+			env = ExtendEnvironment(proc, proc->Lambda()->Names(), argc);
+			node = proc->Lambda()->Body();
+			local_val_->Reset(val_base);
+			local_env_->Reset(env_base);
+			// Keep the closure reachable, the body node is owned by it.
+			closure = proc;
+			DCHECK_EQ(proc, closure);
+			Hold(proc);
 		}
+		goto newenv;
 	}
+	RaiseError("Bad eval! no one can be evaluated.");
+	return nullptr;
+}
 
-	// Exec block
-	if (expr->IsPair()) { // Is application 
-		Push(Eval(car(expr), env)); // proc | car: operator
-		//if (!proc)
-		if (!Last(0)) {
-			Pop(1);
-			return nullptr; // May be error.
+Object *Mach::Run(const std::shared_ptr<Code> &toplevel, Object *source,
+		Environment *env) {
+	Local<Object>::Persisted      persisted_val(local_val_.get());
+	Local<Environment>::Persisted persisted_env(local_env_.get());
+	// The frames below base belong to the outer runs.
+	runs_.push_back(++serial_);
+	struct RunScope {
+		Mach *mach;
+		size_t base;
+		Object *installed;
+		~RunScope() {
+			mach->frames_.resize(base);
+			mach->runs_.pop_back();
+			mach->installed_ = installed;
 		}
-		Push(ListOfValues(cdr(expr), env)); // args | cdr: operands
+	} scope = { this, frames_.size(), installed_ };
+	const uint64_t id = runs_.back();
+	const size_t val_base = local_val_->Count();
+	const size_t env_base = local_env_->Count();
+	if (!CheckCallDepth(scope.base))
+		return nullptr;
+	Code *code = toplevel.get();
+	const uint32_t *pc = code->Begin();
+	Object *rv, *k;
+	uint64_t serial = 0; // Of the next frame, if it has been captured
+	int argc;
 
-		if (Last(1)->IsPrimitive() && Last(1)->Primitive() == kApply) {
-			Object *args = Last(0);
-			Pop(2); Push(args);
-			Push(car(Last(0))); // proc
-			Push(PrepareApplyOperands(cdr(Last(0)), obm_.get())); // args
-		}
-		if (Last(1)->IsPrimitive()) {
-			auto fn = Last(1)->Primitive();
-			if (fn == kEval) {
-				expr = car(Last(0));
-				// TODO env  = MakeEnvironment() cadr
-				Pop(3);
-				goto tailcall;
+	local_env_->Push(env);
+	for (;;) {
+		const uint32_t ins = *pc++;
+		switch (Code::Op(ins)) {
+		case Code::kConstant:
+			Push(code->ConstantAt(Code::Arg(ins)));
+			break;
+
+		case Code::kLoadLocal:
+			Push(Frame(env, Code::Depth(Code::Arg(ins)))->At(
+						Code::Slot(Code::Arg(ins))));
+			break;
+
+		case Code::kLoadName:
+			rv = LookupVariable(code->ConstantAt(Code::Arg(ins)), env);
+			if (!rv)
+				return nullptr;
+			Push(rv);
+			break;
+
+		case Code::kLoadGlobal:
+			rv = LookupGlobal(code->ConstantAt(Code::Arg(ins)),
+					code->CellAt(Code::Arg(ins)));
+			if (!rv)
+				return nullptr;
+			Push(rv);
+			break;
+
+		case Code::kStoreLocal: {
+				Environment *frame = Frame(env, Code::Depth(Code::Arg(ins)));
+				frame->Set(Code::Slot(Code::Arg(ins)), Last(0));
+				obm_->WriteBarrier(frame, Last(0));
 			}
-			//Push(args);
-			return (this->*fn)(Last(0));
-		}
-		if (Last(1)->IsClosure()) {
-			env = ExtendEnvironment(Last(1)->Params(),
-					Last(0),
-					Last(1)->Environment());
-			// Make begin block
-			expr = obm_->Cons(Kof(BeginSymbol), Last(1)->Body());
+			Pop(1);
+			Push(Kof(OkSymbol));
+			break;
+
+		case Code::kStoreName:
+			rv = ExecuteAssignment(code->ConstantAt(Code::Arg(ins)), Last(0),
+					env);
+			if (!rv)
+				return nullptr;
+			Pop(1);
+			Push(rv);
+			break;
+
+		case Code::kStoreGlobal: {
+				// Check it be bound, and update the cell in place.
+				int *cell = code->CellAt(Code::Arg(ins));
+				if (*cell < 0 && !LookupGlobal(
+							code->ConstantAt(Code::Arg(ins)), cell))
+					return nullptr;
+				global_env_->Set(*cell, Last(0));
+				obm_->WriteBarrier(global_env_, Last(0));
+			}
+			Pop(1);
+			Push(Kof(OkSymbol));
+			break;
+
+		case Code::kDefine:
+			env->Define(code->ConstantAt(Code::Arg(ins))->Symbol(), Last(0));
+			obm_->WriteBarrier(env, Last(0));
+			Pop(1);
+			Push(Kof(OkSymbol));
+			break;
+
+		case Code::kDefineLocal:
+			env->Set(Code::Arg(ins), Last(0));
+			obm_->WriteBarrier(env, Last(0));
+			Pop(1);
+			Push(Kof(OkSymbol));
+			break;
+
+		case Code::kClosure:
+			Push(obm_->NewClosure(code->LambdaAt(Code::Arg(ins)), env));
+			break;
+
+		case Code::kPop:
+			Pop(1);
+			break;
+
+		case Code::kJump:
+			pc = code->Begin() + Code::Arg(ins);
+			break;
+
+		case Code::kJumpIfFalse:
+			rv = Last(0);
+			Pop(1);
+			if (rv == Kof(False))
+				pc = code->Begin() + Code::Arg(ins);
+			break;
+
+		case Code::kJumpIfFalseOrPop:
+			if (Last(0) == Kof(False))
+				pc = code->Begin() + Code::Arg(ins);
+			else
+				Pop(1);
+			break;
+
+		case Code::kJumpIfTrueOrPop:
+			if (Last(0) == Kof(True))
+				pc = code->Begin() + Code::Arg(ins);
+			else
+				Pop(1);
+			break;
+
+		case Code::kCall:
+		case Code::kTailCall: {
+				argc = Code::Arg(ins);
+				serial = 0;
+				obm_->GcTick(local_val_.get(), local_env_.get());
+			call:
+				Object *proc = Last(argc);
+				if (Object::IsPrimitive(proc) && proc->Primitive() == &kApply) {
+					if (argc < 2) {
+						RaiseError("apply : Need a procedure and a list.");
+						return nullptr;
+					}
+					// Spread the arguments: (apply f a b '(c d)), then drop
+					// the apply from stack.
+					Object *rest = Last(0);
+					Pop(1);
+					for (--argc; rest != Kof(EmptyList); ++argc) {
+						if (!Object::IsPair(rest)) {
+							RaiseError("apply : The last one is not a list.");
+							return nullptr;
+						}
+						Push(car(rest));
+						rest = cdr(rest);
+					}
+					for (int i = argc; i > 0; --i)
+						local_val_->Set(i, Last(i - 1));
+					Pop(1);
+					--argc;
+					goto call;
+				}
+				if (Object::IsPrimitive(proc) &&
+						(proc->Primitive() == &kCallCC ||
+						 proc->Primitive() == &kCallEC)) {
+					if (argc != 1) {
+						RaiseErrorf("%s : Wrong number of arguments, %d be "
+								"given.", proc->Primitive()->name, argc);
+						return nullptr;
+					}
+					Continuation *c = new Continuation();
+					c->full = proc->Primitive() == &kCallCC;
+					c->run  = id;
+					if (Code::Op(ins) == Code::kTailCall) {
+						// Return to the caller, as the current one does.
+						DCHECK_GT(frames_.size(), scope.base);
+						const CallFrame &caller = frames_.back();
+						c->serial = caller.serial;
+						c->depth  = frames_.size() - 1;
+						c->vals   = local_val_->Count() - 3;
+						c->envs   = local_env_->Count() - 1;
+						c->code   = caller.code;
+						c->pc     = caller.pc;
+						c->env    = caller.env;
+					} else {
+						// Return to here, the frame be pushed by calling.
+						c->serial = serial = ++serial_;
+						c->depth  = frames_.size();
+						c->vals   = local_val_->Count() - 2;
+						c->envs   = local_env_->Count();
+						c->code   = code;
+						c->pc     = pc;
+						c->env    = env;
+					}
+					c->winders = winders_;
+					if (c->full) {
+						c->frames.assign(frames_.begin() + scope.base,
+								frames_.begin() + c->depth);
+						local_val_->CopyTo(val_base, c->vals, &c->saved_vals);
+						local_env_->CopyTo(env_base, c->envs, &c->saved_envs);
+						c->toplevel  = toplevel;
+						c->source    = source;
+						c->installed = installed_;
+					}
+					// (call/cc f) => (f k)
+					k = obm_->NewContinuation(c);
+					local_val_->Set(1, Last(0));
+					local_val_->Set(0, k);
+					goto call;
+				}
+				if (Object::IsPrimitive(proc)) {
+					if (proc->Primitive() == &kEval)
+						rv = argc > 0 ? Eval(Last(argc - 1), env) : nullptr;
+					else
+						rv = CallPrimitive(proc->Primitive(), argc);
+					if (!rv) {
+						if (!escape_to_ ||
+								escape_to_->Continuation()->run != id)
+							return nullptr;
+						// Escaped from a nested run to this one.
+						k  = escape_to_;
+						rv = escape_val_;
+						escape_to_  = nullptr;
+						escape_val_ = nullptr;
+						goto resume;
+					}
+					Pop(argc + 1);
+					Push(rv);
+					if (Code::Op(ins) == Code::kTailCall)
+						goto ret;
+					break;
+				}
+				if (Object::IsClosure(proc)) {
+					Environment *callee = ExtendEnvironment(proc,
+							proc->Lambda()->Code()->Names(), argc);
+					Pop(argc);
+					if (Code::Op(ins) == Code::kTailCall) {
+						// Replace the closure of current frame.
+						DCHECK_GT(frames_.size(), scope.base);
+						Pop(2);
+						Push(proc);
+						local_env_->Pop(1);
+					} else {
+						// Keep the closure in stack until return, the code
+						// is owned by it.
+						if (!CheckCallDepth(frames_.size() + 1))
+							return nullptr;
+						frames_.push_back(CallFrame{code, pc, env,
+								serial ? serial : ++serial_});
+					}
+					env = callee;
+					local_env_->Push(env);
+					code = proc->Lambda()->Code();
+					pc = code->Begin();
+					break;
+				}
+				if (Object::IsContinuation(proc)) {
+					if (argc != 1) {
+						RaiseErrorf("Continuation : Wrong number of arguments, "
+								"%d be given.", argc);
+						return nullptr;
+					}
+					Continuation *c = proc->Continuation();
+					if (c->winders != winders_) {
+						// Travel first: (ajimu.resume k v winders)
+						rv = Last(0);
+						local_val_->Set(1, resume_);
+						local_val_->Set(0, proc);
+						Push(rv);
+						Push(c->winders);
+						argc = 3;
+						goto call;
+					}
+					k  = proc;
+					rv = Last(0);
+					if (c->run != id && IsLiveRun(c->run)) {
+						// Unwind the native stack to its run.
+						escape_to_  = k;
+						escape_val_ = rv;
+						return nullptr;
+					}
+					goto resume;
+				}
+				RaiseError("Unknown procedure type.");
+			}
+			return nullptr;
+
+		resume: {
+				// Return rv to the continuation k.
+				Continuation *c = k->Continuation();
+				if (c->run == id && frames_.size() > c->depth &&
+						frames_[c->depth].serial == c->serial) {
+					// Escape: the frame is still in stack.
+					frames_.resize(c->depth);
+					Pop(local_val_->Count() - c->vals);
+					local_env_->Pop(local_env_->Count() - c->envs);
+				} else if (c->full) {
+					// Re-enter: install the copies into this run.
+					frames_.resize(scope.base);
+					frames_.insert(frames_.end(), c->frames.begin(),
+							c->frames.end());
+					Pop(local_val_->Count() - val_base);
+					for (auto val : c->saved_vals)
+						Push(val);
+					local_env_->Pop(local_env_->Count() - env_base);
+					for (auto saved : c->saved_envs)
+						local_env_->Push(saved);
+					if (c->run != id)
+						installed_ = obm_->Cons(k, installed_);
+				} else {
+					RaiseError("Continuation be invoked out of its extent.");
+					return nullptr;
+				}
+				code = c->code;
+				pc   = c->pc;
+				env  = c->env;
+				Push(rv);
+			}
+			break;
+
+		case Code::kReturn:
+		ret:
+			if (frames_.size() == scope.base)
+				return Last(0);
+			rv = Last(0);
+			Pop(2); // Result and the closure
+			Push(rv);
 			local_env_->Pop(1);
-			Pop(3);
-			goto newenv;
+			code = frames_.back().code;
+			pc   = frames_.back().pc;
+			env  = frames_.back().env;
+			frames_.pop_back();
+			break;
+
+		default:
+			DLOG(FATAL) << "No reached!";
+			return nullptr;
 		}
-		RaiseError("Unknown Last(0)edure type.");
-		return nullptr;
 	}
-fail:
-	RaiseError("Bad eval! no one can be evaluated.");
 	return nullptr;
 }
 
-Object *Mach::LookupVariable(Object *expr, Environment *env) {
-	Environment::Handle handle(expr->Symbol(), env);
-	if (!handle.Valid())
-		RaiseErrorf("Unbound variable, \"%s\".", expr->Symbol());
-	return handle.Get();
+Object *Mach::Apply(Object *proc, Object *args) {
+	Local<Object>::Persisted persisted(local_val_.get());
+	Hold(proc);
+	Hold(args);
+	if (Object::IsClosure(proc)) {
+		int argc = 0;
+		for (; args != Kof(EmptyList); args = cdr(args), ++argc)
+			Push(car(args));
+		Environment *env = ExtendEnvironment(proc, proc->Lambda()->Names(),
+				argc);
+		return Execute(proc->Lambda()->Body(), env);
+	}
+	if (Object::IsContinuation(proc))
+		return Throw(proc, args);
+	if (Object::IsPrimitive(proc)) {
+		if (proc->Primitive() == &kCallCC || proc->Primitive() == &kCallEC)
+			return CallWithEscape(proc->Primitive(), args);
+		if (proc->Primitive()->method)
+			return ApplyPrimitive(proc->Primitive(), args);
+		RaiseErrorf("%s : Can not be applied.", proc->Primitive()->name);
+		return nullptr;
+	}
+	RaiseError("Unknown procedure type.");
+	return nullptr;
 }
 
-Object *Mach::EvalSyntaxDefinition(Object *expr, Environment *env) {
-	Object *name = cadr(expr);
-	if (!name->IsSymbol()) {
-		RaiseError("Bad syntax definition, need name.");
+Object *Mach::CallWithEscape(const PrimitiveProc *proc, Object *args) {
+	if (args == Kof(EmptyList) || cdr(args) != Kof(EmptyList)) {
+		RaiseErrorf("%s : Wrong number of arguments, %d be given.",
+				proc->name, args == Kof(EmptyList) ? 0 : 2);
 		return nullptr;
 	}
-	env->Define(name->Symbol(), expr);
-	return Kof(OkSymbol);
+	Local<Object>::Persisted persisted(local_val_.get());
+	Continuation *c = new Continuation();
+	c->run     = ++serial_;
+	c->winders = winders_;
+	Object *k = obm_->NewContinuation(c);
+	Hold(k);
+	runs_.push_back(c->run);
+	Object *rv = Apply(car(args), obm_->Cons(k, Kof(EmptyList)));
+	runs_.pop_back();
+	if (!rv && escape_to_ == k) {
+		rv = escape_val_;
+		escape_to_  = nullptr;
+		escape_val_ = nullptr;
+	}
+	return rv;
 }
 
-Object *Mach::EvalDefinition(Object *expr, Environment *env) {
-	Object *var, *val;
-	if (cadr(expr)->IsSymbol()) {
-		var = cadr(expr);
-		val = caddr(expr);
-	} else {
-		var = caadr(expr);
-		val = MakeLambda(cdadr(expr), cddr(expr), obm_.get());
+Object *Mach::Throw(Object *k, Object *args) {
+	if (args == Kof(EmptyList) || cdr(args) != Kof(EmptyList)) {
+		RaiseErrorf("Continuation : Wrong number of arguments, %d be given.",
+				args == Kof(EmptyList) ? 0 : 2);
+		return nullptr;
+	}
+	Continuation *c = k->Continuation();
+	if (c->winders != winders_) {
+		// Travel first: (ajimu.resume k v winders)
+		Local<Object>::Persisted persisted(local_val_.get());
+		Hold(args);
+		Object *resume_args = obm_->Cons(c->winders, Kof(EmptyList));
+		Hold(resume_args);
+		resume_args = obm_->Cons(car(args), resume_args);
+		Hold(resume_args);
+		return Apply(resume_, obm_->Cons(k, resume_args));
 	}
-	val = Eval(val, env);
-	if (!val)
+	if (!IsLiveRun(c->run)) {
+		RaiseError("Continuation be invoked out of its extent.");
 		return nullptr;
-	env->Define(var->Symbol(), val);
-	return Kof(OkSymbol);
+	}
+	// Unwind the native stack to the catch point.
+	escape_to_  = k;
+	escape_val_ = car(args);
+	return nullptr;
 }
 
-Object *Mach::EvalAssignment(Object *expr, Environment *env) {
-	Object *var = cadr(expr); // cadr: assignment variable
-	if (!var->IsSymbol()) {
-		RaiseError("set! : Unexpected symbol.");
-		return nullptr;
+bool Mach::IsLiveRun(uint64_t run) const {
+	return std::find(runs_.begin(), runs_.end(), run) != runs_.end();
+}
+
+bool Mach::CheckCallDepth(size_t depth) {
+	uintptr_t sp = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+	if (depth < max_call_depth_ && sp > stack_guard_)
+		return true;
+	RaiseErrorf("Call stack overflow, depth %zd.", depth);
+	return false;
+}
+
+Object *Mach::LookupVariable(Object *expr, Environment *env) {
+	Environment::Handle handle(expr->Symbol(), env);
+	if (!handle.Valid())
+		RaiseErrorf("Unbound variable, \"%s\".", expr->Symbol());
+	return handle.Get();
+}
+
+Object *Mach::LookupGlobal(Object *symbol, int *cell) {
+	if (*cell < 0) {
+		*cell = global_env_->IndexOf(symbol->Symbol());
+		if (*cell < 0) {
+			RaiseErrorf("Unbound variable, \"%s\".", symbol->Symbol());
+			return nullptr;
+		}
 	}
-	Object *val = Eval(caddr(expr), env); // caddr: assignment values
-	if (!val)
-		return nullptr;
+	return global_env_->At(*cell);
+}
+
+Object *Mach::ExecuteAssignment(Object *var, Object *val,
+		Environment *env) {
 	Environment::Handle handle(var->Symbol(), env);
 	if (!handle.Valid()) {
 		RaiseErrorf("Unbound variable, %s.", var->Symbol());
 		return nullptr;
 	}
-	//env->Define(var->Symbol(), val);
 	handle.Set(var->Symbol(), val);
+	obm_->WriteBarrier(handle.Owner(), val);
 	return Kof(OkSymbol);
 }
 
-Object *Mach::ListOfValues(Object *operand, Environment *env) {
+Object *Mach::ListOfValues(const std::vector<Node*> &operands,
+		Environment *env) {
 	Local<Object>::Persisted persisted(local_val_.get());
+	Object *held[kMaxHeldOperands];
+	bool in_held = obm_->GcConservative() &&
+		operands.size() <= kMaxHeldOperands;
+	if (!EvalOperands(operands, env, in_held ? held : nullptr))
+		return nullptr;
 
-	Push(operand);
-	if (Last(0) == Kof(EmptyList))
-		return Kof(EmptyList);
+	Object *args = Kof(EmptyList);
+	for (size_t i = 0; i < operands.size(); ++i) {
+		args = obm_->Cons(in_held ? held[operands.size() - 1 - i] : Last(i),
+				args);
+	}
+	return args;
+}
+
+bool Mach::EvalOperands(const std::vector<Node*> &operands,
+		Environment *env, Object **held) {
+	for (size_t i = 0; i < operands.size(); ++i) {
+		Object *val = Execute(operands[i], env);
+		if (!val)
+			return false;
+		if (held)
+			held[i] = val;
+		else
+			Push(val);
+	}
+	return true;
+}
 
-	 // car: first operand
-	//Object *first = Eval(car(operand), env);
-	Push(Eval(car(Last(0)), env));
-	if (!Last(0))
+Object *Mach::ExecutePrimitive(const PrimitiveProc *proc,
+		const std::vector<Node*> &operands, Environment *env) {
+	Local<Object>::Persisted persisted(local_val_.get());
+	Object *held[kMaxHeldOperands];
+	bool in_held = obm_->GcConservative() &&
+		operands.size() <= kMaxHeldOperands;
+	if (!EvalOperands(operands, env, in_held ? held : nullptr))
 		return nullptr;
-	// cdr: rest operands
-	Push(ListOfValues(cdr(Last(1)), env));
-	return obm_->Cons(Last(1), Last(0));
+
+	int argc = static_cast<int>(operands.size());
+	return in_held ? CallPrimitive(proc, held, argc) :
+		CallPrimitive(proc, argc);
 }
 
-Environment *Mach::ExtendEnvironment(Object *params, Object *args,
-		Environment *top) {
-	Environment *env = obm_->NewEnvironment(top);
-	while (params != Kof(EmptyList)) {
-		if (!car(params)->IsSymbol()) {
-			RaiseError("Parameters must be symbol.");
-			return nullptr;
-		}
-		if (args != Kof(EmptyList)) {
-			env->Define(car(params)->Symbol(), car(args));
-			args = cdr(args);
-		} else {
-			env->Define(car(params)->Symbol(), Kof(EmptyList));
-		}
-		params = cdr(params);
+Object *Mach::CallPrimitive(const PrimitiveProc *proc, int argc) {
+	Object **argv = local_val_->Top(argc);
+	if (argv)
+		return CallPrimitive(proc, argv, argc);
+	// The arguments are in two chunks of local, it's rare.
+	std::vector<Object*> copied(argc);
+	for (int i = 0; i < argc; ++i)
+		copied[i] = Last(argc - 1 - i);
+	return CallPrimitive(proc, copied.data(), argc);
+}
+
+Object *Mach::CallPrimitive(const PrimitiveProc *proc, Object **argv,
+		int argc) {
+	if (argc < proc->min_args ||
+			(proc->max_args >= 0 && argc > proc->max_args)) {
+		RaiseErrorf("%s : Wrong number of arguments, %d be given.",
+				proc->name, argc);
+		return nullptr;
 	}
+	return (this->*proc->method)(argv, argc);
+}
+
+Object *Mach::ApplyPrimitive(const PrimitiveProc *proc, Object *args) {
+	Local<Object>::Persisted persisted(local_val_.get());
+	int argc = 0;
+	for (; args != Kof(EmptyList); args = cdr(args), ++argc)
+		Push(car(args));
+	return CallPrimitive(proc, argc);
+}
+
+Environment *Mach::ExtendEnvironment(Object *closure,
+		const std::vector<Object*> &names, int argc) {
+	Environment *env = obm_->NewFrame(closure, &names);
+	Object **slots = env->Slots();
+	// Parameters first, see Compiler::Scope
+	size_t params = closure->Lambda()->Names().size();
+	size_t i = 0;
+	for (; i < params; ++i)
+		slots[i] = argc > 0 ? Last(--argc) : Kof(EmptyList);
+	for (; i < names.size(); ++i)
+		slots[i] = Kof(EmptyList);
 	return env;
 }
 
+Environment *Mach::Frame(Environment *env, int depth) {
+	while (depth--)
+		env = env->Next();
+	return DCHECK_NOTNULL(env);
+}
+
 void Mach::RaiseError(const char *err) {
 	++error_;
 	if (observer_.empty())
@@ -535,319 +1101,435 @@ void Mach::RaiseErrorf(const char *fmt, ...) {
 //
 //
 #define EXPECT_NUMBER(proc, idx) \
-	if (!car(args)->IsFixed() && \
-			!car(args)->IsReal()) { \
+	if (!Object::IsFixed(argv[idx]) && \
+			!Object::IsReal(argv[idx])) { \
 		RaiseErrorf(proc ": Unexpected type: arg%d, expected fixednum.",\
 				idx); \
 		return nullptr; \
 	} (void)0
 
-Object *Mach::Add(Object *args) {
+Object *Mach::Add(Object **argv, int argc) {
 	long long rvi = 0;
 	double    rvf = 0;
 	bool      isf  = false;
-	int       i = 0;
-	while (args != Kof(EmptyList)) {
+	for (int i = 0; i < argc; ++i) {
 		EXPECT_NUMBER("+", i);
 
 		if (!isf)
-			isf = car(args)->IsReal();
+			isf = Object::IsReal(argv[i]);
 		if (isf) {
 			if (rvi) {
 				rvf = rvi; rvi = 0LL;
 			}
-			rvf += car(args)->ToReal();
+			rvf += Object::ToReal(argv[i]);
 		} else {
-			rvi += car(args)->Fixed();
+			rvi += Object::Fixed(argv[i]);
 		}
-		args = cdr(args);
-		++i;
 	}
 	return isf ? obm_->NewReal(rvf) : obm_->NewFixed(rvi);
 }
 
-Object *Mach::Dec(Object *args) {
+Object *Mach::Dec(Object **argv, int argc) {
 	long long rvi = 0LL;
 	double    rvf = 0.0f;
-	bool      isf = car(args)->IsReal();
-	int       i = 1;
-	EXPECT_NUMBER("-", i);
+	bool      isf = Object::IsReal(argv[0]);
+	EXPECT_NUMBER("-", 0);
 	if (isf)
-		rvf = car(args)->Real();
+		rvf = argv[0]->Real();
 	else
-		rvi = car(args)->Fixed();
-	while ((args = cdr(args)) != Kof(EmptyList)) {
+		rvi = Object::Fixed(argv[0]);
+	for (int i = 1; i < argc; ++i) {
 		EXPECT_NUMBER("-", i);
 
 		if (!isf)
-			isf = car(args)->IsReal();
+			isf = Object::IsReal(argv[i]);
 		if (isf) {
 			if (rvi) {
 				rvf = rvi; rvi = 0LL;
 			}
-			rvf -= car(args)->ToReal();
+			rvf -= Object::ToReal(argv[i]);
 		} else {
-			rvi -= car(args)->Fixed();
+			rvi -= Object::Fixed(argv[i]);
 		}
-		++i;
 	}
 	return isf ? obm_->NewReal(rvf) : obm_->NewFixed(rvi);
 }
 
-Object *Mach::Mul(Object *args) {
+Object *Mach::Mul(Object **argv, int argc) {
 	long long rvi = 0LL;
 	double    rvf = 0.0f;
-	bool      isf = car(args)->IsReal();
-	int       i = 1;
-	EXPECT_NUMBER("*", i);
+	bool      isf = Object::IsReal(argv[0]);
+	EXPECT_NUMBER("*", 0);
 	if (isf)
-		rvf = car(args)->Real();
+		rvf = argv[0]->Real();
 	else
-		rvi = car(args)->Fixed();
-	while ((args = cdr(args)) != Kof(EmptyList)) {
+		rvi = Object::Fixed(argv[0]);
+	for (int i = 1; i < argc; ++i) {
 		EXPECT_NUMBER("*", i);
 
 		if (!isf)
-			isf = car(args)->IsReal();
+			isf = Object::IsReal(argv[i]);
 		if (isf) {
 			if (rvi) {
 				rvf = rvi; rvi = 0LL;
 			}
-			rvf *= car(args)->ToReal();
+			rvf *= Object::ToReal(argv[i]);
 		} else {
-			rvi *= car(args)->Fixed();
+			rvi *= Object::Fixed(argv[i]);
 		}
-		++i;
 	}
 	return isf ? obm_->NewReal(rvf) : obm_->NewFixed(rvi);
 }
 
-Object *Mach::Div(Object *args) {
+Object *Mach::Div(Object **argv, int argc) {
 	long long rvi = 0LL;
 	double    rvf = 0.0f;
-	bool      isf = car(args)->IsReal();
-	int       i = 1;
-	EXPECT_NUMBER("/", i);
+	bool      isf = Object::IsReal(argv[0]);
+	EXPECT_NUMBER("/", 0);
 	if (isf)
-		rvf = car(args)->Real();
+		rvf = argv[0]->Real();
 	else
-		rvi = car(args)->Fixed();
-	while ((args = cdr(args)) != Kof(EmptyList)) {
+		rvi = Object::Fixed(argv[0]);
+	for (int i = 1; i < argc; ++i) {
 		EXPECT_NUMBER("/", i);
 
-		if (car(args)->ToReal() == 0.0) {
+		if (Object::ToReal(argv[i]) == 0.0) {
 			RaiseErrorf("div : Can not divide by zero, in arg%d.", i);
 			return nullptr;
 		}
 		if (!isf)
-			isf = car(args)->IsReal();
+			isf = Object::IsReal(argv[i]);
 		if (isf) {
 			if (rvi) {
 				rvf = rvi; rvi = 0LL;
 			}
-			rvf /= car(args)->ToReal();
+			rvf /= Object::ToReal(argv[i]);
 		} else {
-			rvi /= car(args)->Fixed();
+			rvi /= Object::Fixed(argv[i]);
 		}
-		++i;
 	}
 	return isf ? obm_->NewReal(rvf) : obm_->NewFixed(rvi);
 }
 
-Object *Mach::NumberEqual(Object *args) {
+Object *Mach::NumberEqual(Object **argv, int argc) {
 	EXPECT_NUMBER("=", 0);
 
-	double arg0 = car(args)->ToReal();
-	int    i = 1;
-	while ((args = cdr(args)) != Kof(EmptyList)) {
+	double arg0 = Object::ToReal(argv[0]);
+	for (int i = 1; i < argc; ++i) {
 		EXPECT_NUMBER("=", i);
 
-		if (arg0 != car(args)->ToReal())
+		if (arg0 != Object::ToReal(argv[i]))
 			return Kof(False);
-		++i;
 	}
 	return Kof(True);
 }
 
-Object *Mach::NumberGreat(Object *args) {
+Object *Mach::NumberGreat(Object **argv, int argc) {
 	EXPECT_NUMBER(">", 0);
 
-	double arg0 = car(args)->ToReal();
-	int    i = 1;
-	while ((args = cdr(args)) != Kof(EmptyList)) {
+	double arg0 = Object::ToReal(argv[0]);
+	for (int i = 1; i < argc; ++i) {
 		EXPECT_NUMBER(">", i);
 
-		double next = car(args)->ToReal();
-		if (arg0 > car(args)->ToReal())
+		double next = Object::ToReal(argv[i]);
+		if (arg0 > next)
 			arg0 = next;
 		else
 			return Kof(False);
-		++i;
 	}
 	return Kof(True);
 }
 
-Object *Mach::NumberLess(Object *args) {
+Object *Mach::NumberLess(Object **argv, int argc) {
 	EXPECT_NUMBER("<", 0);
 
-	double arg0 = car(args)->ToReal();
-	int    i = 1;
-	while ((args = cdr(args)) != Kof(EmptyList)) {
+	double arg0 = Object::ToReal(argv[0]);
+	for (int i = 1; i < argc; ++i) {
 		EXPECT_NUMBER("<", i);
 
-		double next = car(args)->ToReal();
-		if (arg0 < car(args)->ToReal())
+		double next = Object::ToReal(argv[i]);
+		if (arg0 < next)
 			arg0 = next;
 		else
 			return Kof(False);
-		++i;
 	}
 	return Kof(True);
 }
 
 #undef EXPECT_NUMBER
 
-Object *Mach::Display(Object *args) {
-	Object *o = car(args);
-	printf("%s\n", o->ToString(obm_.get()).c_str());
+Object *Mach::Display(Object **argv, int /*argc*/) {
+	Object *o = argv[0];
+	printf("%s\n", Object::ToString(o, obm_.get()).c_str());
 	// TODO:
 	return Kof(OkSymbol);
 }
 
-Object *Mach::Cons(Object *args) {
-	return obm_->Cons(car(args), cadr(args));
+Object *Mach::Cons(Object **argv, int /*argc*/) {
+	return obm_->Cons(argv[0], argv[1]);
 }
 
-Object *Mach::Car(Object *args) {
-	if (!car(args)->IsPair()) {
+Object *Mach::Car(Object **argv, int /*argc*/) {
+	if (!Object::IsPair(argv[0]) || argv[0] == Kof(EmptyList)) {
 		RaiseError("car : arg0 is not a pair or list.");
 		return nullptr;
 	}
-	return caar(args);
+	return car(argv[0]);
 }
 
-Object *Mach::Cdr(Object *args) {
-	return cdar(args);
+Object *Mach::Cdr(Object **argv, int /*argc*/) {
+	if (!Object::IsPair(argv[0]) || argv[0] == Kof(EmptyList)) {
+		RaiseError("cdr : arg0 is not a pair or list.");
+		return nullptr;
+	}
+	return cdr(argv[0]);
 }
 
-Object *Mach::List(Object *args) {
-	return args;
+Object *Mach::List(Object **argv, int argc) {
+	Object *rv = Kof(EmptyList);
+	for (int i = argc; i-- > 0;)
+		rv = obm_->Cons(argv[i], rv);
+	return rv;
 }
 
-Object *Mach::SetCar(Object *args) {
-	if (!car(args)->IsPair()) {
+Object *Mach::SetCar(Object **argv, int /*argc*/) {
+	if (!Object::IsPair(argv[0]) || argv[0] == Kof(EmptyList)) {
 		RaiseError("set-car! : arg0 is not a pair or list.");
 		return nullptr;
 	}
-	ObjectManagement::SetCar(car(args), cadr(args));
+	obm_->SetCar(argv[0], argv[1]);
 	return Kof(OkSymbol);
 }
 
-Object *Mach::SetCdr(Object *args) {
-	if (!car(args)->IsPair()) {
+Object *Mach::SetCdr(Object **argv, int /*argc*/) {
+	if (!Object::IsPair(argv[0]) || argv[0] == Kof(EmptyList)) {
 		RaiseError("set-cdr! : arg0 is not a pair or list.");
 		return nullptr;
 	}
-	ObjectManagement::SetCdr(car(args), cadr(args));
+	obm_->SetCdr(argv[0], argv[1]);
 	return Kof(OkSymbol);
 }
 
 
-Object *Mach::Load(Object *args) {
-	if (!car(args)->IsString()) {
+Object *Mach::Load(Object **argv, int /*argc*/) {
+	if (!Object::IsString(argv[0])) {
 		RaiseError("load : arg0 is not a string.");
 		return nullptr;
 	}
-	const char *name = car(args)->String()->c_str();
-	return EvalFile(name);
+	const char *name = argv[0]->String()->c_str();
+	Object *rv = EvalFile(name);
+	if (rv && auto_seal_)
+		obm_->RequestSeal();
+	return rv;
 }
 
-Object *Mach::IsBoolean(Object *args) {
-	return car(args)->IsBoolean() ? Kof(True) : Kof(False);
+Object *Mach::IsBoolean(Object **argv, int /*argc*/) {
+	return Object::IsBoolean(argv[0]) ? Kof(True) : Kof(False);
 }
 
-Object *Mach::IsSymbol(Object *args) {
-	return car(args)->IsSymbol() ? Kof(True) : Kof(False);
+Object *Mach::IsSymbol(Object **argv, int /*argc*/) {
+	return Object::IsSymbol(argv[0]) ? Kof(True) : Kof(False);
 }
 
-Object *Mach::IsChar(Object *args) {
-	return car(args)->IsCharacter() ? Kof(True) : Kof(False);
+Object *Mach::IsChar(Object **argv, int /*argc*/) {
+	return Object::IsCharacter(argv[0]) ? Kof(True) : Kof(False);
 }
 
-Object *Mach::IsVector(Object *args) {
+Object *Mach::IsVector(Object ** /*argv*/, int /*argc*/) {
 	// TODO: Implement vector
-	(void)args;
 	return Kof(False);
 }
 
-Object *Mach::IsPort(Object *args) {
+Object *Mach::IsPort(Object ** /*argv*/, int /*argc*/) {
 	// TODO: Implement port
-	(void)args;
 	return Kof(False);
 }
 
-Object *Mach::IsNull(Object *args) {
-	return car(args) == Kof(EmptyList) ? Kof(True) : Kof(False);
+Object *Mach::IsNull(Object **argv, int /*argc*/) {
+	return argv[0] == Kof(EmptyList) ? Kof(True) : Kof(False);
 }
 
-Object *Mach::IsPair(Object *args) {
-	return car(args)->IsPair() ? Kof(True) : Kof(False);
+Object *Mach::IsPair(Object **argv, int /*argc*/) {
+	return Object::IsPair(argv[0]) ? Kof(True) : Kof(False);
 }
 
-Object *Mach::IsInteger(Object *args) {
-	return car(args)->IsFixed() ? Kof(True) : Kof(False);
+Object *Mach::IsInteger(Object **argv, int /*argc*/) {
+	return Object::IsFixed(argv[0]) ? Kof(True) : Kof(False);
 }
 
-Object *Mach::IsReal(Object *args) {
-	return car(args)->IsReal() ? Kof(True) : Kof(False);
+Object *Mach::IsReal(Object **argv, int /*argc*/) {
+	return Object::IsReal(argv[0]) ? Kof(True) : Kof(False);
 }
 
-Object *Mach::IsString(Object *args) {
-	return car(args)->IsString() ? Kof(True) : Kof(False);
+Object *Mach::IsString(Object **argv, int /*argc*/) {
+	return Object::IsString(argv[0]) ? Kof(True) : Kof(False);
 }
 
-Object *Mach::IsByteVector(Object *args) {
+Object *Mach::IsByteVector(Object ** /*argv*/, int /*argc*/) {
 	// TODO: Implement bytevector
-	(void)args;
 	return Kof(False);
 }
 
-Object *Mach::IsProcedure(Object *args) {
-	return car(args)->IsPrimitive() ||
-		car(args)->IsClosure() ? Kof(True) : Kof(False);
+Object *Mach::IsProcedure(Object **argv, int /*argc*/) {
+	return Object::IsPrimitive(argv[0]) || Object::IsClosure(argv[0]) ||
+		Object::IsContinuation(argv[0]) ? Kof(True) : Kof(False);
+}
+
+//
+// Equivalence predicates
+//
+Object *Mach::Eq(Object **argv, int /*argc*/) {
+	return argv[0] == argv[1] ? Kof(True) : Kof(False);
 }
 
 //
 // Error handling
 //
-Object *Mach::Error(Object *args) {
-	Object *msg = (args != Kof(EmptyList)) ? car(args) : nullptr;
+Object *Mach::Error(Object **argv, int argc) {
+	Object *msg = argc > 0 ? argv[0] : nullptr;
 	RaiseErrorf("Error() : %s",
-			msg ? msg->ToString(obm_.get()).c_str() : "Unspecified error.");
+			msg ? Object::ToString(msg, obm_.get()).c_str() :
+			"Unspecified error.");
 	return Kof(OkSymbol);
 }
 
 //
 // Extension Primitive Procedures:
 //
-Object *Mach::AjimuGcAllocated(Object * /*args*/) {
+Object *Mach::AjimuGcAllocated(Object ** /*argv*/, int /*argc*/) {
 	long long rv = obm_->Allocated();
 	return obm_->NewFixed(rv);
 }
 
-Object *Mach::AjimuGcState(Object * /*args*/) {
-	static const char *kState[ObjectManagement::kMaxState] = {
-		"pause",
-		"propagate",
-		"sweep-environment",
-		"sweep-string",
-		"sweep",
-		"finalize",
-	};
+static const char *kGcState[ObjectManagement::kMaxState] = {
+	"pause",
+	"propagate",
+	"sweep-environment",
+	"sweep-string",
+	"sweep",
+	"finalize",
+};
+
+Object *Mach::AjimuGcState(Object ** /*argv*/, int /*argc*/) {
 	int state = obm_->GcState();
 	DCHECK_LT(state,
-			static_cast<int>(sizeof(kState)/sizeof(kState[0])));
-	return obm_->NewSymbol(kState[state]);
+			static_cast<int>(sizeof(kGcState)/sizeof(kGcState[0])));
+	return obm_->NewSymbol(kGcState[state]);
+}
+
+//
+// (name . value) pairs to alist, in the same order.
+//
+typedef std::vector<std::pair<const char *, Object *>> AlistEntries;
+
+static Object *MakeAlist(ObjectManagement *obm,
+		const AlistEntries &entries) {
+	Object *rv = obm->Constant(values::kEmptyList);
+	for (auto i = entries.rbegin(); i != entries.rend(); ++i)
+		rv = obm->Cons(obm->Cons(obm->NewSymbol(i->first), i->second), rv);
+	return rv;
+}
+
+static Object *MakePhaseStats(ObjectManagement *obm,
+		const ObjectManagement::Stats::Phase &phase) {
+	Object *histogram = obm->Constant(values::kEmptyList);
+	for (int i = ObjectManagement::Stats::kHistogramSize - 1; i >= 0; --i) {
+		histogram = obm->Cons(obm->NewFixed(
+					static_cast<long long>(phase.histogram[i])), histogram);
+	}
+	return MakeAlist(obm, {
+		{ "ticks",     obm->NewFixed(phase.ticks), },
+		{ "time-us",   obm->NewFixed(phase.time_ns / 1000), },
+		{ "max-us",    obm->NewFixed(phase.max_ns / 1000), },
+		{ "histogram", histogram, },
+	});
+}
+
+Object *Mach::AjimuGcStats(Object ** /*argv*/, int /*argc*/) {
+	const ObjectManagement::Stats &stats = obm_->GcStats();
+	ObjectManagement *obm = obm_.get();
+
+	AlistEntries phases;
+	for (int i = 0; i < ObjectManagement::kMaxState; ++i)
+		phases.push_back({ kGcState[i], MakePhaseStats(obm, stats.phase[i]) });
+	phases.push_back({ "minor", MakePhaseStats(obm, stats.minor) });
+
+	return MakeAlist(obm, {
+		{ "major-cycles",   obm->NewFixed(stats.major_cycles), },
+		{ "minor-cycles",   obm->NewFixed(stats.minor_cycles), },
+		{ "pages-swept",    obm->NewFixed(stats.pages_swept), },
+		{ "objects-swept",  obm->NewFixed(stats.objects_swept), },
+		{ "object-bytes-swept", obm->NewFixed(stats.object_bytes_swept), },
+		{ "environments-swept", obm->NewFixed(stats.envs_swept), },
+		{ "environment-bytes-swept", obm->NewFixed(stats.env_bytes_swept), },
+		{ "strings-swept",  obm->NewFixed(stats.strings_swept), },
+		{ "string-bytes-swept", obm->NewFixed(stats.string_bytes_swept), },
+		{ "minor-objects-freed", obm->NewFixed(stats.minor_objects_freed), },
+		{ "minor-environments-freed", obm->NewFixed(stats.minor_envs_freed), },
+		{ "minor-bytes-freed", obm->NewFixed(stats.minor_bytes_freed), },
+		{ "promoted-bytes", obm->NewFixed(stats.promoted_bytes), },
+		{ "permanent-objects", obm->NewFixed(stats.permanent_objects), },
+		{ "permanent-environments", obm->NewFixed(stats.permanent_envs), },
+		{ "permanent-bytes", obm->NewFixed(stats.permanent_bytes), },
+		{ "phases",         MakeAlist(obm, phases), },
+	});
+}
+
+Object *Mach::AjimuGcThreshold(Object ** /*argv*/, int /*argc*/) {
+	long long rv = obm_->Threshold();
+	return obm_->NewFixed(rv);
+}
+
+Object *Mach::AjimuGcGrowth(Object **argv, int argc) {
+	if (argc > 0) {
+		if ((!Object::IsFixed(argv[0]) && !Object::IsReal(argv[0])) ||
+				Object::ToReal(argv[0]) < 1.0) {
+			RaiseError("ajimu.gc.growth : arg0 is not a number >= 1.");
+			return nullptr;
+		}
+		obm_->SetGcGrowth(Object::ToReal(argv[0]));
+	}
+	return obm_->NewReal(obm_->GcGrowth());
+}
+
+#define EXPECT_BYTES(proc) \
+	if (!Object::IsFixed(argv[0]) || Object::Fixed(argv[0]) < 0) { \
+		RaiseError(proc " : arg0 is not a non-negative fixednum."); \
+		return nullptr; \
+	} (void)0
+
+Object *Mach::AjimuGcMinHeap(Object **argv, int argc) {
+	if (argc > 0) {
+		EXPECT_BYTES("ajimu.gc.min-heap");
+		obm_->SetGcMinHeap(static_cast<size_t>(Object::Fixed(argv[0])));
+	}
+	long long rv = obm_->GcMinHeap();
+	return obm_->NewFixed(rv);
+}
+
+Object *Mach::AjimuGcMaxHeap(Object **argv, int argc) {
+	if (argc > 0) {
+		EXPECT_BYTES("ajimu.gc.max-heap");
+		obm_->SetGcMaxHeap(static_cast<size_t>(Object::Fixed(argv[0])));
+	}
+	long long rv = obm_->GcMaxHeap();
+	return obm_->NewFixed(rv);
+}
+
+#undef EXPECT_BYTES
+
+Object *Mach::AjimuWinders(Object ** /*argv*/, int /*argc*/) {
+	return winders_;
+}
+
+Object *Mach::AjimuSetWinders(Object **argv, int /*argc*/) {
+	winders_ = argv[0];
+	return Kof(OkSymbol);
+}
+
+Object *Mach::AjimuGcSeal(Object ** /*argv*/, int /*argc*/) {
+	obm_->RequestSeal();
+	return Kof(OkSymbol);
 }
 
 #undef Kof
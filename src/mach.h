@@ -1,6 +1,7 @@
 #ifndef AJIMU_VM_MACH_H
 #define AJIMU_VM_MACH_H
 
+#include <stdint.h>
 #include <memory>
 #include <functional>
 #include <vector>
@@ -11,17 +12,33 @@ namespace ajimu {
 namespace values {
 class ObjectManagement;
 class Object;
+struct PrimitiveProc;
 } // namespace values
 namespace vm {
 class Lexer;
 class MacroAnalyzer;
+class Analyzer;
+class Compiler;
 class Environment;
+class Node;
+class Code;
 template<class T> class Local;
 
+//
+// Default limit of call depth, the deeper calls raise error.
+//
+#define DEFAULT_MAX_CALL_DEPTH (2 * 1024 * 1024)
+
 class Mach {
 public:
 	typedef std::function<void (const char *, Mach *)> Observer;
 
+	// Execution engines
+	enum Engine {
+		kTree,     // Execute the analyzed node tree
+		kBytecode, // Compile the node tree to bytecode, and run it in VM
+	};
+
 	Mach();
 
 	~Mach();
@@ -36,6 +53,33 @@ public:
 		return error_;
 	}
 
+	Engine ExecutionEngine() const {
+		return engine_;
+	}
+
+	void SetExecutionEngine(Engine engine) {
+		engine_ = engine;
+	}
+
+	bool AutoSeal() const {
+		return auto_seal_;
+	}
+
+	// Seal the heap after initializing and after each load, the
+	// primitives and the loaded code become permanent.
+	void SetAutoSeal(bool on) {
+		auto_seal_ = on;
+	}
+
+	size_t MaxCallDepth() const {
+		return max_call_depth_;
+	}
+
+	// Frames of bytecode engine, or nested expressions of tree engine.
+	void SetMaxCallDepth(size_t depth) {
+		max_call_depth_ = depth;
+	}
+
 	int Line() const;
 
 	const char *File() const {
@@ -65,27 +109,88 @@ public:
 	// Primitive eval
 	values::Object *Eval(values::Object *expr, Environment *env);
 
+	// Continuation of a bytecode call, the control stack is made of them.
+	struct CallFrame {
+		Code *code;
+		const uint32_t *pc;
+		Environment *env;
+		uint64_t serial; // Unique, for the escape-only continuations
+	};
+
 private:
 	Mach(const Mach &) = delete;
 	void operator = (const Mach &) = delete;
 
+	enum {
+		// Native stack be kept for primitives and gc, when the tree engine
+		// recurses.
+		kNativeStackReserve = 256 * 1024,
+	};
+
+	// Raise error if the call is too deep.
+	bool CheckCallDepth(size_t depth);
+
+	// Execute the analyzed node tree
+	values::Object *Execute(Node *node, Environment *env);
+
+	// Run the compiled bytecode of toplevel, the source be kept for the
+	// continuations.
+	values::Object *Run(const std::shared_ptr<Code> &toplevel,
+			values::Object *source, Environment *env);
+
+	// Apply the procedure to the list of arguments, for tree engine.
+	values::Object *Apply(values::Object *proc, values::Object *args);
+
+	// Escape-only continuation of tree engine: the catch point is this
+	// native frame.
+	values::Object *CallWithEscape(const values::PrimitiveProc *proc,
+			values::Object *args);
+
+	// Invoke the continuation of tree engine.
+	values::Object *Throw(values::Object *k, values::Object *args);
+
+	// The run or the catch point is in native stack.
+	bool IsLiveRun(uint64_t run) const;
+
 	values::Object *LookupVariable(values::Object *expr,
 			Environment *env);
 
-	values::Object *EvalSyntaxDefinition(values::Object *expr,
-			Environment *env);
+	// Load the global variable from its cell, the cell be resolved and
+	// cached in *cell at the first time.
+	values::Object *LookupGlobal(values::Object *symbol, int *cell);
 
-	values::Object *EvalDefinition(values::Object *expr,
-			Environment *env);
+	values::Object *ExecuteAssignment(values::Object *var,
+			values::Object *val, Environment *env);
 
-	values::Object *EvalAssignment(values::Object *expr,
+	values::Object *ListOfValues(const std::vector<Node*> &operands,
 			Environment *env);
 
-	values::Object *ListOfValues(values::Object *operand,
-			Environment *env);
+	// Evaluate the operands in order, to held if it is not nullptr, or
+	// push them to local.
+	bool EvalOperands(const std::vector<Node*> &operands, Environment *env,
+			values::Object **held);
+
+	values::Object *ExecutePrimitive(const values::PrimitiveProc *proc,
+			const std::vector<Node*> &operands, Environment *env);
+
+	// Call the primitive with the last argc ones in local.
+	values::Object *CallPrimitive(const values::PrimitiveProc *proc,
+			int argc);
 
-	Environment *ExtendEnvironment(values::Object *params,
-			values::Object *args, Environment *base);
+	values::Object *CallPrimitive(const values::PrimitiveProc *proc,
+			values::Object **argv, int argc);
+
+	// Call the primitive with the arguments in list, for apply.
+	values::Object *ApplyPrimitive(const values::PrimitiveProc *proc,
+			values::Object *args);
+
+	// Bind arguments in stack to a new frame of closure, the missing
+	// ones be '().
+	Environment *ExtendEnvironment(values::Object *closure,
+			const std::vector<values::Object*> &names, int argc);
+
+	// The frame of lexical address
+	static Environment *Frame(Environment *env, int depth);
 
 	// Operating for local
 	void Push(values::Object *o);
@@ -94,6 +199,10 @@ private:
 
 	values::Object *Last(size_t i) const;
 
+	// Keep it reachable: push to local, or nothing if the native stack
+	// be scanned by gc.
+	void Hold(values::Object *o);
+
 	// Error output:
 	void RaiseError(const char *err);
 
@@ -102,49 +211,77 @@ private:
 	//
 	// Primitive Procedures:
 	//
-	values::Object *Add(values::Object *args);
-	values::Object *Dec(values::Object *args);
-	values::Object *Mul(values::Object *args);
-	values::Object *Div(values::Object *args);
-	values::Object *NumberEqual(values::Object *args);
-	values::Object *NumberGreat(values::Object *args);
-	values::Object *NumberLess(values::Object *args);
-	values::Object *Display(values::Object *args);
-	values::Object *Cons(values::Object *args);
-	values::Object *Car(values::Object *args);
-	values::Object *Cdr(values::Object *args);
-	values::Object *List(values::Object *args);
-	values::Object *SetCar(values::Object *args);
-	values::Object *SetCdr(values::Object *args);
-	values::Object *Load(values::Object *args);
-	values::Object *IsBoolean(values::Object *args);
-	values::Object *IsSymbol(values::Object *args);
-	values::Object *IsChar(values::Object *args);
-	values::Object *IsVector(values::Object *args);
-	values::Object *IsPort(values::Object *args);
-	values::Object *IsNull(values::Object *args);
-	values::Object *IsPair(values::Object *args);
-	values::Object *IsInteger(values::Object *args);
-	values::Object *IsReal(values::Object *args);
-	values::Object *IsString(values::Object *args);
-	values::Object *IsByteVector(values::Object *args);
-	values::Object *IsProcedure(values::Object *args);
-	values::Object *Error(values::Object *args);
+	values::Object *Add(values::Object **argv, int argc);
+	values::Object *Dec(values::Object **argv, int argc);
+	values::Object *Mul(values::Object **argv, int argc);
+	values::Object *Div(values::Object **argv, int argc);
+	values::Object *NumberEqual(values::Object **argv, int argc);
+	values::Object *NumberGreat(values::Object **argv, int argc);
+	values::Object *NumberLess(values::Object **argv, int argc);
+	values::Object *Display(values::Object **argv, int argc);
+	values::Object *Cons(values::Object **argv, int argc);
+	values::Object *Car(values::Object **argv, int argc);
+	values::Object *Cdr(values::Object **argv, int argc);
+	values::Object *List(values::Object **argv, int argc);
+	values::Object *SetCar(values::Object **argv, int argc);
+	values::Object *SetCdr(values::Object **argv, int argc);
+	values::Object *Load(values::Object **argv, int argc);
+	values::Object *IsBoolean(values::Object **argv, int argc);
+	values::Object *IsSymbol(values::Object **argv, int argc);
+	values::Object *IsChar(values::Object **argv, int argc);
+	values::Object *IsVector(values::Object **argv, int argc);
+	values::Object *IsPort(values::Object **argv, int argc);
+	values::Object *IsNull(values::Object **argv, int argc);
+	values::Object *IsPair(values::Object **argv, int argc);
+	values::Object *IsInteger(values::Object **argv, int argc);
+	values::Object *IsReal(values::Object **argv, int argc);
+	values::Object *IsString(values::Object **argv, int argc);
+	values::Object *IsByteVector(values::Object **argv, int argc);
+	values::Object *IsProcedure(values::Object **argv, int argc);
+	values::Object *Eq(values::Object **argv, int argc);
+	values::Object *Error(values::Object **argv, int argc);
 
 	// Extension Primitive Procedures:
-	values::Object *AjimuGcAllocated(values::Object *args);
-	values::Object *AjimuGcState(values::Object *args);
+	values::Object *AjimuGcAllocated(values::Object **argv, int argc);
+	values::Object *AjimuGcState(values::Object **argv, int argc);
+	values::Object *AjimuGcThreshold(values::Object **argv, int argc);
+	// Telemetry of gc, in alist.
+	values::Object *AjimuGcStats(values::Object **argv, int argc);
+	// Get the pacing knob, or set it by the argument.
+	values::Object *AjimuGcGrowth(values::Object **argv, int argc);
+	values::Object *AjimuGcMinHeap(values::Object **argv, int argc);
+	values::Object *AjimuGcMaxHeap(values::Object **argv, int argc);
+	// Seal the heap at the next gc tick.
+	values::Object *AjimuGcSeal(values::Object **argv, int argc);
+	// List of (before . after) of dynamic-wind, from the innermost one.
+	values::Object *AjimuWinders(values::Object **argv, int argc);
+	values::Object *AjimuSetWinders(values::Object **argv, int argc);
 
 	std::unique_ptr<values::ObjectManagement> obm_;
 	std::unique_ptr<Local<values::Object>> local_val_;
 	std::unique_ptr<Local<Environment>>    local_env_;
 	std::unique_ptr<Lexer> lex_;
 	std::unique_ptr<MacroAnalyzer> factory_;
+	std::unique_ptr<Analyzer> analyzer_;
+	std::unique_ptr<Compiler> compiler_;
 	std::stack<std::string> file_level_;
 	std::vector<Observer> observer_;
+	std::vector<CallFrame> frames_; // Control stack of bytecode engine
+	std::vector<uint64_t> runs_;    // Live runs and catch points
+	uint64_t serial_;               // Last serial of runs and frames
+	// Roots of gc, out of local:
+	values::Object *winders_;    // Current winders of dynamic-wind
+	values::Object *escape_to_;  // Continuation of pending escape
+	values::Object *escape_val_; // Value of pending escape
+	values::Object *resume_;     // Travel winders, then invoke
+	values::Object *installed_;  // Full continuations run in current run
 	Environment *global_env_;
+	Engine engine_;
+	bool auto_seal_;
 	int error_;
 	int call_level_;
+	size_t max_call_depth_;
+	uintptr_t stack_guard_; // Native stack can not grow below it
 }; // class Mach
 
 } // namespace vm
@@ -1,6 +1,7 @@
 #include "mach.h"
 #include "environment.h"
 #include "object.h"
+#include "object_management.h"
 #include "string.h"
 #include "gmock/gmock.h"
 
@@ -10,10 +11,11 @@ namespace vm {
 using values::Object;
 using values::String;
 
-class MachTest : public ::testing::Test {
+class MachTest : public ::testing::TestWithParam<Mach::Engine> {
 protected:
 	virtual void SetUp() override {
 		mach_ = new Mach();
+		mach_->SetExecutionEngine(GetParam());
 		mach_->Init();
 	}
 
@@ -25,66 +27,70 @@ protected:
 	Mach *mach_;
 };
 
-TEST_F(MachTest, Sanity) {
+INSTANTIATE_TEST_CASE_P(Engines,
+		MachTest,
+		::testing::Values(Mach::kTree, Mach::kBytecode));
+
+TEST_P(MachTest, Sanity) {
 	Object *ok = mach_->Feed("#f");
 	ASSERT_TRUE(ok != nullptr);
-	ASSERT_EQ(false, ok->Boolean());
+	ASSERT_EQ(false, Object::Boolean(ok));
 
 	ok = mach_->Feed("110");
 	ASSERT_NE(nullptr, ok);
-	ASSERT_EQ(110, ok->Fixed());
+	ASSERT_EQ(110, Object::Fixed(ok));
 
 	ok = mach_->Feed("(define x 1)");
 	ASSERT_NE(nullptr, ok);
 	Object *var = mach_->GlobalEnvironment()->Lookup("x");
 	ASSERT_NE(nullptr, var);
-	ASSERT_TRUE(var->IsFixed());
-	ASSERT_EQ(1, var->Fixed());
+	ASSERT_TRUE(Object::IsFixed(var));
+	ASSERT_EQ(1, Object::Fixed(var));
 
 	ok = mach_->Feed("(define (add a b) (+ a b))");
 	ASSERT_NE(nullptr, ok);
 	var = mach_->GlobalEnvironment()->Lookup("add");
 	ASSERT_NE(nullptr, var);
-	ASSERT_TRUE(var->IsClosure());
+	ASSERT_TRUE(Object::IsClosure(var));
 
 	ok = mach_->Feed("(+ 1 1)");
 	ASSERT_NE(nullptr, ok);
-	ASSERT_EQ(2, ok->Fixed());
+	ASSERT_EQ(2, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, Definition) {
+TEST_P(MachTest, Definition) {
 	Object *ok = mach_->Feed(
 		"(define x 1) "
 		"(define y 2) "
 		"(+ x y)"
 	);
-	ASSERT_EQ(3, ok->Fixed());
+	ASSERT_EQ(3, Object::Fixed(ok));
 
 	ok = mach_->Feed(
 		"(define x (+ 1 (* 2 4))) " // x == 9
 		"(define y (* x 100)) "     // y == 900
 		"(+ x y) "                  // x + y = 909
 	);
-	ASSERT_EQ(909, ok->Fixed());
+	ASSERT_EQ(909, Object::Fixed(ok));
 
 	ok = mach_->Feed(
 		"(define x (lambda (a) (+ 1 a))) "
 		"(x 2)"
 	);
-	ASSERT_EQ(3, ok->Fixed());
+	ASSERT_EQ(3, Object::Fixed(ok));
 
 	ok = mach_->Feed(
 		"(define (foo a b c) (+ (/ a b) c))"
 		"(foo 4 2 6)"
 	);
-	ASSERT_EQ(8, ok->Fixed());
+	ASSERT_EQ(8, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, Begin) {
+TEST_P(MachTest, Begin) {
 	Object *ok = mach_->Feed(
 		"(begin (/ 10 2))"
 	);
-	ASSERT_EQ(5, ok->Fixed());
+	ASSERT_EQ(5, Object::Fixed(ok));
 
 	ok = mach_->Feed(
 		"(define x 0)"
@@ -94,10 +100,10 @@ TEST_F(MachTest, Begin) {
 		"	(- 0 2)"
 		"	(* 10 10))"
 	);
-	ASSERT_EQ(100, ok->Fixed());
+	ASSERT_EQ(100, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, Assignment) {
+TEST_P(MachTest, Assignment) {
 	Object *ok = mach_->Feed(
 		"(define x 0)"
 		"(define y 0)"
@@ -105,22 +111,22 @@ TEST_F(MachTest, Assignment) {
 		"(set! y 2)"
 		"(* x y)"
 	);
-	ASSERT_EQ(200, ok->Fixed());
+	ASSERT_EQ(200, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, If) {
+TEST_P(MachTest, If) {
 	Object *ok = mach_->Feed("(if #t 1)");
-	ASSERT_EQ(1, ok->Fixed());
+	ASSERT_EQ(1, Object::Fixed(ok));
 	ok = mach_->Feed("(if #f 1 0)");
-	ASSERT_EQ(0, ok->Fixed());
+	ASSERT_EQ(0, Object::Fixed(ok));
 	ok = mach_->Feed(
 		"(define (foo a b c)"
 		"	(and (= a b) (= b c)))"
 		"(foo 1 1 1)"
 	);
-	ASSERT_TRUE(ok->Boolean());
+	ASSERT_TRUE(Object::Boolean(ok));
 	ok = mach_->Feed("(foo 1 1 2)");
-	ASSERT_FALSE(ok->Boolean());
+	ASSERT_FALSE(Object::Boolean(ok));
 	ok = mach_->Feed(
 		"(define (<= a b)"
 		"	(or (= a b) (< a b)))"
@@ -128,56 +134,66 @@ TEST_F(MachTest, If) {
 		"	100"
 		"	200)"
 	);
-	ASSERT_EQ(100, ok->Fixed());
+	ASSERT_EQ(100, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, Lambda) {
+TEST_P(MachTest, Lambda) {
 	Object *ok = mach_->Feed(
 		"((lambda (a b c) (+ a (* b c))) 1 2 3)"
 	);
-	ASSERT_EQ(7, ok->Fixed());
+	ASSERT_EQ(7, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, Eval) {
+TEST_P(MachTest, BadForm) {
+	// Raise error but not crash, '() can not be taken apart.
+	ASSERT_EQ(nullptr, mach_->Feed("(quote)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(lambda)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(eval '(if))"));
+	Object *ok = mach_->Feed("(car '(1))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(1, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, Eval) {
 	Object *ok = mach_->Feed("(eval \'(+ 1 1))");
-	ASSERT_EQ(2, ok->Fixed());
+	ASSERT_EQ(2, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, List) {
+TEST_P(MachTest, List) {
 	Object *ok = mach_->Feed("(cons 1 #t)");
-	ASSERT_TRUE(ok->IsPair());
-	ASSERT_EQ(1, car(ok)->Fixed());
-	ASSERT_TRUE(cdr(ok)->Boolean());
+	ASSERT_TRUE(Object::IsPair(ok));
+	ASSERT_EQ(1, Object::Fixed(car(ok)));
+	ASSERT_TRUE(Object::Boolean(cdr(ok)));
 
 	ok = mach_->Feed("(cons 1 (cons #t -1))");
-	ASSERT_EQ(1, car(ok)->Fixed());
-	ASSERT_TRUE(cadr(ok)->Boolean());
-	ASSERT_EQ(-1, cddr(ok)->Fixed());
+	ASSERT_EQ(1, Object::Fixed(car(ok)));
+	ASSERT_TRUE(Object::Boolean(cadr(ok)));
+	ASSERT_EQ(-1, Object::Fixed(cddr(ok)));
 
 	ok = mach_->Feed(
 		"(define foo '(1 #f 2 #t))"
 		"(car foo)"
 	);
-	ASSERT_EQ(1, ok->Fixed());
+	ASSERT_EQ(1, Object::Fixed(ok));
 
 	ok = mach_->Feed("(cdr foo)");
-	ASSERT_FALSE(car(ok)->Boolean());
+	ASSERT_FALSE(Object::Boolean(car(ok)));
 
 	ok = mach_->Feed(
 		"(define baz (list 9 8 7 6))"
 		"(set-car! baz -1)"
 		"(car baz)"
 	);
-	ASSERT_EQ(-1, ok->Fixed());
+	ASSERT_EQ(-1, Object::Fixed(ok));
 
 	ok = mach_->Feed(
 		"(set-cdr! baz -2)"
 		"(cdr baz)"
 	);
-	ASSERT_EQ(-2, ok->Fixed());
+	ASSERT_EQ(-2, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, DefineSyntax) {
+TEST_P(MachTest, DefineSyntax) {
 	Object *ok = mach_->Feed(
 		"(define-syntax when"
 		"	(syntax-rules ()"
@@ -186,10 +202,10 @@ TEST_F(MachTest, DefineSyntax) {
 		"(when (= 1 1) (display 'equals) 1)"
 	);
 	ASSERT_NE(nullptr, ok);
-	ASSERT_EQ(1, ok->Fixed());
+	ASSERT_EQ(1, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, DefineSyntaxCond) {
+TEST_P(MachTest, DefineSyntaxCond) {
 	Object *ok = mach_->Feed(
 		"(define-syntax cond"
 		"	(syntax-rules (else)"
@@ -210,22 +226,22 @@ TEST_F(MachTest, DefineSyntaxCond) {
 		")"
 		"(foo 2)"
 	);
-	ASSERT_EQ(20, ok->Fixed());
+	ASSERT_EQ(20, Object::Fixed(ok));
 
 	ok = mach_->Feed("(foo 3)");
-	ASSERT_EQ(30, ok->Fixed());
+	ASSERT_EQ(30, Object::Fixed(ok));
 
 	ok = mach_->Feed("(foo 1)");
-	ASSERT_EQ(10, ok->Fixed());
+	ASSERT_EQ(10, Object::Fixed(ok));
 
 	ok = mach_->Feed("(foo 20)");
 	ASSERT_EQ("Suck my balls!", ok->String()->str());
 
 	ok = mach_->Feed("(foo 1)");
-	ASSERT_EQ(10, ok->Fixed());
+	ASSERT_EQ(10, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, DefineSyntaxLet) {
+TEST_P(MachTest, DefineSyntaxLet) {
 	Object *ok = mach_->Feed(
 		"(define-syntax let"
 		"	(syntax-rules ()"
@@ -235,23 +251,350 @@ TEST_F(MachTest, DefineSyntaxLet) {
 		"(let ((a 1) (b 2))"
 		"	(+ a b))"
 	);
-	ASSERT_EQ(3, ok->Fixed());
+	ASSERT_EQ(3, Object::Fixed(ok));
 	ok = mach_->Feed(
 		"(let ((x 1) (y 2))"
 		"	(let ((x 2) (y 3))"
 		"		(* x y)))"
 	);
-	ASSERT_EQ(6, ok->Fixed());
+	ASSERT_EQ(6, Object::Fixed(ok));
 	ok = mach_->Feed(
 		"(define x 100)"
 		"(let ((a 1) (b 2))"
 		"	(let ((c 3) (d 4))"
 		"		(+ (+ (+ a b) (+ c d)) x)))"
 	);
-	ASSERT_EQ(110, ok->Fixed());
+	ASSERT_EQ(110, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, DefineSyntaxSource) {
+	Object *ok = mach_->Feed(
+		"(define-syntax my-when"
+		"	(syntax-rules ()"
+		"		((_ test expr ...)"
+		"			(if test (begin expr ...)))))"
+		"(define code '(my-when #t 1))"
+		"(eval code)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(1, Object::Fixed(ok));
+	// The quoted data be not touched by expanding.
+	ok = mach_->Feed("code");
+	ASSERT_EQ("(my-when #t 1)", Object::ToString(ok, mach_->Obm()));
+
+	// The expansions in lambda be kept by the closure.
+	ok = mach_->Feed(
+		"(define (foo x) (my-when x (list x x)))"
+		"(define (churn n)"
+		"	(if (= n 0)"
+		"		#t"
+		"		(begin (list n n n) (churn (- n 1)))))"
+		"(churn 100000)"
+		"(foo 7)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ("(7 7)", Object::ToString(ok, mach_->Obm()));
+}
+
+TEST_P(MachTest, TailCall) {
+	Object *ok = mach_->Feed(
+		"(define (loop i acc)"
+		"	(if (= i 0)"
+		"		acc"
+		"		(loop (- i 1) (+ acc 1))))"
+		"(loop 100000 0)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(100000, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, Closure) {
+	Object *ok = mach_->Feed(
+		"(define (make-counter n)"
+		"	(define (inc) (set! n (+ n 1)) n)"
+		"	inc)"
+		"(define c (make-counter 10))"
+		"(c)"
+		"(c)"
+	);
+	ASSERT_EQ(12, Object::Fixed(ok));
+
+	ok = mach_->Feed(
+		"(define (f a)"
+		"	(if a (define x 1) (define y 2))"
+		"	(lambda (b) (if a (+ x b) (+ y b))))"
+		"(+ ((f #t) 10) ((f #f) 100))"
+	);
+	ASSERT_EQ(113, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, AndOr) {
+	Object *ok = mach_->Feed("(and 1 #f 3)");
+	ASSERT_FALSE(Object::Boolean(ok));
+	ok = mach_->Feed("(and 1 2 3)");
+	ASSERT_EQ(3, Object::Fixed(ok));
+	ok = mach_->Feed("(or #f #t 3)");
+	ASSERT_TRUE(Object::Boolean(ok));
+	ok = mach_->Feed("(or #f #f)");
+	ASSERT_FALSE(Object::Boolean(ok));
+}
+
+TEST_P(MachTest, Apply) {
+	Object *ok = mach_->Feed("(apply + 1 2 '(3 4))");
+	ASSERT_EQ(10, Object::Fixed(ok));
+	ok = mach_->Feed(
+		"(define (add a b) (+ a b))"
+		"(apply add '(1 2))"
+	);
+	ASSERT_EQ(3, Object::Fixed(ok));
+	ok = mach_->Feed("(apply list 1 '(2 3))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(3, Object::Fixed(car(cdr(cdr(ok)))));
+
+	ASSERT_EQ(nullptr, mach_->Feed("(apply +)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(apply + 1 2)"));
+}
+
+TEST_P(MachTest, PrimitiveArguments) {
+	ASSERT_EQ(nullptr, mach_->Feed("(car)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(cons 1)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(cons 1 2 3)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(ajimu.gc.state 1)"));
+
+	Object *ok = mach_->Feed("(define x (list 1 2))");
+	ASSERT_NE(nullptr, ok);
+	size_t allocated = mach_->Obm()->Allocated();
+	mach_->Obm()->Cons(ok, ok);
+	size_t pair_size = mach_->Obm()->Allocated() - allocated;
+
+	// No list of arguments be allocated for calling primitives, so only
+	// the result of list be allocated.
+	allocated = mach_->Obm()->Allocated();
+	ok = mach_->Feed("(+ (car x) (car (cdr x)) 3)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(6, Object::Fixed(ok));
+	size_t add_allocated = mach_->Obm()->Allocated() - allocated;
+
+	allocated = mach_->Obm()->Allocated();
+	ok = mach_->Feed("(list (car x) (car (cdr x)) 3)");
+	ASSERT_NE(nullptr, ok);
+	size_t list_allocated = mach_->Obm()->Allocated() - allocated;
+	ASSERT_EQ(3 * pair_size, list_allocated - add_allocated);
+}
+
+TEST_P(MachTest, ClosureArguments) {
+	Object *ok = mach_->Feed("(define (f a b) (car a))");
+	ASSERT_NE(nullptr, ok);
+
+	size_t allocated = mach_->Obm()->Allocated();
+	ok = mach_->Feed("(car '(1 2))");
+	ASSERT_NE(nullptr, ok);
+	size_t car_allocated = mach_->Obm()->Allocated() - allocated;
+
+	// Only the frame be allocated for calling closure.
+	allocated = mach_->Obm()->Allocated();
+	ok = mach_->Feed("(f '(1 2))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(1, Object::Fixed(ok));
+	ASSERT_EQ(car_allocated + Environment::SizeOf(2),
+			mach_->Obm()->Allocated() - allocated);
+
+	// The missing one be '().
+	ok = mach_->Feed("(define (g a b) b) (g 1)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(ok, mach_->Feed("'()"));
+	ok = mach_->Feed("(apply f '((3) 4))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(3, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, CallDepth) {
+	Object *ok = mach_->Feed(
+		"(define (count n)"
+		"	(if (= n 0) 0 (+ 1 (count (- n 1)))))"
+	);
+	ASSERT_NE(nullptr, ok);
+	if (GetParam() == Mach::kBytecode) {
+		// Frames be in heap, not the native stack.
+		ok = mach_->Feed("(count 100000)");
+		ASSERT_NE(nullptr, ok);
+		ASSERT_EQ(100000, Object::Fixed(ok));
+	}
+
+	// Too deep, error but not crash.
+	mach_->SetMaxCallDepth(1000);
+	ASSERT_EQ(nullptr, mach_->Feed("(count 100000)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(count 1000)"));
+	ok = mach_->Feed("(count 100)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(100, Object::Fixed(ok));
+
+	// Native stack is limited also.
+	mach_->SetMaxCallDepth(DEFAULT_MAX_CALL_DEPTH);
+	if (GetParam() == Mach::kTree) {
+		ASSERT_EQ(nullptr, mach_->Feed("(count 1000000)"));
+	}
+}
+
+TEST_P(MachTest, GlobalCell) {
+	Object *ok = mach_->Feed(
+		"(define (add a) (lambda (b) (lambda (c) (+ a b c base))))"
+		"(define base 100)"
+		"(define f ((add 1) 2))"
+		"(f 3)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(106, Object::Fixed(ok));
+
+	// The cached cells be updated in place.
+	ok = mach_->Feed("(define base 200) (f 3)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(206, Object::Fixed(ok));
+	ok = mach_->Feed("(set! base 300) (f 3)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(306, Object::Fixed(ok));
+	ok = mach_->Feed("(define (+ a b c d) (* a b c d)) (f 3)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(1800, Object::Fixed(ok));
+
+	// Shadowed by the parameters and the internal definitions.
+	ok = mach_->Feed(
+		"(define (g base)"
+		"	(define (* a b) (- a b))"
+		"	(* base 1))"
+		"(g 5)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(4, Object::Fixed(ok));
+
+	// Not be cached before it's bound.
+	ok = mach_->Feed("(define (h) later)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(nullptr, mach_->Feed("(h)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(set! later 1)"));
+	ok = mach_->Feed("(define later 7) (h)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(7, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, CallWithContinuation) {
+	Object *ok = mach_->Feed(
+		"(define (search l x)"
+		"	(call/cc (lambda (return)"
+		"		(define (loop l)"
+		"			(if (null? l)"
+		"				#f"
+		"				(if (= (car l) x) (return l) (loop (cdr l)))))"
+		"		(loop l))))"
+		"(search (list 1 2 3 4) 3)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(3, Object::Fixed(car(ok)));
+
+	ok = mach_->Feed("(+ 1 (call/ec (lambda (k) (+ 10 (k 5)))))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(6, Object::Fixed(ok));
+
+	ok = mach_->Feed("(call-with-escape-continuation (lambda (k) 7))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(7, Object::Fixed(ok));
+
+	// Escape through the nested eval.
+	ok = mach_->Feed("(call/cc (lambda (k) (+ 1 (eval '(k 8)))))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(8, Object::Fixed(ok));
+
+	ok = mach_->Feed("(procedure? (call/ec (lambda (k) k)))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_TRUE(Object::Boolean(ok));
+
+	// The escape-only one is dead after returning.
+	ok = mach_->Feed(
+		"(define saved #f)"
+		"(call/ec (lambda (k) (set! saved k) 1))"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(nullptr, mach_->Feed("(saved 2)"));
+	ASSERT_EQ(nullptr, mach_->Feed("(call/cc 1 2)"));
+	ok = mach_->Feed("(call/ec (lambda (k) (k 3)))");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(3, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, DynamicWind) {
+	Object *ok = mach_->Feed(
+		"(define trace '())"
+		"(define (log x) (set! trace (cons x trace)))"
+		"(call/cc (lambda (k)"
+		"	(dynamic-wind"
+		"		(lambda () (log 1))"
+		"		(lambda () (k 4) (log 2))"
+		"		(lambda () (log 3)))))"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(4, Object::Fixed(ok));
+	ok = mach_->Feed("trace");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ("(3 1)", Object::ToString(ok, mach_->Obm()));
+
+	ok = mach_->Feed(
+		"(dynamic-wind"
+		"	(lambda () (log 5))"
+		"	(lambda () 6)"
+		"	(lambda () (log 7)))"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(6, Object::Fixed(ok));
+	ok = mach_->Feed("trace");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ("(7 5 3 1)", Object::ToString(ok, mach_->Obm()));
+
+	// Reset by error.
+	ASSERT_EQ(nullptr, mach_->Feed(
+		"(dynamic-wind (lambda () 1) (lambda () (car 1)) (lambda () 2))"));
+	ok = mach_->Feed("(ajimu.winders)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_TRUE(mach_->Obm()->Null(ok));
+}
+
+TEST_P(MachTest, Generator) {
+	if (GetParam() == Mach::kTree)
+		return; // Only the escape-only one in tree engine.
+	Object *ok = mach_->Feed(
+		"(define (for-each f l)"
+		"	(if (null? l) #t (begin (f (car l)) (for-each f (cdr l)))))"
+		"(define (make-generator l)"
+		"	(define return #f)"
+		"	(define (next v)"
+		"		(for-each (lambda (x)"
+		"			(call/cc (lambda (k) (set! next k) (return x)))) l)"
+		"		(return 'eof))"
+		"	(lambda () (call/cc (lambda (r) (set! return r) (next #f)))))"
+		"(define g (make-generator (list 1 2 3)))"
+	);
+	ASSERT_NE(nullptr, ok);
+	// Re-entered in the later runs.
+	for (int i = 1; i <= 3; ++i) {
+		ok = mach_->Feed("(g)");
+		ASSERT_NE(nullptr, ok);
+		ASSERT_EQ(i, Object::Fixed(ok));
+	}
+	ok = mach_->Feed("(g)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_TRUE(Object::IsSymbol(ok));
+
+	// Re-entered in the same run.
+	ok = mach_->Feed(
+		"(define g (make-generator (list 1 2 3 4)))"
+		"(define (sum s)"
+		"	((lambda (x) (if (eq? x 'eof) s (sum (+ s x)))) (g)))"
+		"(sum 0)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(10, Object::Fixed(ok));
 }
 
-TEST_F(MachTest, GC) {
+TEST_P(MachTest, GC) {
 	Object *ok = mach_->Feed(
 		"(define (for-each f l)"
 		"	(if (null? l)"
@@ -276,6 +619,108 @@ TEST_F(MachTest, GC) {
 	}
 }
 
+TEST_P(MachTest, GcStats) {
+	Object *ok = mach_->Feed("(ajimu.gc.min-heap 0)");
+	ASSERT_NE(nullptr, ok);
+	ok = mach_->Feed(
+		"(define (loop n l)"
+		"	(if (= n 0)"
+		"		#t"
+		"		(loop (- n 1) (cons n l))))"
+		"(loop 10000 '())"
+		"(ajimu.gc.stats)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_TRUE(Object::IsPair(ok));
+	ASSERT_STREQ("major-cycles", car(car(ok))->Symbol());
+	ASSERT_LT(0, Object::Fixed(cdr(car(ok))));
+
+	Object *phases = nullptr;
+	for (Object *i = ok; Object::IsHeapObject(i); i = cdr(i)) {
+		if (strcmp(car(car(i))->Symbol(), "phases") == 0)
+			phases = cdr(car(i));
+	}
+	ASSERT_NE(nullptr, phases);
+	ASSERT_STREQ("pause", car(car(phases))->Symbol());
+}
+
+TEST_P(MachTest, GcPacing) {
+	Object *ok = mach_->Feed("(ajimu.gc.growth 1.5)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(1.5, ok->Real());
+	ASSERT_EQ(nullptr, mach_->Feed("(ajimu.gc.growth 0.5)"));
+
+	ok = mach_->Feed("(ajimu.gc.max-heap 65536)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(65536, Object::Fixed(ok));
+	ok = mach_->Feed("(ajimu.gc.min-heap 0)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(0, Object::Fixed(ok));
+	ASSERT_EQ(nullptr, mach_->Feed("(ajimu.gc.min-heap -1)"));
+
+	// Collect continuously in a small heap.
+	ok = mach_->Feed(
+		"(define (loop n l)"
+		"	(if (= n 0)"
+		"		(ajimu.gc.threshold)"
+		"		(loop (- n 1) (cons n l))))"
+		"(loop 10000 '())"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_GE(65536, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, GcSeal) {
+	Object *ok = mach_->Feed(
+		"(define sealed (list 1 2 3))"
+		"(define (loop n l)"
+		"	(if (= n 0)"
+		"		l"
+		"		(loop (- n 1) (cons n l))))"
+		"(define (count l n)"
+		"	(if (null? l)"
+		"		n"
+		"		(count (cdr l) (+ n 1))))"
+		"(ajimu.gc.seal)"
+		"(ajimu.gc.min-heap 0)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_TRUE(mach_->Obm()->GlobalEnvironment()->IsPermanent());
+
+	// The sealed ones be changed, and collected continuously.
+	ok = mach_->Feed(
+		"(set-car! sealed (loop 1000 '()))"
+		"(set! sealed (cons (loop 1000 '()) sealed))"
+		"(loop 10000 '())"
+		"(count (car (cdr sealed)) 0)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(1000, Object::Fixed(ok));
+	ok = mach_->Feed("(count (car sealed) 0)");
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(1000, Object::Fixed(ok));
+}
+
+TEST_P(MachTest, GcConservative) {
+	mach_->Obm()->SetGcConservative(true);
+	mach_->Obm()->SetGcNursery(1024);
+	Object *ok = mach_->Feed(
+		"(ajimu.gc.min-heap 0)"
+		"(define (loop n l)"
+		"	(if (= n 0)"
+		"		l"
+		"		(loop (- n 1) (cons (list n (+ n 1) (* n 2)) l))))"
+		"(define (sum l n)"
+		"	(if (null? l)"
+		"		n"
+		"		(sum (cdr l) (+ n (car (car l)) (car (cdr (car l)))))))"
+		"(sum (loop 1000 '()) 0)"
+	);
+	ASSERT_NE(nullptr, ok);
+	ASSERT_EQ(1002000, Object::Fixed(ok));
+	ASSERT_LT(0U, mach_->Obm()->GcStats().stack_roots);
+}
+
 } // namespace vm
 } // namespace ajimu
 
@@ -18,7 +18,7 @@ Object *MacroAnalyzer::Extend(Object *s, Object *o) {
 	Object *rules = caddr(s);
 	Object *ids = cadr(rules);
 	while (ids != Null) {
-		if (!car(ids)->IsSymbol()) // Error
+		if (!Object::IsSymbol(car(ids))) // Error
 			return nullptr;
 		identifier_.insert(car(ids)->Symbol());
 		ids = cdr(ids);
@@ -39,8 +39,8 @@ Object *MacroAnalyzer::Extend(Object *s, Object *o) {
 }
 
 Object *MacroAnalyzer::DoExtend(Object *t) {
-	if (!t->IsPair()) { // If not list
-		if (!t->IsSymbol())
+	if (!Object::IsPair(t)) { // If not list
+		if (!Object::IsSymbol(t))
 			return t;
 		Object *o = Binded(t->Symbol());
 		return !o ? t : o;
@@ -51,11 +51,11 @@ Object *MacroAnalyzer::DoExtend(Object *t) {
 	std::vector<Object*> ol;
 	Object *prev = nullptr;
 	for (auto elem : tl) {
-		switch (elem->OwnedType()) {
+		switch (Object::TypeOf(elem)) {
 		case values::SYMBOL:
 			if (elem == Kof(EllipsisSymbol)) {
 				DCHECK(prev);
-				DCHECK(prev->IsSymbol());
+				DCHECK(Object::IsSymbol(prev));
 
 				auto binds = Ellipsis(prev->Symbol());
 				for (auto binded : binds)
@@ -104,19 +104,19 @@ bool MacroAnalyzer::Match(Object *pattern, Object *o) {
 				j = end - 1;
 				ok = true;
 			}
-		} else if (pl[i]->IsSymbol()) {
+		} else if (Object::IsSymbol(pl[i])) {
 			if (Identifier(pl[i]->Symbol())) {
-				if (ol[j]->IsSymbol()) {
+				if (Object::IsSymbol(ol[j])) {
 					ok = strcmp(pl[i]->Symbol(), ol[j]->Symbol()) == 0;
 				}
 			} else {
 				binded_[pl[i]->Symbol()] = ol[j];
 				ok = true;
 			}
-		} else if (pl[i]->IsPair()) {
-			if (ol[j]->IsPair())
+		} else if (Object::IsPair(pl[i])) {
+			if (Object::IsPair(ol[j]))
 				ok = Match(pl[i], ol[j]);
-		} else if (pl[i]->OwnedType() == ol[j]->OwnedType()) {
+		} else if (Object::TypeOf(pl[i]) == Object::TypeOf(ol[j])) {
 			ok = true;
 		}
 		if (!ok)
@@ -128,11 +128,11 @@ bool MacroAnalyzer::Match(Object *pattern, Object *o) {
 }
 
 bool MacroAnalyzer::BindEllipsis(Object *p, Object *o) {
-	if (p->IsSymbol()) {
+	if (Object::IsSymbol(p)) {
 		MutableEllipsis(p->Symbol())->push_back(o);
 		return true;
 	}
-	if (!p->IsPair() || !o->IsPair())
+	if (!Object::IsPair(p) || !Object::IsPair(o))
 		return false;
 	std::vector<Object*> pl(std::move(List2Vector(p))),
 		                 ol(std::move(List2Vector(o)));
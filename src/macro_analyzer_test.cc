@@ -44,9 +44,9 @@ protected:
 		o = factory_->Extend(syntax, o);
 		ASSERT_NE(nullptr, o);
 		if (expected)
-			ASSERT_EQ(expected, o->ToString(obm_));
+			ASSERT_EQ(expected, Object::ToString(o, obm_));
 		else
-			printf("Extended: %s\n", o->ToString(obm_).c_str());
+			printf("Extended: %s\n", Object::ToString(o, obm_).c_str());
 	}
 
 	MacroAnalyzer *factory_;
@@ -73,7 +73,8 @@ TEST_F(MacroAnalyzerTest, Sanity) {
 
 	o = factory_->Extend(syntax, o);
 	ASSERT_NE(nullptr, o);
-	ASSERT_EQ("((lambda (x y) (+ x y) (- x y)) 1 2)", o->ToString(obm_));
+	ASSERT_EQ("((lambda (x y) (+ x y) (- x y)) 1 2)",
+			Object::ToString(o, obm_));
 
 	input =
 	"(define-syntax and"
@@ -95,7 +96,7 @@ TEST_F(MacroAnalyzerTest, Sanity) {
 
 	o = factory_->Extend(syntax, o);
 	ASSERT_NE(nullptr, o);
-	ASSERT_EQ("(if 1 (and 2 3 4 5) #f)", o->ToString(obm_));
+	ASSERT_EQ("(if 1 (and 2 3 4 5) #f)", Object::ToString(o, obm_));
 }
 
 TEST_F(MacroAnalyzerTest, AndSyntax) {
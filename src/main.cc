@@ -1,15 +1,116 @@
 #include "eval_application.h"
 #include "repl_application.h"
+#include "mach.h"
+#include "object_management.h"
 #include "glog/logging.h"
 #include "gflags/gflags.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
 
 DEFINE_string(input, "", "Input script file, if not set, to REPL mode.");
 DEFINE_string(color, "auto", "REPL printing color. yes|no|auto");
+DEFINE_string(engine, "bytecode", "Execution engine. bytecode|tree");
+static bool ValidateEngine(const char *flag, const std::string &value) {
+	if (value == "bytecode" || value == "tree")
+		return true;
+	fprintf(stderr, "--%s must be bytecode or tree, not \"%s\".\n", flag,
+			value.c_str());
+	return false;
+}
+static const bool kEngineValidator =
+	google::RegisterFlagValidator(&FLAGS_engine, &ValidateEngine);
+DEFINE_int64(max_call_depth, DEFAULT_MAX_CALL_DEPTH,
+		"Calls deeper than it raise error.");
+DEFINE_int32(gc_quantum, DEFAULT_GC_QUANTUM,
+		"Objects be scanned or swept in one gc step.");
+DEFINE_int32(gc_nursery, DEFAULT_GC_NURSERY,
+		"Bytes be allocated in young generation between two minor gc.");
+DEFINE_double(gc_growth, DEFAULT_GC_GROWTH,
+		"Next major gc starts when heap grows to live bytes * growth.");
+DEFINE_int64(gc_min_heap, DEFAULT_GC_MIN_HEAP,
+		"Bytes of heap, no major gc before reaching it.");
+DEFINE_int64(gc_max_heap, DEFAULT_GC_MAX_HEAP,
+		"Bytes of heap, major gc starts at it whatever the growth is.");
+DEFINE_int32(gc_threads, DEFAULT_GC_THREADS,
+		"Threads for marking, more than 1 marks in one step by threads.");
+DEFINE_bool(gc_concurrent_sweep, false,
+		"Sweep objects and environments by a background thread.");
+DEFINE_bool(gc_conservative, false,
+		"Scan the native stack for roots, temporaries be not pushed.");
+DEFINE_bool(gc_seal, false,
+		"Seal the heap after startup and each load, be never marked again.");
+
+// Out of range values be rejected, not fall back to the defaults silently.
+template<class T>
+static bool ValidatePositive(const char *flag, T value) {
+	if (value > 0)
+		return true;
+	fprintf(stderr, "--%s must be greater than 0.\n", flag);
+	return false;
+}
+static bool ValidateNonNegative(const char *flag, int64_t value) {
+	if (value >= 0)
+		return true;
+	fprintf(stderr, "--%s can not be negative.\n", flag);
+	return false;
+}
+static bool ValidateGrowth(const char *flag, double value) {
+	if (value >= 1.0)
+		return true;
+	fprintf(stderr, "--%s must be 1.0 or greater.\n", flag);
+	return false;
+}
+static const bool kRangeValidators[] = {
+	google::RegisterFlagValidator(&FLAGS_max_call_depth,
+			&ValidatePositive<int64_t>),
+	google::RegisterFlagValidator(&FLAGS_gc_quantum,
+			&ValidatePositive<int32_t>),
+	google::RegisterFlagValidator(&FLAGS_gc_nursery,
+			&ValidatePositive<int32_t>),
+	google::RegisterFlagValidator(&FLAGS_gc_growth, &ValidateGrowth),
+	google::RegisterFlagValidator(&FLAGS_gc_min_heap, &ValidateNonNegative),
+	google::RegisterFlagValidator(&FLAGS_gc_max_heap,
+			&ValidatePositive<int64_t>),
+	google::RegisterFlagValidator(&FLAGS_gc_threads,
+			&ValidatePositive<int32_t>),
+};
 
 static const char *kUsage = \
 "\n"
 "\tajimu --input=path/to/file\n"
-"\tajimu --color=(yes|no|auto)";
+"\tajimu --color=(yes|no|auto)\n"
+"\tajimu --engine=(bytecode|tree)\n"
+"\tajimu --max_call_depth=n\n"
+"\tajimu --gc_quantum=n\n"
+"\tajimu --gc_nursery=bytes\n"
+"\tajimu --gc_growth=factor --gc_min_heap=bytes --gc_max_heap=bytes\n"
+"\tajimu --gc_threads=n\n"
+"\tajimu --gc_concurrent_sweep=(true|false)\n"
+"\tajimu --gc_conservative=(true|false)\n"
+"\tajimu --gc_seal=(true|false)";
+
+// Apply the engine and gc flags, before the mach be initialized.
+static void SetupMach(ajimu::vm::Mach *mach) {
+	using ajimu::vm::Mach;
+	using ajimu::values::ObjectManagement;
+
+	mach->SetExecutionEngine(FLAGS_engine == "tree" ?
+			Mach::kTree : Mach::kBytecode);
+	// The flags have been validated in parsing.
+	mach->SetMaxCallDepth(static_cast<size_t>(FLAGS_max_call_depth));
+
+	ObjectManagement *obm = mach->Obm();
+	obm->SetGcQuantum(static_cast<size_t>(FLAGS_gc_quantum));
+	obm->SetGcNursery(static_cast<size_t>(FLAGS_gc_nursery));
+	obm->SetGcGrowth(FLAGS_gc_growth);
+	obm->SetGcMinHeap(static_cast<size_t>(FLAGS_gc_min_heap));
+	obm->SetGcMaxHeap(static_cast<size_t>(FLAGS_gc_max_heap));
+	obm->SetGcThreads(FLAGS_gc_threads);
+	obm->SetGcConcurrentSweep(FLAGS_gc_concurrent_sweep);
+	obm->SetGcConservative(FLAGS_gc_conservative);
+	mach->SetAutoSeal(FLAGS_gc_seal);
+}
 
 int main(int argc, char *argv[]) {
 	google::SetUsageMessage(kUsage);
@@ -27,12 +128,14 @@ int main(int argc, char *argv[]) {
 			app.SetColorMode(ReplApplication::NO);
 		else
 			app.SetColorMode(ReplApplication::AUTO);
+		SetupMach(app.Mach());
 		if (app.Init())
 			rv = app.Run();
 	} else {
 		using ajimu::app::EvalApplication;
 
 		EvalApplication app(FLAGS_input.c_str());
+		SetupMach(app.Mach());
 		if (app.Init())
 			rv = app.Run();
 	}
@@ -0,0 +1,105 @@
+#ifndef AJIMU_VALUES_MARK_STACK_H
+#define AJIMU_VALUES_MARK_STACK_H
+
+#include "glog/logging.h"
+#include <stddef.h>
+#include <vector>
+
+namespace ajimu {
+namespace values {
+
+//
+// Default limit of mark stack: 4M entries
+//
+#define DEFAULT_MARK_STACK_LIMIT (4 * 1024 * 1024)
+
+//
+// Explicit stack for gc marking. It grows by segments, so pushing never
+// moves the old entries. When the limit is reached the pushing fails and
+// the stack is marked as overflowed. The collector must find the gray
+// objects that were not pushed by scanning the heap.
+//
+template<class T>
+class MarkStack {
+public:
+	enum {
+		kSegmentShift = 10,
+		kSegmentSize  = 1 << kSegmentShift, // 1024 entries
+		kSegmentMask  = kSegmentSize - 1,
+	};
+
+	MarkStack()
+		: size_(0)
+		, limit_(DEFAULT_MARK_STACK_LIMIT)
+		, overflowed_(false) {
+	}
+
+	~MarkStack() {
+		for (auto segment : segments_)
+			delete[] segment;
+	}
+
+	bool Empty() const {
+		return size_ == 0;
+	}
+
+	size_t Size() const {
+		return size_;
+	}
+
+	size_t Limit() const {
+		return limit_;
+	}
+
+	void SetLimit(size_t limit) {
+		DCHECK_GT(limit, 0U);
+		limit_ = limit;
+	}
+
+	bool Overflowed() const {
+		return overflowed_;
+	}
+
+	void ClearOverflowed() {
+		overflowed_ = false;
+	}
+
+	// Returns false if the stack is full.
+	bool Push(T x) {
+		if (size_ >= limit_) {
+			overflowed_ = true;
+			return false;
+		}
+		if ((size_ >> kSegmentShift) == segments_.size())
+			segments_.push_back(new T[kSegmentSize]);
+		segments_[size_ >> kSegmentShift][size_ & kSegmentMask] = x;
+		++size_;
+		return true;
+	}
+
+	T Pop() {
+		DCHECK_GT(size_, 0U);
+		--size_;
+		T x = segments_[size_ >> kSegmentShift][size_ & kSegmentMask];
+		// Keep one spare segment, avoid thrashing at the boundary.
+		if (segments_.size() > (size_ >> kSegmentShift) + 2) {
+			delete[] segments_.back();
+			segments_.pop_back();
+		}
+		return x;
+	}
+
+private:
+	MarkStack(const MarkStack &) = delete;
+	void operator = (const MarkStack &) = delete;
+
+	std::vector<T*> segments_;
+	size_t size_;
+	size_t limit_;
+	bool overflowed_;
+}; // class MarkStack
+
+} // namespace values
+} // namespace ajimu
+
+#endif //AJIMU_VALUES_MARK_STACK_H
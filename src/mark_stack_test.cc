@@ -0,0 +1,37 @@
+#include "mark_stack.h"
+#include "gmock/gmock.h"
+
+namespace ajimu {
+namespace values {
+
+TEST(MarkStackTest, Sanity) {
+	MarkStack<int> stack;
+	ASSERT_TRUE(stack.Empty());
+
+	const int n = MarkStack<int>::kSegmentSize * 3 + 7;
+	for (int i = 0; i < n; ++i)
+		ASSERT_TRUE(stack.Push(i));
+	ASSERT_EQ(static_cast<size_t>(n), stack.Size());
+	for (int i = n - 1; i >= 0; --i)
+		ASSERT_EQ(i, stack.Pop());
+	ASSERT_TRUE(stack.Empty());
+	ASSERT_FALSE(stack.Overflowed());
+}
+
+TEST(MarkStackTest, Overflow) {
+	MarkStack<int> stack;
+	stack.SetLimit(4);
+	for (int i = 0; i < 4; ++i)
+		ASSERT_TRUE(stack.Push(i));
+	ASSERT_FALSE(stack.Push(4));
+	ASSERT_TRUE(stack.Overflowed());
+	ASSERT_EQ(4U, stack.Size());
+
+	ASSERT_EQ(3, stack.Pop());
+	ASSERT_TRUE(stack.Push(3));
+	stack.ClearOverflowed();
+	ASSERT_FALSE(stack.Overflowed());
+}
+
+} // namespace values
+} // namespace ajimu
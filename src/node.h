@@ -0,0 +1,315 @@
+#ifndef AJIMU_VM_NODE_H
+#define AJIMU_VM_NODE_H
+
+#include "code.h"
+#include "glog/logging.h"
+#include <memory>
+#include <atomic>
+#include <vector>
+
+namespace ajimu {
+namespace values {
+class Object;
+} // namespace values
+namespace vm {
+
+//
+// Pre-analyzed expression node. The Analyzer classify s-expression once,
+// and the Mach execute the node tree without syntax dispatching again.
+//
+class Node {
+public:
+	enum Kind {
+		kConstant,
+		kVariable,
+		kAssignment,
+		kDefinition,
+		kSyntaxDefinition,
+		kIf,
+		kLambda,
+		kSequence,
+		kAnd,
+		kOr,
+		kApplication,
+	};
+
+	virtual ~Node() {}
+
+	Kind NodeKind() const {
+		return kind_;
+	}
+
+	void Ref() {
+		++ref_count_;
+	}
+
+	// Closures may be destroyed by the background sweeper.
+	void Unref() {
+		DCHECK_GT(ref_count_.load(), 0);
+		if (--ref_count_ == 0)
+			delete this;
+	}
+
+protected:
+	explicit Node(Kind kind)
+		: kind_(kind)
+		, ref_count_(1) {
+	}
+
+private:
+	Node(const Node &) = delete;
+	void operator = (const Node &) = delete;
+
+	Kind kind_;
+	std::atomic<int> ref_count_;
+}; // class Node
+
+// Quoted or self-evaluating expression.
+class Constant : public Node {
+public:
+	explicit Constant(values::Object *value)
+		: Node(kConstant)
+		, value_(value) {
+	}
+
+	values::Object *Value() const { return value_; }
+
+private:
+	values::Object *value_;
+}; // class Constant
+
+class Variable : public Node {
+public:
+	explicit Variable(values::Object *symbol)
+		: Node(kVariable)
+		, symbol_(symbol)
+		, global_(false)
+		, cell_(-1) {
+	}
+
+	values::Object *Symbol() const { return symbol_; }
+
+	// Not bound by any lambda, it's in global environment.
+	bool Global() const { return global_; }
+
+	void SetGlobal() { global_ = true; }
+
+	// Inline cache of the global one, see Code::CellAt().
+	int *Cell() { return &cell_; }
+
+private:
+	values::Object *symbol_;
+	bool global_;
+	int cell_;
+}; // class Variable
+
+// set! and define
+class Assignment : public Node {
+public:
+	Assignment(Kind kind, values::Object *symbol, Node *value)
+		: Node(kind)
+		, symbol_(symbol)
+		, value_(value) {
+		DCHECK(kind == kAssignment || kind == kDefinition);
+	}
+
+	virtual ~Assignment() {
+		value_->Unref();
+	}
+
+	values::Object *Symbol() const { return symbol_; }
+
+	Node *Value() const { return value_; }
+
+private:
+	values::Object *symbol_;
+	Node *value_;
+}; // class Assignment
+
+class SyntaxDefinition : public Node {
+public:
+	SyntaxDefinition(values::Object *name, values::Object *syntax)
+		: Node(kSyntaxDefinition)
+		, name_(name)
+		, syntax_(syntax) {
+	}
+
+	values::Object *Name() const { return name_; }
+
+	values::Object *Syntax() const { return syntax_; }
+
+private:
+	values::Object *name_;
+	values::Object *syntax_;
+}; // class SyntaxDefinition
+
+class If : public Node {
+public:
+	If(Node *predicate, Node *consequent, Node *alternative)
+		: Node(kIf)
+		, predicate_(predicate)
+		, consequent_(consequent)
+		, alternative_(alternative) {
+	}
+
+	virtual ~If() {
+		predicate_->Unref();
+		consequent_->Unref();
+		alternative_->Unref();
+	}
+
+	Node *Predicate() const { return predicate_; }
+
+	Node *Consequent() const { return consequent_; }
+
+	Node *Alternative() const { return alternative_; }
+
+private:
+	Node *predicate_;
+	Node *consequent_;
+	Node *alternative_;
+}; // class If
+
+// begin, and, or and body of lambda
+class Sequence : public Node {
+public:
+	explicit Sequence(Kind kind)
+		: Node(kind) {
+		DCHECK(kind == kSequence || kind == kAnd || kind == kOr);
+	}
+
+	virtual ~Sequence() {
+		for (auto action : actions_)
+			action->Unref();
+	}
+
+	void Append(Node *action) {
+		actions_.push_back(DCHECK_NOTNULL(action));
+	}
+
+	const std::vector<Node*> &Actions() const { return actions_; }
+
+private:
+	std::vector<Node*> actions_;
+}; // class Sequence
+
+//
+// The lambda node be shared by all closures made from it, closure keep a
+// reference to it, so the body only be analyzed and compiled once.
+//
+class Lambda : public Node {
+public:
+	Lambda(values::Object *params, std::vector<values::Object*> &&names,
+			values::Object *source, values::Object *expanded, Node *body)
+		: Node(kLambda)
+		, params_(params)
+		, names_(std::move(names))
+		, source_(source)
+		, expanded_(expanded)
+		, body_(body) {
+	}
+
+	virtual ~Lambda() {
+		body_->Unref();
+	}
+
+	values::Object *Params() const { return params_; }
+
+	// Symbols of parameters in order, the slots of frame in tree engine.
+	const std::vector<values::Object*> &Names() const { return names_; }
+
+	values::Object *Source() const { return source_; }
+
+	// List of the macro expansions in body, the body node refer to them.
+	values::Object *Expanded() const { return expanded_; }
+
+	Node *Body() const { return body_; }
+
+	// Compiled body, for bytecode engine.
+	class Code *Code() const { return code_.get(); }
+
+	void SetCode(class Code *code) {
+		DCHECK(!code_);
+		code_.reset(code);
+	}
+
+private:
+	values::Object *params_;
+	std::vector<values::Object*> names_;
+	values::Object *source_;
+	values::Object *expanded_;
+	Node *body_;
+	std::unique_ptr<class Code> code_;
+}; // class Lambda
+
+class Application : public Node {
+public:
+	explicit Application(Node *op)
+		: Node(kApplication)
+		, operator_(op) {
+	}
+
+	virtual ~Application() {
+		operator_->Unref();
+		for (auto operand : operands_)
+			operand->Unref();
+	}
+
+	void Append(Node *operand) {
+		operands_.push_back(DCHECK_NOTNULL(operand));
+	}
+
+	Node *Operator() const { return operator_; }
+
+	const std::vector<Node*> &Operands() const { return operands_; }
+
+private:
+	Node *operator_;
+	std::vector<Node*> operands_;
+}; // class Application
+
+//
+// Visit the names defined in the body of lambda, the definitions in inner
+// lambdas are not its. They and the parameters are bound by the lambda.
+//
+template<class Callback>
+inline void ForEachDefinition(Node *node, Callback callback) {
+	switch (node->NodeKind()) {
+	case Node::kDefinition:
+		callback(static_cast<Assignment*>(node)->Symbol());
+		ForEachDefinition(static_cast<Assignment*>(node)->Value(), callback);
+		break;
+	case Node::kSyntaxDefinition:
+		callback(static_cast<SyntaxDefinition*>(node)->Name());
+		break;
+	case Node::kAssignment:
+		ForEachDefinition(static_cast<Assignment*>(node)->Value(), callback);
+		break;
+	case Node::kIf:
+		ForEachDefinition(static_cast<If*>(node)->Predicate(), callback);
+		ForEachDefinition(static_cast<If*>(node)->Consequent(), callback);
+		ForEachDefinition(static_cast<If*>(node)->Alternative(), callback);
+		break;
+	case Node::kSequence:
+	case Node::kAnd:
+	case Node::kOr:
+		for (auto action : static_cast<Sequence*>(node)->Actions())
+			ForEachDefinition(action, callback);
+		break;
+	case Node::kApplication:
+		ForEachDefinition(static_cast<Application*>(node)->Operator(),
+				callback);
+		for (auto operand : static_cast<Application*>(node)->Operands())
+			ForEachDefinition(operand, callback);
+		break;
+	case Node::kConstant:
+	case Node::kVariable:
+	case Node::kLambda:
+		break;
+	}
+}
+
+} // namespace vm
+} // namespace ajimu
+
+#endif //AJIMU_VM_NODE_H
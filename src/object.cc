@@ -1,6 +1,8 @@
 #include "object.h"
 #include "object_management.h"
 #include "string.h"
+#include "node.h"
+#include "continuation.h"
 #include "utils.h"
 
 namespace ajimu {
@@ -8,40 +10,79 @@ namespace values {
 
 std::string PrimitiveValue2String(Object *o);
 
+#if defined(AJIMU_COMPRESSED_REFS)
+uintptr_t Object::ref_base_ = 0;
+#endif
+
 Object::~Object() {
-	switch (OwnedType()) {
+	switch (TypeOf(this)) {
 	case SYMBOL:
-		delete[] symbol_.name;
+		delete[] symbol_;
+		break;
+	case CLOSURE:
+		Lambda()->Unref();
+#if defined(AJIMU_COMPRESSED_REFS)
+		delete closure_;
+#endif
+		break;
+	case CONTINUATION:
+		delete continuation_;
 		break;
 	default:
 		break;
 	}
 }
 
-std::string Object::ToString(ObjectManagement *obm) {
-	switch (OwnedType()) {
+void Object::SetClosure(vm::Environment *env, vm::Lambda *lambda) {
+#if defined(AJIMU_COMPRESSED_REFS)
+	closure_ = new ClosureData;
+#endif
+	ClosureData *closure = const_cast<ClosureData *>(ClosurePayload());
+	closure->env    = env;
+	closure->lambda = lambda;
+	lambda->Ref();
+}
+
+Object *Object::Params() const {
+	DCHECK(IsClosure(this)); return Lambda()->Params();
+}
+
+Object *Object::Body() const {
+	DCHECK(IsClosure(this)); return Lambda()->Source();
+}
+
+Object *Object::Expanded() const {
+	DCHECK(IsClosure(this)); return Lambda()->Expanded();
+}
+
+std::string Object::ToString(Object *o, ObjectManagement *obm) {
+	switch (TypeOf(o)) {
 	case BOOLEAN:
-		return utils::Formatf("%s", Boolean() ? "#t" : "#f");
+		return utils::Formatf("%s", Boolean(o) ? "#t" : "#f");
 	case SYMBOL:
-		return utils::Formatf("%s", Symbol());
+		return utils::Formatf("%s", o->Symbol());
 	case FIXED:
-		return utils::Formatf("%lld", Fixed());
+		return utils::Formatf("%lld", Fixed(o));
 	case REAL:
-		return utils::Formatf("%lf", Real());
+		return utils::Formatf("%lf", o->Real());
 	case CHARACTER:
-		return utils::Formatf("%c", Character());
+		return utils::Formatf("%c", Character(o));
 	case STRING:
-		return std::move(String()->str());
+		return std::move(o->String()->str());
 	case PAIR: {
-			if (obm->Null(this))
+			if (obm->Null(o))
 				return "null";
 			int i = 0;
 			std::string str("(");
-			Object *o = this;
 			while (!obm->Null(o)) {
 				if (i++ > 0)
 					str.append(" ");
-				str.append(car(o)->ToString(obm));
+				if (!IsPair(o)) { // Improper list, like (a . b)
+					str.append(". ");
+					str.append(ToString(o, obm));
+					break;
+				}
+				str.append(ToString(car(o), obm));
 				o = cdr(o);
 			}
 			str.append(")");
@@ -54,6 +95,8 @@ std::string Object::ToString(ObjectManagement *obm) {
 	case PRIMITIVE:
 		// TODO:
 		break;
+	case CONTINUATION:
+		return "<continuation>";
 	}
 	return "";
 }
@@ -4,11 +4,14 @@
 #include "reachable.h"
 #include "glog/logging.h"
 #include <string>
+#include <stdint.h>
 
 namespace ajimu {
 namespace vm {
 class Mach;
 class Environment;
+class Lambda;
+struct Continuation;
 } // namespace vm
 namespace values {
 class ObjectManagement;
@@ -25,148 +28,380 @@ enum Type {
 	PAIR,
 	CLOSURE,
 	PRIMITIVE,
+	CONTINUATION,
 };
 
-typedef Object *(vm::Mach::*PrimitiveMethodPtr)(Object *);
+// Arguments be passed in array: argv[0] is the first one.
+typedef Object *(vm::Mach::*PrimitiveMethodPtr)(Object **argv, int argc);
 
-class Object : public Reachable {
+//
+// Primitive proc, the arity is checked once before calling.
+//
+struct PrimitiveProc {
+	const char *name;
+	PrimitiveMethodPtr method; // nullptr if the vm deals it, like apply
+	int min_args;
+	int max_args; // -1 if variadic
+};
+
+//
+// Reference of object in pair: a pointer, or a 32-bit word if building
+// with AJIMU_COMPRESSED_REFS. The compressed one is the offset of heap
+// object from the base of object pages, or the low 32 bits of immediate
+// value.
+//
+#if defined(AJIMU_COMPRESSED_REFS)
+typedef uint32_t ObjectRef;
+#else
+typedef Object *ObjectRef;
+#endif
+
+//
+// Object pointer may be a tagged word, the immediate value never be
+// allocated in heap and not in gc lists:
+//
+// [ value : 63 bits          ][ 1 ]    Fixed number
+// [ value : 56 bits ][ 5 bits ][ 010 ] Boolean, Character and '()
+// [ address                  ][ 000 ] Heap object
+//
+// The pointer may be not aligned, so the tag be checked by the static
+// functions on the pointer word. The member functions can be called only
+// for the heap object.
+//
+// Heap object is 3 words: the header word packs the color, generation
+// bits and type, the next 2 words are the payload. All objects have the
+// same size, the closure keeps its params and body in the lambda.
+//
+// With compressed refs, heap object is 2 words: the pair has two 32-bit
+// refs in one word, the closure be out of line.
+//
+class Object : public GcHeader {
 public:
+	enum Tag {
+		kFixedTag     = 0x1,
+		kImmediateTag = 0x2,
+		kTagMask      = 0x7,
+		kTagBits      = 3,
+	};
+
+	enum ImmediateKind {
+		kImmediateBoolean,
+		kImmediateCharacter,
+		kImmediateEmptyList,
+	};
+
+	enum {
+		kImmediateShift = 8,
+	};
+
 	~Object();
 
-	std::string ToString(ObjectManagement *obm);
+	static std::string ToString(Object *o, ObjectManagement *obm);
 
-	Type OwnedType() const {
-		return owned_type_;
+	//
+	// Immediate values:
+	//
+	static bool FitsFixed(long long value) {
+		return value >= (INTPTR_MIN >> 1) && value <= (INTPTR_MAX >> 1);
 	}
 
-	long long Fixed() const {
-		DCHECK(IsFixed()); return fixed_;
+	static Object *MakeFixed(long long value) {
+		DCHECK(FitsFixed(value));
+		return FromWord((static_cast<uintptr_t>(value) << 1) | kFixedTag);
 	}
 
-	long long ToFixed() const {
-		DCHECK(IsFixed() || IsReal());
-		return static_cast<long long>(IsFixed() ? Fixed() : Real());
+	static Object *MakeBoolean(bool value) {
+		return MakeImmediate(kImmediateBoolean, value ? 1 : 0);
 	}
 
-	double Real() const {
-		DCHECK(IsReal()); return real_;
+	static Object *MakeCharacter(char value) {
+		return MakeImmediate(kImmediateCharacter,
+				static_cast<unsigned char>(value));
 	}
 
-	double ToReal() const {
-		DCHECK(IsFixed() || IsReal());
-		return static_cast<double>(IsFixed() ? Fixed() : Real());
+	static Object *MakeEmptyList() {
+		return MakeImmediate(kImmediateEmptyList, 0);
 	}
 
-	bool Boolean() const {
-		DCHECK(IsBoolean()); return boolean_;
+	static bool IsHeapObject(const Object *o) {
+		return (Word(o) & kTagMask) == 0;
 	}
 
-	char Character() const {
-		DCHECK(IsCharacter()); return character_;
+	static bool IsTaggedFixed(const Object *o) {
+		return (Word(o) & kFixedTag) != 0;
 	}
 
-	class String *String() const {
-		DCHECK(IsString()); return string_;
+	static bool IsImmediate(const Object *o) {
+		return !IsHeapObject(o);
 	}
 
-	const char *Symbol() const {
-		DCHECK(IsSymbol()); return symbol_.name;
+	static Type TypeOf(const Object *o) {
+		if (IsHeapObject(o))
+			return static_cast<Type>(o->owned_type_);
+		if (IsTaggedFixed(o))
+			return FIXED;
+		switch (ImmediateKindOf(o)) {
+		case kImmediateBoolean:
+			return BOOLEAN;
+		case kImmediateCharacter:
+			return CHARACTER;
+		default:
+			return PAIR; // '() is a list.
+		}
 	}
 
-	class String *SymbolO() const {
-		DCHECK(IsSymbol()); return nullptr;
+	static long long Fixed(const Object *o) {
+		DCHECK(IsFixed(o));
+		if (IsTaggedFixed(o))
+			return static_cast<long long>(
+					static_cast<intptr_t>(Word(o)) >> 1);
+		return o->fixed_;
 	}
 
-	int SymbolIndex() const {
-		DCHECK(IsSymbol()); return symbol_.index;
+	static long long ToFixed(const Object *o) {
+		DCHECK(IsFixed(o) || IsReal(o));
+		return static_cast<long long>(IsFixed(o) ? Fixed(o) : o->Real());
+	}
+
+	static double ToReal(const Object *o) {
+		DCHECK(IsFixed(o) || IsReal(o));
+		return static_cast<double>(IsFixed(o) ? Fixed(o) : o->Real());
 	}
 
-	PrimitiveMethodPtr Primitive() const {
-		DCHECK(IsPrimitive()); return primitive_;
+	static bool Boolean(const Object *o) {
+		DCHECK(IsBoolean(o)); return ImmediateValue(o) != 0;
 	}
 
-	Object *Params() const {
-		DCHECK(IsClosure()); return closure_.params;
+	static char Character(const Object *o) {
+		DCHECK(IsCharacter(o));
+		return static_cast<char>(ImmediateValue(o));
 	}
 
-	Object *Body() const {
-		DCHECK(IsClosure()); return closure_.body;
+	//
+	// Heap objects:
+	//
+	double Real() const {
+		DCHECK(IsReal(this)); return real_;
+	}
+
+	class String *String() const {
+		DCHECK(IsString(this)); return string_;
+	}
+
+	const char *Symbol() const {
+		DCHECK(IsSymbol(this)); return symbol_;
 	}
 
+	int SymbolIndex() const {
+		DCHECK(IsSymbol(this)); return symbol_index_;
+	}
+
+	const PrimitiveProc *Primitive() const {
+		DCHECK(IsPrimitive(this)); return primitive_;
+	}
+
+	vm::Continuation *Continuation() const {
+		DCHECK(IsContinuation(this)); return continuation_;
+	}
+
+	// Kept by the lambda
+	Object *Params() const;
+
+	Object *Body() const;
+
+	Object *Expanded() const;
+
 	vm::Environment *Environment() const {
-		DCHECK(IsClosure()); return closure_.env;
+		DCHECK(IsClosure(this)); return ClosurePayload()->env;
+	}
+
+	vm::Lambda *Lambda() const {
+		DCHECK(IsClosure(this)); return ClosurePayload()->lambda;
 	}
 
 	Object *Car() const {
-		DCHECK(IsPair()); return pair_.car;
+		DCHECK(IsPair(this) && IsHeapObject(this));
+		return FromRef(pair_.car);
 	}
 
 	Object *Cdr() const {
-		DCHECK(IsPair()); return pair_.cdr;
+		DCHECK(IsPair(this) && IsHeapObject(this));
+		return FromRef(pair_.cdr);
+	}
+
+	// It can be stored in pair. With compressed refs, the tagged fixed
+	// number out of 31 bits must be boxed first.
+	static bool FitsRef(const Object *o) {
+#if defined(AJIMU_COMPRESSED_REFS)
+		return IsHeapObject(o) || static_cast<intptr_t>(Word(o)) ==
+			static_cast<int32_t>(static_cast<uint32_t>(Word(o)));
+#else
+		(void)o;
+		return true;
+#endif
 	}
 
-	bool IsFixed() const { return OwnedType() == FIXED; }
-	bool IsReal() const { return OwnedType() == REAL; }
-	bool IsBoolean() const { return OwnedType() == BOOLEAN; }
-	bool IsCharacter() const { return OwnedType() == CHARACTER; }
-	bool IsSymbol() const { return OwnedType() == SYMBOL; }
-	bool IsString() const { return OwnedType() == STRING; }
-	bool IsPair() const { return OwnedType() == PAIR; }
-	bool IsClosure() const { return OwnedType() == CLOSURE; }
-	bool IsPrimitive() const { return OwnedType() == PRIMITIVE; }
+	static bool IsFixed(const Object *o) {
+		return IsTaggedFixed(o) || HeapTypeIs(o, FIXED);
+	}
+	static bool IsReal(const Object *o) { return HeapTypeIs(o, REAL); }
+	static bool IsBoolean(const Object *o) {
+		return ImmediateKindIs(o, kImmediateBoolean);
+	}
+	static bool IsCharacter(const Object *o) {
+		return ImmediateKindIs(o, kImmediateCharacter);
+	}
+	static bool IsSymbol(const Object *o) { return HeapTypeIs(o, SYMBOL); }
+	static bool IsString(const Object *o) { return HeapTypeIs(o, STRING); }
+	static bool IsPair(const Object *o) {
+		return HeapTypeIs(o, PAIR) ||
+			ImmediateKindIs(o, kImmediateEmptyList);
+	}
+	static bool IsClosure(const Object *o) {
+		return HeapTypeIs(o, CLOSURE);
+	}
+	static bool IsPrimitive(const Object *o) {
+		return HeapTypeIs(o, PRIMITIVE);
+	}
+	static bool IsContinuation(const Object *o) {
+		return HeapTypeIs(o, CONTINUATION);
+	}
 
 	friend class ObjectManagement;
+	friend class ObjectSpace;
+	friend class Sweeper;
 private:
-	Object(Type type, Reachable *next, unsigned white)
-		: Reachable(next, white)
-		, owned_type_(type) {
+	Object(Type type, unsigned white)
+		: GcHeader(white)
+		, owned_type_(static_cast<uint8_t>(type))
+		, symbol_index_(-1) {
 	}
 
-	Type owned_type_;
-	union {
-		// Boolean : #t or #f
-		bool boolean_;
+	struct ClosureData {
+		vm::Environment *env;
+		vm::Lambda *lambda; // Analyzed body
+	};
+
+	void SetClosure(vm::Environment *env, vm::Lambda *lambda);
+
+	const ClosureData *ClosurePayload() const {
+#if defined(AJIMU_COMPRESSED_REFS)
+		return closure_;
+#else
+		return &closure_;
+#endif
+	}
+
+#if defined(AJIMU_COMPRESSED_REFS)
+	// Base of the object pages, set by ObjectSpace.
+	static uintptr_t ref_base_;
+
+	static ObjectRef ToRef(Object *o) {
+		DCHECK(o != nullptr && FitsRef(o));
+		if (IsHeapObject(o)) {
+			DCHECK_LT(Word(o) - ref_base_, 1ULL << 32);
+			return static_cast<uint32_t>(Word(o) - ref_base_);
+		}
+		return static_cast<uint32_t>(Word(o));
+	}
+
+	static Object *FromRef(ObjectRef ref) {
+		if (ref & kTagMask) // Sign extend the fixed number
+			return FromWord(static_cast<uintptr_t>(
+					static_cast<intptr_t>(static_cast<int32_t>(ref))));
+		return FromWord(ref_base_ + ref);
+	}
+#else
+	static ObjectRef ToRef(Object *o) { return o; }
+
+	static Object *FromRef(ObjectRef ref) { return ref; }
+#endif
 
-		// Fixed number
+	static Object *FromWord(uintptr_t word) {
+		return reinterpret_cast<Object *>(word);
+	}
+
+	static Object *MakeImmediate(ImmediateKind kind, uintptr_t value) {
+		return FromWord((value << kImmediateShift) |
+				(static_cast<uintptr_t>(kind) << kTagBits) | kImmediateTag);
+	}
+
+	static uintptr_t Word(const Object *o) {
+		return reinterpret_cast<uintptr_t>(o);
+	}
+
+	static ImmediateKind ImmediateKindOf(const Object *o) {
+		DCHECK_EQ(static_cast<uintptr_t>(kImmediateTag), Word(o) & kTagMask);
+		return static_cast<ImmediateKind>(
+				(Word(o) & ((1U << kImmediateShift) - 1)) >> kTagBits);
+	}
+
+	static uintptr_t ImmediateValue(const Object *o) {
+		return Word(o) >> kImmediateShift;
+	}
+
+	// The payload be read only after the tag is checked.
+	static bool HeapTypeIs(const Object *o, Type type) {
+		return IsHeapObject(o) &&
+			o->owned_type_ == static_cast<uint8_t>(type);
+	}
+
+	static bool ImmediateKindIs(const Object *o, ImmediateKind kind) {
+		return (Word(o) & kTagMask) == kImmediateTag &&
+			ImmediateKindOf(o) == kind;
+	}
+
+	uint8_t owned_type_;   // In the header word
+	int32_t symbol_index_; // In the header word, fast index of symbol
+	union {
+		// Fixed number, out of range of tagged fixed number
 		long long fixed_;
 	
 		// Real number
 		double real_;
 
-		// 8bit Character
-		char character_;
-
 		// Pooled String
 		class String *string_;
 
-		// Symbol : name > symbol literal
-		//        : index > fast index
-		struct {
-			char *name;
-			int index;
-		} symbol_;
+		// Symbol literal
+		char *symbol_;
 
 		// Pair or List node
 		struct {
-			Object *car;
-			Object *cdr;
+			ObjectRef car;
+			ObjectRef cdr;
 		} pair_;
 
+#if defined(AJIMU_COMPRESSED_REFS)
+		// Out of line
+		ClosureData *closure_;
+#else
 		// Closure:
-		struct {
-			Object *params;
-			Object *body;
-			vm::Environment *env;
-		} closure_;
+		ClosureData closure_;
+#endif
+
+		// Primitive proc, static
+		const PrimitiveProc *primitive_;
 
-		// Primitive proc
-		PrimitiveMethodPtr primitive_;
+		// Continuation, out of line
+		vm::Continuation *continuation_;
+
+		// Free slot of object page
+		Object *next_free_;
 	};
 
 	Object(const Object &) = delete;
 	void operator = (const Object &) = delete;
 }; // class Object
 
+#if defined(AJIMU_COMPRESSED_REFS)
+static_assert(sizeof(Object) == 2 * sizeof(void *),
+		"Object must be a header word and 1 word of payload.");
+#else
+static_assert(sizeof(Object) == 3 * sizeof(void *),
+		"Object must be a header word and 2 words of payload.");
+#endif
+
 //
 // List operators:
 //
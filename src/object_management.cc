@@ -1,41 +1,76 @@
 #include "object_management.h"
+#include "continuation.h"
 #include "environment.h"
+#include "node.h"
 #include "local.h"
 #include "string_pool.h"
 #include "string.h"
+#include "heap.h"
+#include "object_space.h"
+#include "parallel_marker.h"
+#include "sweeper.h"
+#include "stack_scanner.h"
 #include "glog/logging.h"
 #include <string.h>
+#include <algorithm>
+#include <chrono>
 
 namespace ajimu {
 namespace values {
 
 using vm::Environment;
 
+static size_t ElapsedNanoseconds(
+		std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
 ObjectManagement::ObjectManagement()
-	: pool_(new StringPool)
+	: heap_(new Heap)
+	, space_(new ObjectSpace)
+	, pool_(new StringPool(heap_.get()))
 	, gc_root_(nullptr)
 	, gc_state_(kPause)
 	, white_flag_(Reachable::WHITE_BIT0)
-	, gc_threshold_(DEFAULT_GC_THRESHOLD)
+	, gc_threshold_(DEFAULT_GC_MIN_HEAP)
+	, gc_growth_(DEFAULT_GC_GROWTH)
+	, gc_min_heap_(DEFAULT_GC_MIN_HEAP)
+	, gc_max_heap_(DEFAULT_GC_MAX_HEAP)
+	, gc_quantum_(DEFAULT_GC_QUANTUM)
+	, gc_nursery_(DEFAULT_GC_NURSERY)
+	, gc_threads_(DEFAULT_GC_THREADS)
+	, gc_concurrent_sweep_(false)
+	, seal_requested_(false)
 	, allocated_(0)
-	, obj_list_(nullptr)
-	, env_list_(nullptr) {
+	, young_allocated_(0)
+	, sweep_cursor_(nullptr)
+	, sweep_string_cursor_(0)
+	, env_list_(nullptr)
+	, young_env_list_(nullptr)
+	, perm_env_list_(nullptr) {
 	memset(constant_, 0, sizeof(constant_));
+	memset(&stats_, 0, sizeof(stats_));
 }
 
 ObjectManagement::~ObjectManagement() {
-	Reachable *i, *p;
-	i = obj_list_;
-	while (i) {
-		p = i;
-		i = i->next_;
-		delete static_cast<Object*>(p);
+	if (sweeper_ && sweeper_->Sweeping())
+		ReclaimSwept(true);
+	// Young objects are in the pages too.
+	for (auto page = space_->Pages(); page; page = page->next) {
+		for (Object *o = page->Begin(); o != page->End(); ++o) {
+			if (!ObjectSpace::IsFree(o))
+				o->~Object();
+		}
 	}
-	i = env_list_;
-	while (i) {
-		p = i;
-		i = i->next_;
-		delete static_cast<Environment*>(p);
+	Reachable *i, *p;
+	for (auto list : { env_list_, young_env_list_, perm_env_list_ }) {
+		i = list;
+		while (i) {
+			p = i;
+			i = i->next_;
+			CollectEnvironment(static_cast<Environment*>(p));
+		}
 	}
 }
 
@@ -43,7 +78,7 @@ void ObjectManagement::Init() {
 	// Constants initializing:
 	constant_[kFalse] = NewBoolean(false);
 	constant_[kTrue]  = NewBoolean(true);
-	constant_[kEmptyList] = Cons(nullptr, nullptr);
+	constant_[kEmptyList] = Object::MakeEmptyList();
 	constant_[kQuoteSymbol] = NewSymbol("quote");
 	constant_[kOkSymbol] = NewSymbol("ok");
 	constant_[kDefineSymbol] = NewSymbol("define");
@@ -69,6 +104,53 @@ size_t ObjectManagement::Allocated() const {
 	return allocated_ + pool_->Allocated();
 }
 
+void ObjectManagement::SetGcGrowth(double growth) {
+	DCHECK_GE(growth, 1.0);
+	gc_growth_ = growth;
+	gc_threshold_ = PaceThreshold(Allocated());
+}
+
+void ObjectManagement::SetGcMinHeap(size_t bytes) {
+	gc_min_heap_ = bytes;
+	gc_threshold_ = PaceThreshold(Allocated());
+}
+
+void ObjectManagement::SetGcMaxHeap(size_t bytes) {
+	gc_max_heap_ = bytes;
+	gc_threshold_ = PaceThreshold(Allocated());
+}
+
+void ObjectManagement::SetMarkStackLimit(size_t limit) {
+	gray_obj_.SetLimit(limit);
+	gray_env_.SetLimit(limit);
+	if (marker_)
+		marker_->SetMarkStackLimit(limit);
+}
+
+void ObjectManagement::SetGcConservative(bool on) {
+	stack_scanner_.reset(on ? new StackScanner : nullptr);
+}
+
+void ObjectManagement::SetGcThreads(int threads) {
+	DCHECK_GE(threads, 1);
+	gc_threads_ = threads;
+	if (threads == 1) {
+		marker_.reset();
+		return;
+	}
+	marker_.reset(new ParallelMarker(threads, &symbol_));
+	marker_->SetMarkStackLimit(gray_obj_.Limit());
+}
+
+// The max heap wins, if it's less than min heap.
+size_t ObjectManagement::PaceThreshold(size_t live) const {
+	double target = static_cast<double>(live) * gc_growth_;
+	size_t threshold = target >= static_cast<double>(gc_max_heap_) ?
+		gc_max_heap_ : static_cast<size_t>(target);
+	threshold = std::max(threshold, gc_min_heap_);
+	return std::min(threshold, gc_max_heap_);
+}
+
 Object *ObjectManagement::Constant(Constants e) const {
 	int i = static_cast<int>(e);
 	DCHECK(i >= 0 && i < kMax);
@@ -77,8 +159,14 @@ Object *ObjectManagement::Constant(Constants e) const {
 
 Object *ObjectManagement::NewSymbol(const std::string &raw) {
 	auto iter = symbol_.find(raw);
-	if (iter != symbol_.end())
+	if (iter != symbol_.end()) {
+		// Symbol table is weak, the symbol may be not marked in this
+		// cycle, keep it from sweeping. The dead ones be dropped from the
+		// table before the background sweeping.
+		if (!sweeper_ || !sweeper_->Sweeping())
+			ObjectSpace::Retain(iter->second);
 		return iter->second;
+	}
 
 	char *dup = new char[raw.size() + 1];
 	memcpy(dup, raw.c_str(), raw.size());
@@ -86,8 +174,7 @@ Object *ObjectManagement::NewSymbol(const std::string &raw) {
 
 	Object *o = AllocateObject(SYMBOL);
 	symbol_.insert(std::move(std::make_pair(raw, o)));
-	o->symbol_.name = dup;
-	o->symbol_.index = -1;
+	o->symbol_ = dup;
 	return o;
 }
 
@@ -97,22 +184,25 @@ Object *ObjectManagement::NewString(const char *raw, size_t len) {
 	return o;
 }
 
-Object *ObjectManagement::NewClosure(Object *params, Object *body,
-		Environment *env) {
+Object *ObjectManagement::NewClosure(vm::Lambda *lambda, Environment *env) {
 	Object *o = AllocateObject(CLOSURE);
-	o->closure_.params = params;
-	o->closure_.body   = body;
-	o->closure_.env    = env;
+	o->SetClosure(env, lambda);
+	return o;
+}
+
+Object *ObjectManagement::NewContinuation(vm::Continuation *cont) {
+	Object *o = AllocateObject(CONTINUATION);
+	o->continuation_ = cont;
 	return o;
 }
 
-Object *ObjectManagement::NewPrimitive(const std::string &name,
-		PrimitiveMethodPtr method) {
+Object *ObjectManagement::NewPrimitive(const PrimitiveProc *proc) {
 	Object *o = AllocateObject(PRIMITIVE);
-	o->primitive_ = method;
+	o->primitive_ = proc;
 
 	// Primitive Proc must be in global environment!
-	GlobalEnvironment()->Define(NewSymbol(name)->Symbol(), o);
+	GlobalEnvironment()->Define(NewSymbol(proc->name)->Symbol(), o);
+	WriteBarrier(GlobalEnvironment(), o);
 	return o;
 }
 
@@ -121,188 +211,761 @@ Environment *ObjectManagement::NewEnvironment(Environment *top) {
 		DLOG(ERROR) << "Local environment top not be `nullptr\'.";
 		return nullptr;
 	}
-	allocated_ += sizeof(Environment);
+	auto env = new (heap_->Allocate(sizeof(Environment)))
+		Environment(top, nullptr, white_flag_);
+	LinkEnvironment(env, sizeof(Environment));
+	return env;
+}
+
+Environment *ObjectManagement::NewFrame(Object *closure,
+		const std::vector<Object*> *names) {
+	DCHECK(Object::IsClosure(closure));
+	size_t size = Environment::SizeOf(names->size());
 
-	auto env = new Environment(top, env_list_, white_flag_);
-	env_list_ = env; // Linked to environment list.
+	auto env = Environment::NewFrame(heap_->Allocate(size),
+			closure->Environment(), closure, names, nullptr, white_flag_);
+	LinkEnvironment(env, size);
 	return env;
 }
 
 Environment *ObjectManagement::TEST_NewEnvironment(vm::Environment *top) {
-	allocated_ += sizeof(Environment);
-
-	auto env = new Environment(top, env_list_, white_flag_);
-	env_list_ = env; // Linked to environment list.
+	auto env = new (heap_->Allocate(sizeof(Environment)))
+		Environment(top, nullptr, white_flag_);
+	LinkEnvironment(env, sizeof(Environment));
 	return env;
 }
 
+void ObjectManagement::LinkEnvironment(Environment *env, size_t size) {
+	allocated_ += size;
+	if (gc_state_ == kPause) {
+		young_allocated_ += size;
+		env->next_ = young_env_list_;
+		young_env_list_ = env;
+		return;
+	}
+	// No young generation in major gc.
+	env->next_ = env_list_;
+	env_list_ = env;
+	env->old_ = true;
+	if (gc_state_ == kPropagate) {
+		// Will be scanned in this cycle, it has no barrier before.
+		env->ToGray();
+		gray_env_.Push(env);
+	}
+}
+
 Object *ObjectManagement::AllocateObject(Type type) {
+	void *chunk = space_->Allocate();
+	if (!chunk)
+		chunk = AllocateObjectSlow();
 	allocated_ += sizeof(Object);
 
-	Object *o = new Object(type, obj_list_, white_flag_);
-	freed_.erase(o);
-	obj_list_= o; // Linked to object list.
+	Object *o = new (chunk) Object(type, white_flag_);
+	if (gc_state_ == kPause) {
+		young_allocated_ += sizeof(Object);
+		space_->RecordYoung(o);
+		return o;
+	}
+	// No young generation in major gc.
+	o->old_ = true;
+	if (gc_state_ == kPropagate &&
+			(type == PAIR || type == CLOSURE || type == CONTINUATION)) {
+		// Fields will be filled without barrier, scan it in this cycle.
+		// It has been marked by allocating.
+		if (!gray_obj_.Push(o))
+			ObjectSpace::AtomicMarkGray(o);
+	}
 	return o;
 }
 
+void *ObjectManagement::AllocateObjectSlow() {
+	void *chunk;
+	if (sweeper_ && sweeper_->Sweeping()) {
+		// Not wait for the sweeper, a new page is cheaper.
+		ReclaimSwept(false);
+		if ((chunk = space_->Allocate()) != nullptr)
+			return chunk;
+	}
+	while (space_->Sweeping()) {
+		SweepObjectPage();
+		if ((chunk = space_->Allocate()) != nullptr)
+			return chunk;
+	}
+	space_->AddPage();
+	return space_->Allocate();
+}
+
+void ObjectManagement::FinishSweeping() {
+	if (sweeper_ && sweeper_->Sweeping())
+		ReclaimSwept(true);
+	while (space_->Sweeping())
+		SweepObjectPage();
+}
+
+bool ObjectManagement::ReclaimSwept(bool wait) {
+	Sweeper::Result result;
+	bool done = sweeper_->Take(&result, wait);
+	if (result.free_head)
+		space_->AddFreeSlots(result.free_head, result.free_tail);
+	for (auto chunk : result.dead_envs)
+		heap_->Free(chunk.first, chunk.second);
+	allocated_ -= result.object_bytes_swept + result.env_bytes_swept;
+	stats_.pages_swept += result.pages_swept;
+	stats_.objects_swept += result.objects_swept;
+	stats_.object_bytes_swept += result.object_bytes_swept;
+	stats_.envs_swept += result.envs_swept;
+	stats_.env_bytes_swept += result.env_bytes_swept;
+	if (!done)
+		return false;
+
+	if (result.envs) {
+		result.envs_tail->next_ = env_list_;
+		env_list_ = result.envs;
+	}
+	gc_threshold_ = PaceThreshold(Allocated());
+	return true;
+}
+
+void ObjectManagement::SweepSymbols() {
+	for (auto iter = symbol_.begin(); iter != symbol_.end();) {
+		Object *o = iter->second;
+		if (!o->IsPermanent() && !ObjectSpace::IsMarked(o))
+			iter = symbol_.erase(iter);
+		else
+			++iter;
+	}
+}
+
 void ObjectManagement::GcTick(vm::Local<Object> *local,
 		vm::Local<Environment> *env) {
-//tail:
-	switch (gc_state_) {
-	case kPause: // GC Pause
+	if (seal_requested_) {
+		Seal(local, env);
+		return;
+	}
+	if (gc_state_ == kPause) {
+		// Major gc only works on old ones, so promote young ones first.
+		if (young_allocated_ >= gc_nursery_ || Allocated() >= Threshold())
+			MinorGc(local, env);
 		if (Allocated() < Threshold())
 			return;
+	}
+
+	int phase = gc_state_;
+	auto start = std::chrono::steady_clock::now();
+	switch (gc_state_) {
+	case kPause: // GC Pause
+		// The marks of unswept pages are not cleared, they must be swept
+		// before marking. One page per tick, the threshold be paced again
+		// by the last page.
+		if (space_->Sweeping()) {
+			SweepObjectPage();
+			break;
+		}
+		if (sweeper_ && sweeper_->Sweeping()) {
+			ReclaimSwept(true);
+			break;
+		}
+		if (gc_concurrent_sweep_ != static_cast<bool>(sweeper_))
+			sweeper_.reset(gc_concurrent_sweep_ ? new Sweeper : nullptr);
 		// Switch the white flag!
 		white_flag_ = InvWhite(white_flag_);
-		// Mark root first.
-		gc_root_->ToBlack();
-		// Mark local expr
-		for (auto val : local->Values())
-			MarkObject(val);
-		for (auto val : env->Values())
-			MarkEnvironment(val);
-		++gc_state_; 
+		space_->StartMarking();
+		MarkRoots(local, env);
+		++gc_state_;
 		break;
-	case kPropagate: // Mark root environment
-		// Mark constants
-		for (auto k : constant_)
-			MarkObject(k);
-		// Mark one slot by one time!
-		for (auto entry : gc_root_->Entries()) {
-			DCHECK(symbol_.find(entry.first) != symbol_.end())
-				<< "Symbol table has not: "
-				<< entry.first
-				<< " for mark!";
-
-			MarkObject(symbol_[entry.first]);
-			MarkObject(gc_root_->At(entry.second));
+	case kPropagate:
+		if (marker_) {
+			ParallelPropagate();
+		} else if (!Propagate(gc_quantum_)) {
+			break;
 		}
+		// The stacks have no barrier, so rescan them and finish marking
+		// in one step.
+		MarkRoots(local, env);
+		if (marker_)
+			ParallelPropagate();
+		else
+			Propagate(static_cast<size_t>(-1));
+		sweep_cursor_ = &env_list_;
 		++gc_state_;
 		break;
 	case kSweepEnv: // Sweep environments
-		SweepEnvironment();
+		if (sweeper_) {
+			// Objects and environments be swept by the sweeper thread.
+			SweepSymbols();
+			sweeper_->Start(space_->Pages(), env_list_, white_flag_);
+			space_->ResetFreeList();
+			env_list_ = nullptr;
+			sweep_cursor_ = nullptr;
+		} else if (!SweepEnvironment(gc_quantum_)) {
+			break;
+		}
+		sweep_string_cursor_ = StringPool::kLargeListCursor;
 		++gc_state_;
 		break;
-	case kSweepString:
-		pool_->Sweep(white_flag_);
+	case kSweepString: {
+			size_t allocated = pool_->Allocated();
+			int sweeped = 0;
+			bool done = pool_->Sweep(white_flag_, &sweep_string_cursor_,
+					gc_quantum_, &sweeped);
+			stats_.strings_swept += sweeped;
+			stats_.string_bytes_swept += allocated - pool_->Allocated();
+			if (!done)
+				break;
+		}
+		sweep_cursor_ = nullptr;
 		++gc_state_;
 		break;
-	case kSweep: // Sweep objects
-		SweepObject();
+	case kSweep: // Objects be swept lazily, by allocating or pausing.
+		if (!sweeper_)
+			space_->StartSweeping();
 		++gc_state_;
 		break;
 	case kFinalize:
+		// The garbage in unswept pages is counted, it will be paced again
+		// after all pages be swept.
+		gc_threshold_ = PaceThreshold(Allocated());
 		gc_state_ = kPause;
+		++stats_.major_cycles;
 		break;
 	default:
 		DLOG(FATAL) << "No reached!";
 		break;
 	}
+	stats_.phase[phase].Record(ElapsedNanoseconds(start));
+}
+
+void ObjectManagement::Seal(vm::Local<Object> *local,
+		vm::Local<Environment> *env) {
+	seal_requested_ = false;
+	// No gray or unswept one, and all reachable ones be old.
+	while (gc_state_ != kPause)
+		GcTick(local, env);
+	FinishSweeping();
+	MinorGc(local, env);
+
+	std::vector<Object*> objs;
+	std::vector<Environment*> envs;
+	auto seal_object = [&objs] (Object *o) {
+		if (Object::IsHeapObject(o) && !o->IsPermanent()) {
+			o->ToPermanent();
+			objs.push_back(o);
+		}
+	};
+	auto seal_environment = [&envs] (Environment *e) {
+		if (e && !e->IsPermanent()) {
+			e->ToPermanent();
+			envs.push_back(e);
+		}
+	};
+	auto seal_object_fields = [&] (Object *o) {
+		switch (Object::TypeOf(o)) {
+		case STRING:
+			o->String()->ToPermanent();
+			break;
+		case CLOSURE:
+			seal_object(o->Params());
+			seal_object(o->Body());
+			seal_object(o->Expanded());
+			seal_environment(o->Environment());
+			break;
+		case PAIR:
+			seal_object(car(o));
+			seal_object(cdr(o));
+			break;
+		case CONTINUATION:
+			o->Continuation()->ForEach(seal_object, seal_environment);
+			break;
+		default:
+			break;
+		}
+	};
+	auto seal_environment_fields = [&] (Environment *e) {
+		seal_environment(e->Next());
+		if (e->Closure())
+			seal_object(e->Closure());
+		for (size_t i = 0; i < e->Count(); ++i)
+			seal_object(e->At(i));
+		for (const auto &entry : e->Entries())
+			seal_object(symbol_[entry.first]);
+	};
+
+	seal_environment(gc_root_);
+	for (auto k : constant_)
+		seal_object(k);
+	// The permanent holders point to others.
+	for (auto o : perm_remembered_obj_) {
+		o->remembered_ = false;
+		seal_object_fields(o);
+	}
+	perm_remembered_obj_.clear();
+	for (auto e : perm_remembered_env_) {
+		e->remembered_ = false;
+		seal_environment_fields(e);
+	}
+	perm_remembered_env_.clear();
+
+	size_t sealed_objs = 0, sealed_envs = 0, bytes = 0;
+	while (!objs.empty() || !envs.empty()) {
+		if (!objs.empty()) {
+			Object *o = objs.back();
+			objs.pop_back();
+			seal_object_fields(o);
+			++sealed_objs;
+			bytes += sizeof(Object);
+		} else {
+			Environment *e = envs.back();
+			envs.pop_back();
+			seal_environment_fields(e);
+			++sealed_envs;
+			bytes += e->AllocatedSize();
+		}
+	}
+
+	// Move the permanent environments out of the swept list.
+	Reachable **x = &env_list_;
+	while (*x) {
+		Reachable *e = *x;
+		if (e->IsPermanent()) {
+			*x = e->next_;
+			e->next_ = perm_env_list_;
+			perm_env_list_ = e;
+		} else {
+			x = &e->next_;
+		}
+	}
+	stats_.permanent_objects += sealed_objs;
+	stats_.permanent_envs += sealed_envs;
+	stats_.permanent_bytes += bytes;
+}
+
+void ObjectManagement::MinorGc(vm::Local<Object> *local,
+		vm::Local<Environment> *env) {
+	DCHECK_EQ(kPause, gc_state_);
+	auto start = std::chrono::steady_clock::now();
+	size_t allocated = allocated_;
+	size_t young = young_allocated_;
+
+	MarkYoungEnvironment(gc_root_);
+	for (auto k : constant_)
+		MarkYoungObject(k);
+	for (auto root : roots_) {
+		if (*root)
+			MarkYoungObject(*root);
+	}
+	// The unchanged bottom of stacks only refer to the promoted ones, so a
+	// deep recursion be not rescanned by every minor gc.
+	local->ForEachFrom(local->Unchanged(), [this] (Object *val) {
+		if (val)
+			MarkYoungObject(val);
+	});
+	local->MarkUnchanged();
+	if (stack_scanner_)
+		MarkStackRoots(true);
+	env->ForEachFrom(env->Unchanged(), [this] (Environment *val) {
+		MarkYoungEnvironment(val);
+	});
+	env->MarkUnchanged();
+
+	// Old ones be stored young ones after last minor gc.
+	for (auto o : remembered_obj_) {
+		o->remembered_ = false;
+		ScanYoungObject(o);
+	}
+	remembered_obj_.clear();
+	for (auto e : remembered_env_) {
+		e->remembered_ = false;
+		ScanYoungEnvironment(e);
+	}
+	remembered_env_.clear();
+	for (auto o : perm_remembered_obj_)
+		ScanYoungObject(o);
+	for (auto e : perm_remembered_env_)
+		ScanYoungEnvironment(e);
+
+	for (;;) {
+		if (!gray_obj_.Empty()) {
+			Object *o = gray_obj_.Pop();
+			o->ToBlack();
+			ScanYoungObject(o);
+		} else if (!gray_env_.Empty()) {
+			Environment *e = gray_env_.Pop();
+			e->ToBlack();
+			ScanYoungEnvironment(e);
+		} else if (!RefillGray()) {
+			break;
+		}
+	}
+	SweepYoung();
+
+	++stats_.minor_cycles;
+	stats_.minor_bytes_freed += allocated - allocated_;
+	stats_.promoted_bytes += young - (allocated - allocated_);
+	stats_.minor.Record(ElapsedNanoseconds(start));
+}
+
+void ObjectManagement::Remember(Object *holder) {
+	if (holder->remembered_)
+		return;
+	holder->remembered_ = true;
+	remembered_obj_.push_back(holder);
+}
+
+void ObjectManagement::Remember(Environment *holder) {
+	if (holder->remembered_)
+		return;
+	holder->remembered_ = true;
+	remembered_env_.push_back(holder);
+}
+
+void ObjectManagement::RememberPermanent(Object *holder) {
+	if (holder->remembered_)
+		return;
+	holder->remembered_ = true;
+	perm_remembered_obj_.push_back(holder);
+}
+
+void ObjectManagement::RememberPermanent(Environment *holder) {
+	if (holder->remembered_)
+		return;
+	holder->remembered_ = true;
+	perm_remembered_env_.push_back(holder);
+}
+
+void ObjectManagement::MarkYoungObject(Object *o) {
+	if (Object::IsImmediate(o) || o->IsOld() || !o->TestWhite(white_flag_))
+		return;
+	if (Object::IsPair(o) || Object::IsClosure(o) ||
+			Object::IsContinuation(o)) {
+		o->ToGray();
+		gray_obj_.Push(o);
+	} else {
+		o->ToBlack();
+	}
+}
+
+void ObjectManagement::MarkYoungEnvironment(Environment *env) {
+	if (env->IsOld() || !env->TestWhite(white_flag_))
+		return;
+	env->ToGray();
+	gray_env_.Push(env);
+}
+
+void ObjectManagement::ScanYoungObject(Object *o) {
+	switch (Object::TypeOf(o)) {
+	case CLOSURE:
+		MarkYoungObject(o->Params());
+		MarkYoungObject(o->Body());
+		MarkYoungObject(o->Expanded());
+		MarkYoungEnvironment(o->Environment());
+		break;
+	case PAIR:
+		MarkYoungObject(car(o));
+		MarkYoungObject(cdr(o));
+		break;
+	case CONTINUATION:
+		o->Continuation()->ForEach([this] (Object *val) {
+			MarkYoungObject(val);
+		}, [this] (Environment *val) {
+			MarkYoungEnvironment(val);
+		});
+		break;
+	default:
+		break;
+	}
+}
+
+void ObjectManagement::ScanYoungEnvironment(Environment *env) {
+	if (env->Next())
+		MarkYoungEnvironment(env->Next());
+	if (env->Closure())
+		MarkYoungObject(env->Closure());
+	for (size_t i = 0; i < env->Count(); ++i)
+		MarkYoungObject(env->At(i));
+	for (auto entry : env->Entries()) {
+		DCHECK(symbol_.find(entry.first) != symbol_.end());
+		MarkYoungObject(symbol_[entry.first]);
+	}
+}
+
+void ObjectManagement::SweepYoung() {
+	Reachable *x, *next;
+	for (x = young_env_list_; x; x = next) {
+		next = x->next_;
+		if (x->IsBlack()) {
+			x->ToWhite(white_flag_);
+			x->old_ = true;
+			x->next_ = env_list_;
+			env_list_ = x;
+		} else {
+			allocated_ -= static_cast<Environment*>(x)->AllocatedSize();
+			CollectEnvironment(static_cast<Environment*>(x));
+			++stats_.minor_envs_freed;
+		}
+	}
+	young_env_list_ = nullptr;
+	for (auto page : space_->YoungPages()) {
+		for (Object *o = page->Begin(); o != page->End(); ++o) {
+			if (ObjectSpace::IsFree(o) || o->IsOld())
+				continue;
+			if (o->IsBlack()) {
+				o->ToWhite(white_flag_);
+				o->old_ = true;
+			} else {
+				CollectObject(o);
+				++stats_.minor_objects_freed;
+			}
+		}
+	}
+	space_->ClearYoungPages();
+	young_allocated_ = 0;
+}
+
+void ObjectManagement::MarkRoots(vm::Local<Object> *local,
+		vm::Local<Environment> *env) {
+	MarkEnvironment(gc_root_);
+	for (auto k : constant_)
+		MarkObject(k);
+	for (auto root : roots_) {
+		if (*root)
+			MarkObject(*root);
+	}
+	local->ForEach([this] (Object *val) {
+		if (val)
+			MarkObject(val);
+	});
+	if (stack_scanner_)
+		MarkStackRoots(false);
+	env->ForEach([this] (Environment *val) {
+		MarkEnvironment(val);
+	});
+	for (auto o : perm_remembered_obj_)
+		MarkFields(o);
+	for (auto e : perm_remembered_env_)
+		MarkFields(e);
 }
 
 void ObjectManagement::MarkObject(Object *o) {
-tailcall:
-	switch (o->OwnedType()) {
+	// Immediate value is not in heap.
+	if (Object::IsImmediate(o) || o->IsPermanent() || !ObjectSpace::Mark(o))
+		return;
+	switch (Object::TypeOf(o)) {
 	case BOOLEAN:
-		// Skip boolean type, beasure it's constant.
+	case CHARACTER:
+		DLOG(FATAL) << "No reached!";
 		break;
 	case SYMBOL:
 	case FIXED:
 	case REAL:
-	case CHARACTER:
-		Mark(o);
+	case PRIMITIVE:
 		break;
 	case STRING:
-		Mark(o);
 		Mark(o->String());
 		break;
-	case PRIMITIVE:
-		Mark(o);
+	case CLOSURE:
+	case PAIR:
+	case CONTINUATION:
+		if (!gray_obj_.Push(o))
+			ObjectSpace::AtomicMarkGray(o);
 		break;
+	}
+}
+
+void ObjectManagement::MarkStackRoots(bool young) {
+	// No page is swept by the sweeper thread in major gc, but it may be
+	// in minor gc: only the young pages be owned by mutator.
+	DCHECK(young || !sweeper_ || !sweeper_->Sweeping());
+	DCHECK(young || !space_->Sweeping());
+	stack_scanner_->Scan([this, young] (uintptr_t word) {
+		Object *o = space_->FindSlot(word);
+		if (!o || (young && !ObjectSpace::PageOf(o)->young) ||
+				ObjectSpace::IsFree(o))
+			return;
+		++stats_.stack_roots;
+		if (young)
+			MarkYoungObject(o);
+		else
+			MarkObject(o);
+	});
+}
+
+bool ObjectManagement::IsScanned(Object *o) const {
+	return ObjectSpace::IsMarked(o);
+}
+
+bool ObjectManagement::IsScanned(Environment *env) const {
+	return env->IsBlack();
+}
+
+void ObjectManagement::MarkEnvironment(Environment *env) {
+	if (!ShouldMark(env))
+		return;
+	env->ToGray();
+	gray_env_.Push(env);
+}
+
+bool ObjectManagement::Propagate(size_t quantum) {
+	size_t work = 0;
+	while (work < quantum) {
+		if (!gray_obj_.Empty()) {
+			work += ScanObject(gray_obj_.Pop());
+		} else if (!gray_env_.Empty()) {
+			work += ScanEnvironment(gray_env_.Pop());
+		} else if (!RefillGray()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ObjectManagement::RefillGray() {
+	if (!gray_obj_.Overflowed() && !gray_env_.Overflowed())
+		return false;
+	gray_obj_.ClearOverflowed();
+	gray_env_.ClearOverflowed();
+	FindGray();
+	return !gray_obj_.Empty() || !gray_env_.Empty();
+}
+
+void ObjectManagement::FindGray() {
+	if (gc_state_ == kPause) {
+		// In minor gc only young ones are gray, and the old pages may be
+		// in sweeping by the sweeper thread. The young pages are not, their
+		// slots are taken after sweeping.
+		for (auto page : space_->YoungPages()) {
+			for (Object *o = page->Begin(); o != page->End(); ++o) {
+				if (!ObjectSpace::IsFree(o) && o->IsGray() &&
+						!gray_obj_.Push(o))
+					break;
+			}
+		}
+		for (Reachable *x = young_env_list_; x; x = x->next_) {
+			if (x->IsGray() && !gray_env_.Push(static_cast<Environment*>(x)))
+				break;
+		}
+		return;
+	}
+	for (auto page = space_->Pages(); page; page = page->next) {
+		if (!ObjectSpace::FindGray(page, &gray_obj_))
+			break; // Overflowed again, refill it at next time.
+	}
+	for (auto list : { env_list_, young_env_list_ }) {
+		for (Reachable *x = list; x; x = x->next_) {
+			if (x->IsGray() && !gray_env_.Push(static_cast<Environment*>(x)))
+				break;
+		}
+	}
+}
+
+void ObjectManagement::ParallelPropagate() {
+	while (marker_->Mark(&gray_obj_, &gray_env_, white_flag_))
+		FindGray(); // Some gray ones be dropped by overflow.
+}
+
+size_t ObjectManagement::ScanObject(Object *o) {
+	DCHECK(ObjectSpace::IsMarked(o));
+	MarkFields(o);
+	return 1;
+}
+
+void ObjectManagement::MarkFields(Object *o) {
+	switch (Object::TypeOf(o)) {
 	case CLOSURE:
-		Mark(o);
 		MarkObject(o->Params());
 		MarkObject(o->Body());
+		MarkObject(o->Expanded());
 		MarkEnvironment(o->Environment());
 		break;
 	case PAIR:
-		if (o != Constant(kEmptyList)) {
-			Mark(o);
-			MarkObject(car(o));
-			//MarkObject(cdr(o));
-			o = cdr(o);
-			goto tailcall;
-		}
+		MarkObject(car(o));
+		MarkObject(cdr(o));
+		break;
+	case CONTINUATION:
+		o->Continuation()->ForEach([this] (Object *val) {
+			MarkObject(val);
+		}, [this] (Environment *val) {
+			MarkEnvironment(val);
+		});
+		break;
+	default:
+		DLOG(FATAL) << "No reached!";
 		break;
 	}
 }
 
-void ObjectManagement::MarkEnvironment(Environment *env) {
-tailcall:
-	if (ShouldMark(env)) {
-		env->ToBlack();
-		for (auto entry : env->Entries()) {
-			DCHECK(symbol_.find(entry.first) != symbol_.end())
-					<< "Symbol table has not: "
-					<< entry.first
-					<< " for mark!";
-			MarkObject(symbol_[entry.first]);
-			MarkObject(env->At(entry.second));
-		}
+size_t ObjectManagement::ScanEnvironment(Environment *env) {
+	DCHECK(env->IsGray());
+	env->ToBlack();
+	MarkFields(env);
+	return 1 + env->Count();
+}
+
+void ObjectManagement::MarkFields(Environment *env) {
+	if (env->Next())
+		MarkEnvironment(env->Next());
+	// Names of slots are kept by the closure.
+	if (env->Closure())
+		MarkObject(env->Closure());
+	for (size_t i = 0; i < env->Count(); ++i)
+		MarkObject(env->At(i));
+	for (auto entry : env->Entries()) {
+		DCHECK(symbol_.find(entry.first) != symbol_.end())
+				<< "Symbol table has not: "
+				<< entry.first
+				<< " for mark!";
+		MarkObject(symbol_[entry.first]);
 	}
-	env = env->Next();
-	if (env) goto tailcall;
 }
 
-void ObjectManagement::SweepEnvironment() {
-	int sweeped = 0;
-	Reachable *x = env_list_;
-	Reachable dummy(x, white_flag_), *p = &dummy;
-	while (x) {
+bool ObjectManagement::SweepEnvironment(size_t quantum) {
+	while (quantum-- && *sweep_cursor_) {
+		Reachable *x = *sweep_cursor_;
 		if (x->TestInvWhite(white_flag_)) {
 			// Environment collection:
-			p->next_ = x->next_;
-			delete static_cast<Environment*>(x);
-			allocated_ -= sizeof(Environment);
-			++sweeped;
-			x = p->next_;
-		} else {
-			x->ToWhite(white_flag_);
-			p = x;
-			x = x->next_;
-		}
-	}
-	env_list_ = dummy.next_;
-}
-
-void ObjectManagement::SweepObject() {
-	int sweeped = 0;
-	Reachable *x = obj_list_;
-	Reachable dummy(x, white_flag_), *p = &dummy;
-	while (x) {
-		Object *o = static_cast<Object*>(x);
-		if (o->TestInvWhite(white_flag_) &&
-				!o->IsBoolean() && !Null(o)) {
-			p->next_ = x->next_;
-			CollectObject(o);
-			++sweeped;
-			x = p->next_;
+			size_t size = static_cast<Environment*>(x)->AllocatedSize();
+			*sweep_cursor_ = x->next_;
+			allocated_ -= size;
+			CollectEnvironment(static_cast<Environment*>(x));
+			++stats_.envs_swept;
+			stats_.env_bytes_swept += size;
 		} else {
 			x->ToWhite(white_flag_);
-			p = x;
-			x = x->next_;
+			sweep_cursor_ = &x->next_;
 		}
 	}
-	obj_list_ = dummy.next_;
+	return *sweep_cursor_ == nullptr;
+}
+
+void ObjectManagement::SweepObjectPage() {
+	ObjectSpace::Page *page = DCHECK_NOTNULL(space_->NextUnswept());
+	DCHECK(page->marking);
+	ObjectSpace::ForEachUnmarked(page, [this] (Object *o) {
+		if (ObjectSpace::IsFree(o) || o->IsPermanent())
+			return;
+		CollectObject(o);
+		++stats_.objects_swept;
+		stats_.object_bytes_swept += sizeof(Object);
+	});
+	ObjectSpace::ClearMarks(page);
+	++stats_.pages_swept;
+	if (!space_->Sweeping())
+		gc_threshold_ = PaceThreshold(Allocated());
 }
 
 void ObjectManagement::CollectObject(Object *o) {
-	if (o->IsSymbol()) {
+	if (Object::IsSymbol(o)) {
 		DCHECK(symbol_.find(o->Symbol()) != symbol_.end());
 		symbol_.erase(o->Symbol());
 	}
 	allocated_ -= sizeof(*o);
-	delete o;
+	o->~Object();
+	space_->Free(o);
+}
+
+void ObjectManagement::CollectEnvironment(Environment *env) {
+	size_t size = env->AllocatedSize();
+	env->~Environment();
+	heap_->Free(env, size);
 }
 
 } // namespace values
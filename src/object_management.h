@@ -2,23 +2,50 @@
 #define AJIMU_VALUES_OBJECT_MANAGEMENT_H
 
 #include "object.h"
+#include "mark_stack.h"
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 #include <memory>
 
 namespace ajimu {
 namespace vm {
 class Environment;
+struct Continuation;
 template<class T>
 class Local;
 } // namespace vm
 namespace values {
 class StringPool;
+class Heap;
+class ObjectSpace;
+class ParallelMarker;
+class Sweeper;
+class StackScanner;
 
 //
-// Default gc threshold size: 10k bytes
+// Default gc pacing: The next major gc starts when the heap grows to
+// live bytes * growth, but not less than min heap and not more than
+// max heap.
 //
-#define DEFAULT_GC_THRESHOLD (10 * 1024)
+#define DEFAULT_GC_GROWTH   2.0
+#define DEFAULT_GC_MIN_HEAP (1024 * 1024)
+#define DEFAULT_GC_MAX_HEAP (1024 * 1024 * 1024)
+
+//
+// Default gc work quantum: objects be scanned or swept per GcTick
+//
+#define DEFAULT_GC_QUANTUM 256
+
+//
+// Default young generation size: 256k bytes be allocated between two
+// minor gc.
+//
+#define DEFAULT_GC_NURSERY (256 * 1024)
+
+//
+// Default marking threads: Marking is incremental in the mutator thread.
+//
+#define DEFAULT_GC_THREADS 1
 
 enum Constants {
 	kFalse,
@@ -57,6 +84,68 @@ public:
 		kMaxState,
 	};
 
+	//
+	// GC telemetry, all counters are cumulative.
+	//
+	struct Stats {
+		enum {
+			// Bucket i counts pauses in [2^(i-1), 2^i) us, bucket 0 is
+			// less than 1 us, and the last one has no upper bound.
+			kHistogramSize = 20,
+		};
+
+		// Ticks did work in one phase
+		struct Phase {
+			size_t ticks;
+			size_t time_ns;
+			size_t max_ns;
+			size_t histogram[kHistogramSize];
+
+			void Record(size_t ns) {
+				++ticks;
+				time_ns += ns;
+				if (ns > max_ns)
+					max_ns = ns;
+				size_t us = ns / 1000;
+				int i = 0;
+				while (us && i < kHistogramSize - 1) {
+					us >>= 1;
+					++i;
+				}
+				++histogram[i];
+			}
+		};
+
+		size_t major_cycles;
+		size_t minor_cycles;
+
+		// Major gc sweeping
+		size_t pages_swept;
+		size_t objects_swept;
+		size_t object_bytes_swept;
+		size_t envs_swept;
+		size_t env_bytes_swept;
+		size_t strings_swept;
+		size_t string_bytes_swept;
+
+		// Minor gc
+		size_t minor_objects_freed;
+		size_t minor_envs_freed;
+		size_t minor_bytes_freed;
+		size_t promoted_bytes;
+
+		// Sealed to the permanent region
+		size_t permanent_objects;
+		size_t permanent_envs;
+		size_t permanent_bytes;
+
+		// Objects be found in native stack by conservative scanning
+		size_t stack_roots;
+
+		Phase phase[kMaxState];
+		Phase minor;
+	};
+
 	ObjectManagement();
 
 	~ObjectManagement();
@@ -72,13 +161,148 @@ public:
 		return gc_threshold_;
 	}
 
+	// Start a major gc when allocated size reach threshold, it will be
+	// paced again at the end of the major gc.
+	void SetThreshold(size_t threshold) {
+		gc_threshold_ = threshold;
+	}
+
+	double GcGrowth() const {
+		return gc_growth_;
+	}
+
+	void SetGcGrowth(double growth);
+
+	size_t GcMinHeap() const {
+		return gc_min_heap_;
+	}
+
+	void SetGcMinHeap(size_t bytes);
+
+	size_t GcMaxHeap() const {
+		return gc_max_heap_;
+	}
+
+	void SetGcMaxHeap(size_t bytes);
+
+	// Threshold of next major gc, after live bytes survived.
+	size_t PaceThreshold(size_t live) const;
+
 	int GcState() const {
 		return gc_state_;
 	}
 
+	size_t GcQuantum() const {
+		return gc_quantum_;
+	}
+
+	void SetGcQuantum(size_t quantum) {
+		DCHECK_GT(quantum, 0U);
+		gc_quantum_ = quantum;
+	}
+
+	size_t GcNursery() const {
+		return gc_nursery_;
+	}
+
+	void SetGcNursery(size_t nursery) {
+		gc_nursery_ = nursery;
+	}
+
+	// Sweep all unswept object pages now, the lazy or background sweeping
+	// be finished.
+	void FinishSweeping();
+
+	// Entries limit of the mark stacks, the gray ones be dropped by
+	// overflow are found by scanning the heap.
+	void SetMarkStackLimit(size_t limit);
+
+	int GcThreads() const {
+		return gc_threads_;
+	}
+
+	// More than one thread: The marking is not incremental, it's done in
+	// one step by the threads.
+	void SetGcThreads(int threads);
+
+	bool GcConcurrentSweep() const {
+		return gc_concurrent_sweep_;
+	}
+
+	// Sweep objects and environments by a background thread, it takes
+	// effect from the next major gc.
+	void SetGcConcurrentSweep(bool on) {
+		gc_concurrent_sweep_ = on;
+	}
+
+	bool GcConservative() const {
+		return static_cast<bool>(stack_scanner_);
+	}
+
+	// Scan the native stack of current thread for roots, the objects be
+	// held by C++ locals are reachable without pushing to local. The
+	// environments must be still pushed.
+	void SetGcConservative(bool on);
+
+	// The slot out of local be a root of gc, it may be nullptr.
+	void AddRoot(Object **root) {
+		roots_.push_back(root);
+	}
+
+	// Allocated bytes of young objects and environments
+	size_t YoungAllocated() const {
+		return young_allocated_;
+	}
+
+	const Stats &GcStats() const {
+		return stats_;
+	}
+
+	// Do one step of gc, the work of step is bounded by quantum, except
+	// the last step of marking, it rescans the stacks.
+	// A minor gc be done first if the young generation is full.
+	// local: The values stack, roots of gc
+	// env:   The environments stack, roots of gc
 	void GcTick(vm::Local<Object> *local,
 			vm::Local<vm::Environment> *env);
 
+	// Collect the young generation, and promote the survivors to old.
+	// Only can be done in kPause state.
+	void MinorGc(vm::Local<Object> *local,
+			vm::Local<vm::Environment> *env);
+
+	// Seal the heap at the next tick: Everything reachable from the
+	// global environment and the constants becomes permanent. They are
+	// never marked or swept again.
+	void RequestSeal() {
+		seal_requested_ = true;
+	}
+
+	// Finish the current cycle, and seal the heap now.
+	void Seal(vm::Local<Object> *local, vm::Local<vm::Environment> *env);
+
+	// Must be called after storing val to a field of holder, the holder
+	// is an Object or a vm::Environment.
+	// In marking, the black holder must not point to a white object.
+	// Out of marking, the old holder points to young object must be
+	// remembered for minor gc.
+	// The permanent holder points to others is a root of all gc, it's
+	// remembered until next sealing.
+	template<class T>
+	void WriteBarrier(T *holder, Object *val) {
+		if (!Object::IsHeapObject(val))
+			return;
+		if (holder->IsPermanent()) {
+			if (!val->IsPermanent())
+				RememberPermanent(holder);
+		} else if (gc_state_ == kPropagate) {
+			if (IsScanned(holder))
+				MarkObject(val);
+		} else if (holder->IsOld() && !val->IsOld()) {
+			Remember(holder);
+		}
+	}
+
 	//
 	// For Environment allocating:
 	//
@@ -86,6 +310,11 @@ public:
 
 	vm::Environment *NewEnvironment(vm::Environment *top);
 
+	// New frame for calling the closure, the slots are not initialized.
+	// names: Names of slots, owned by the lambda or its code.
+	vm::Environment *NewFrame(Object *closure,
+			const std::vector<Object*> *names);
+
 	vm::Environment *TEST_NewEnvironment(vm::Environment *top);
 
 	Object *Constant(Constants i) const;
@@ -98,7 +327,9 @@ public:
 	// New objects:
 	//
 	Object *NewFixed(long long value) {
-		Object *o = AllocateObject(FIXED);
+		if (Object::FitsFixed(value))
+			return Object::MakeFixed(value);
+		Object *o = AllocateObject(FIXED); // Boxed
 		o->fixed_ = value;
 		return o;
 	}
@@ -110,43 +341,47 @@ public:
 	}
 
 	Object *NewBoolean(bool value) {
-		Object *o = AllocateObject(BOOLEAN);
-		o->boolean_ = value;
-		return o;
+		return Object::MakeBoolean(value);
 	}
 
 	Object *NewCharacter(char value) {
-		Object *o = AllocateObject(CHARACTER);
-		o->character_ = value;
-		return o;
+		return Object::MakeCharacter(value);
 	}
 
 	Object *NewSymbol(const std::string &raw);
 
 	Object *NewString(const char *raw, size_t len);
 
-	Object *NewClosure(Object *params, Object *body,
-			vm::Environment *env);
+	Object *NewClosure(vm::Lambda *lambda, vm::Environment *env);
+
+	// Take the ownership of cont.
+	Object *NewContinuation(vm::Continuation *cont);
 
-	Object *NewPrimitive(const std::string &name,
-			PrimitiveMethodPtr method);
+	// Define the primitive proc in global environment.
+	Object *NewPrimitive(const PrimitiveProc *proc);
 
 	Object *Cons(Object *car, Object *cdr) {
+		car = ToStorable(car);
+		cdr = ToStorable(cdr);
 		Object *o = AllocateObject(PAIR);
-		o->pair_.car = car;
-		o->pair_.cdr = cdr;
+		o->pair_.car = Object::ToRef(car);
+		o->pair_.cdr = Object::ToRef(cdr);
 		return o;
 	}
 
-	static Object *SetCar(Object *node, Object *car) {
-		DCHECK(node->IsPair());
-		node->pair_.car = DCHECK_NOTNULL(car);
+	Object *SetCar(Object *node, Object *car) {
+		DCHECK(Object::IsPair(node));
+		car = ToStorable(DCHECK_NOTNULL(car));
+		node->pair_.car = Object::ToRef(car);
+		WriteBarrier(node, car);
 		return node;
 	}
 
-	static Object *SetCdr(Object *node, Object *cdr) {
-		DCHECK(node->IsPair());
-		node->pair_.cdr = DCHECK_NOTNULL(cdr);
+	Object *SetCdr(Object *node, Object *cdr) {
+		DCHECK(Object::IsPair(node));
+		cdr = ToStorable(DCHECK_NOTNULL(cdr));
+		node->pair_.cdr = Object::ToRef(cdr);
+		WriteBarrier(node, cdr);
 		return node;
 	}
 
@@ -156,30 +391,129 @@ private:
 
 	Object *AllocateObject(Type type);
 
+	// Box the tagged fixed number out of range of compressed ref.
+	Object *ToStorable(Object *val) {
+		if (Object::FitsRef(val))
+			return val;
+		Object *o = AllocateObject(FIXED);
+		o->fixed_ = Object::Fixed(val);
+		return o;
+	}
+
+	// The free list of object space is empty: sweep unswept pages until
+	// a slot be freed, or add a new page.
+	void *AllocateObjectSlow();
+
+	void MarkRoots(vm::Local<Object> *local,
+			vm::Local<vm::Environment> *env);
+
+	// Link the new environment to the list of its generation.
+	void LinkEnvironment(vm::Environment *env, size_t size);
+
+	void Remember(Object *holder);
+
+	void Remember(vm::Environment *holder);
+
+	void RememberPermanent(Object *holder);
+
+	void RememberPermanent(vm::Environment *holder);
+
+	// For minor gc: Mark the young one to black, the old one be ignored.
+	void MarkYoungObject(Object *o);
+
+	void MarkYoungEnvironment(vm::Environment *env);
+
+	void ScanYoungObject(Object *o);
+
+	void ScanYoungEnvironment(vm::Environment *env);
+
+	// Promote the marked young ones to old, collect others.
+	void SweepYoung();
+
+	// Shade the object: leaf to black, others to gray.
 	void MarkObject(Object *o);
 
+	// Mark the objects be pointed by words of native stack.
+	// young: For minor gc, only the young ones in young pages.
+	void MarkStackRoots(bool young);
+
 	void MarkEnvironment(vm::Environment *env);
 
-	void SweepEnvironment();
+	// Scan gray objects until quantum be used up.
+	// Returns true if no more gray object.
+	bool Propagate(size_t quantum);
+
+	// Find the gray ones be dropped by the overflowed mark stack, they
+	// are still in the object pages and environment lists.
+	// Returns false if no more gray one.
+	bool RefillGray();
+
+	// Push the gray ones in the heap to the mark stacks.
+	void FindGray();
+
+	// Scan all gray ones by the marker threads.
+	void ParallelPropagate();
+
+	size_t ScanObject(Object *o);
+
+	size_t ScanEnvironment(vm::Environment *env);
 
-	void SweepObject();
+	// Mark the children, for scanning or the permanent holders.
+	void MarkFields(Object *o);
+
+	void MarkFields(vm::Environment *env);
+
+	// Returns true if sweeping be finished.
+	bool SweepEnvironment(size_t quantum);
+
+	// Sweep the next unswept page of object space, and pace the threshold
+	// again if it is the last one.
+	void SweepObjectPage();
+
+	// Take the results of the sweeper thread.
+	// wait: Wait for the end of sweeping.
+	// Returns true if the sweeping be finished.
+	bool ReclaimSwept(bool wait);
+
+	// Drop the dead symbols from the table before background sweeping,
+	// the sweeper destroys them.
+	void SweepSymbols();
 
 	void CollectObject(Object *o);
 
-	bool ShouldMark(const Reachable *o) {
-		return !o->IsBlack() && !o->TestWhite(white_flag_);
+	void CollectEnvironment(vm::Environment *env);
+
+	// The holder may be scanned in marking. The marked objects are black
+	// or gray, they are not known by the bitmaps.
+	bool IsScanned(Object *o) const;
+
+	bool IsScanned(vm::Environment *env) const;
+
+	// Only the ones of last white are not marked, the ones be allocated
+	// in this cycle have current white.
+	bool ShouldMark(const GcHeader *o) {
+		return o->TestInvWhite(white_flag_);
 	}
 
-	void Mark(Reachable *o) {
+	void Mark(GcHeader *o) {
 		if (ShouldMark(o)) o->ToBlack();
 	}
 
 	// All constants
 	Object *constant_[kMax];
 
+	// Slots of roots out of local
+	std::vector<Object**> roots_;
+
 	// Symbol table
 	std::unordered_map<std::string, Object*> symbol_;
 
+	// Chunks of environments and strings
+	std::unique_ptr<Heap> heap_;
+
+	// Pages of objects, swept lazily
+	std::unique_ptr<ObjectSpace> space_;
+
 	// String factory
 	std::unique_ptr<StringPool> pool_;
 
@@ -188,15 +522,52 @@ private:
 	int gc_state_;             // Current gc state
 	unsigned white_flag_;
 	size_t gc_threshold_;
+	double gc_growth_;
+	size_t gc_min_heap_;
+	size_t gc_max_heap_;
+	size_t gc_quantum_;
+	size_t gc_nursery_;
+	int gc_threads_;
+	bool gc_concurrent_sweep_;
+	bool seal_requested_;
 	size_t allocated_;
+	size_t young_allocated_;
+	Stats stats_;
+
+	// Gray objects be waiting for scanning
+	MarkStack<Object*> gray_obj_;
+	MarkStack<vm::Environment*> gray_env_;
 
-	// Object in gc
-	Reachable *obj_list_;
+	// Marking by threads, nullptr if gc_threads_ is 1
+	std::unique_ptr<ParallelMarker> marker_;
+
+	// Sweeping in background, nullptr if not concurrent
+	std::unique_ptr<Sweeper> sweeper_;
+
+	// Conservative roots, nullptr if not scanning native stack
+	std::unique_ptr<StackScanner> stack_scanner_;
+
+	// Position of incremental sweeping
+	Reachable **sweep_cursor_;
+	int sweep_string_cursor_;
 
 	// Environment in gc
 	Reachable *env_list_;
 
-	std::unordered_set<void*> freed_;
+	// Young environments, be allocated after last minor gc. The young
+	// objects are found by the young pages of space.
+	Reachable *young_env_list_;
+
+	// Old ones point to young ones
+	std::vector<Object*> remembered_obj_;
+	std::vector<vm::Environment*> remembered_env_;
+
+	// Permanent environments, not be swept
+	Reachable *perm_env_list_;
+
+	// Permanent ones point to not permanent ones
+	std::vector<Object*> perm_remembered_obj_;
+	std::vector<vm::Environment*> perm_remembered_env_;
 }; // class ObjectManagement
 
 } // namespace values
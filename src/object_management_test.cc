@@ -1,5 +1,9 @@
 #include "object_management.h"
+#include "object_space.h"
+#include "environment.h"
+#include "local.h"
 #include "gmock/gmock.h"
+#include <limits.h>
 
 namespace ajimu {
 namespace values {
@@ -18,30 +22,52 @@ protected:
 		obm_ = nullptr;
 	}
 
+	// Tick until current gc cycle be finished, and sweep all the object
+	// pages.
+	void FinishCycle() {
+		while (obm_->GcState() != ObjectManagement::kPause)
+			obm_->GcTick(&local_, &env_);
+		obm_->FinishSweeping();
+	}
+
+	// Start a major gc cycle at next tick.
+	void StartCycle() {
+		obm_->SetThreshold(0);
+		obm_->GcTick(&local_, &env_);
+	}
+
+	void RunCycle() {
+		StartCycle();
+		ASSERT_EQ(ObjectManagement::kPropagate, obm_->GcState());
+		FinishCycle();
+	}
+
 	ObjectManagement *obm_;
+	vm::Local<Object> local_;
+	vm::Local<Environment> env_;
 };
 
 TEST_F(ObjectManagementTest, Sanity) {
 	Object *ob1 = obm_->NewFixed(0);
-	ASSERT_EQ(FIXED, ob1->OwnedType());
-	ASSERT_EQ(0LL, ob1->Fixed());
+	ASSERT_EQ(FIXED, Object::TypeOf(ob1));
+	ASSERT_EQ(0LL, Object::Fixed(ob1));
 
 	Object *ob2 = obm_->NewFixed(65535);
-	ASSERT_EQ(FIXED, ob2->OwnedType());
-	ASSERT_EQ(65535LL, ob2->Fixed());
+	ASSERT_EQ(FIXED, Object::TypeOf(ob2));
+	ASSERT_EQ(65535LL, Object::Fixed(ob2));
 
 	Object *pair = obm_->Cons(ob1, ob2);
-	ASSERT_EQ(PAIR, pair->OwnedType());
+	ASSERT_EQ(PAIR, Object::TypeOf(pair));
 	ASSERT_EQ(ob1, pair->Car());
 	ASSERT_EQ(ob2, pair->Cdr());
 
 	Object *ob3 = obm_->NewBoolean(false);
-	ASSERT_EQ(BOOLEAN, ob3->OwnedType());
-	ASSERT_FALSE(ob3->Boolean());
+	ASSERT_EQ(BOOLEAN, Object::TypeOf(ob3));
+	ASSERT_FALSE(Object::Boolean(ob3));
 
 	Object *ob4 = obm_->NewBoolean(true);
-	ASSERT_EQ(BOOLEAN, ob4->OwnedType());
-	ASSERT_TRUE(ob4->Boolean());
+	ASSERT_EQ(BOOLEAN, Object::TypeOf(ob4));
+	ASSERT_TRUE(Object::Boolean(ob4));
 }
 
 TEST_F(ObjectManagementTest, Symbol) {
@@ -72,6 +98,22 @@ TEST_F(ObjectManagementTest, CollectEnvironment) {
 	}
 }
 
+TEST_F(ObjectManagementTest, Immediate) {
+	size_t allocated = obm_->Allocated();
+	Object *o = obm_->NewFixed(10000);
+	ASSERT_TRUE(Object::IsImmediate(o));
+	ASSERT_TRUE(Object::IsImmediate(obm_->NewCharacter('a')));
+	ASSERT_EQ(obm_->Constant(kTrue), obm_->NewBoolean(true));
+	ASSERT_EQ(allocated, obm_->Allocated());
+
+	// Out of range, boxed in heap
+	o = obm_->NewFixed(LLONG_MAX);
+	ASSERT_TRUE(Object::IsHeapObject(o));
+	ASSERT_TRUE(Object::IsFixed(o));
+	ASSERT_EQ(LLONG_MAX, Object::Fixed(o));
+	ASSERT_LT(allocated, obm_->Allocated());
+}
+
 TEST_F(ObjectManagementTest, CollectObject) {
 	int i = 10000;
 	while (i--) {
@@ -80,6 +122,435 @@ TEST_F(ObjectManagementTest, CollectObject) {
 	}
 }
 
+TEST_F(ObjectManagementTest, Pacer) {
+	obm_->SetGcGrowth(2.0);
+	obm_->SetGcMinHeap(1024);
+	obm_->SetGcMaxHeap(1024 * 1024);
+	ASSERT_EQ(1024U, obm_->PaceThreshold(0));
+	ASSERT_EQ(8000U, obm_->PaceThreshold(4000));
+	ASSERT_EQ(1024U * 1024U, obm_->PaceThreshold(1024 * 1024));
+
+	obm_->SetGcGrowth(1.5);
+	ASSERT_EQ(6000U, obm_->PaceThreshold(4000));
+
+	// The max heap wins.
+	obm_->SetGcMinHeap(4096);
+	obm_->SetGcMaxHeap(2048);
+	ASSERT_EQ(2048U, obm_->PaceThreshold(0));
+
+	// Paced at the end of major gc.
+	obm_->SetGcMaxHeap(1024 * 1024);
+	RunCycle();
+	ASSERT_EQ(obm_->PaceThreshold(obm_->Allocated()), obm_->Threshold());
+}
+
+TEST_F(ObjectManagementTest, ImproperListToString) {
+	Object *o = obm_->Cons(obm_->NewSymbol("a"), obm_->NewFixed(1));
+	ASSERT_EQ("(a . 1)", Object::ToString(o, obm_));
+	o = obm_->Cons(obm_->NewFixed(0), o);
+	ASSERT_EQ("(0 a . 1)", Object::ToString(o, obm_));
+}
+
+TEST_F(ObjectManagementTest, Stats) {
+	for (int i = 0; i < 100; ++i)
+		obm_->NewFixed(LLONG_MAX);
+	RunCycle();
+	const ObjectManagement::Stats &stats = obm_->GcStats();
+	ASSERT_EQ(1U, stats.major_cycles);
+	ASSERT_EQ(1U, stats.minor_cycles);
+	ASSERT_LE(100U, stats.minor_objects_freed);
+	ASSERT_LE(100 * sizeof(Object), stats.minor_bytes_freed);
+	ASSERT_EQ(1U, stats.minor.ticks);
+	for (int i = 0; i < ObjectManagement::kMaxState; ++i)
+		ASSERT_LE(1U, stats.phase[i].ticks);
+
+	size_t sum = 0;
+	for (auto n : stats.phase[ObjectManagement::kPropagate].histogram)
+		sum += n;
+	ASSERT_EQ(stats.phase[ObjectManagement::kPropagate].ticks, sum);
+
+	// Not reachable after promoted, swept by major gc.
+	size_t promoted = stats.promoted_bytes;
+	Object *o = obm_->NewFixed(LLONG_MAX);
+	local_.Push(o);
+	obm_->MinorGc(&local_, &env_);
+	local_.Pop(1);
+	ASSERT_EQ(promoted + sizeof(Object), stats.promoted_bytes);
+	size_t swept = stats.objects_swept;
+	RunCycle();
+	ASSERT_EQ(swept + 1, stats.objects_swept);
+}
+
+TEST_F(ObjectManagementTest, IncrementalCycle) {
+	obm_->SetGcQuantum(8);
+	RunCycle();
+	size_t allocated = obm_->Allocated();
+
+	Object *list = obm_->Constant(kEmptyList);
+	for (int i = 0; i < 100; ++i)
+		list = obm_->Cons(obm_->NewFixed(LLONG_MAX - i), list);
+	local_.Push(list);
+
+	// Cons more nodes in marking, they must not be collected.
+	int n = 100;
+	StartCycle();
+	while (obm_->GcState() == ObjectManagement::kPropagate) {
+		list = obm_->Cons(obm_->NewFixed(LLONG_MAX - n++), local_.Last(0));
+		local_.Pop(1);
+		local_.Push(list);
+		obm_->GcTick(&local_, &env_);
+	}
+	FinishCycle();
+	ASSERT_EQ(allocated + n * 2 * sizeof(Object), obm_->Allocated());
+
+	for (Object *i = local_.Last(0); !obm_->Null(i); i = cdr(i))
+		ASSERT_EQ(LLONG_MAX - --n, Object::Fixed(car(i)));
+	ASSERT_EQ(0, n);
+	local_.Pop(1);
+}
+
+TEST_F(ObjectManagementTest, WriteBarrier) {
+	obm_->SetGcQuantum(1);
+	RunCycle();
+	size_t allocated = obm_->Allocated();
+
+	Object *pair = obm_->Cons(obm_->Constant(kEmptyList),
+			obm_->Constant(kEmptyList));
+	local_.Push(pair);
+	Object *val = obm_->NewFixed(LLONG_MAX);
+	local_.Push(val);
+	obm_->MinorGc(&local_, &env_);
+	local_.Pop(1); // Not reachable now
+
+	StartCycle();
+	obm_->GcTick(&local_, &env_);
+	ASSERT_EQ(ObjectManagement::kPropagate, obm_->GcState());
+	ASSERT_TRUE(ObjectSpace::IsMarked(pair));
+
+	// Black pair -> white val, the barrier must shade val.
+	obm_->SetCar(pair, val);
+	FinishCycle();
+	ASSERT_EQ(allocated + 2 * sizeof(Object), obm_->Allocated());
+	ASSERT_EQ(LLONG_MAX, Object::Fixed(car(pair)));
+	local_.Pop(1);
+}
+
+TEST_F(ObjectManagementTest, MinorGc) {
+	obm_->MinorGc(&local_, &env_);
+	ASSERT_EQ(0U, obm_->YoungAllocated());
+	size_t allocated = obm_->Allocated();
+
+	Object *list = obm_->Constant(kEmptyList);
+	for (int i = 0; i < 100; ++i) {
+		obm_->NewFixed(LLONG_MAX); // Garbage
+		list = obm_->Cons(obm_->NewFixed(LLONG_MAX - i), list);
+	}
+	local_.Push(list);
+	ASSERT_EQ(300 * sizeof(Object), obm_->YoungAllocated());
+	ASSERT_FALSE(list->IsOld());
+
+	obm_->MinorGc(&local_, &env_);
+	ASSERT_EQ(0U, obm_->YoungAllocated());
+	ASSERT_EQ(allocated + 200 * sizeof(Object), obm_->Allocated());
+	ASSERT_TRUE(list->IsOld());
+	ASSERT_TRUE(car(list)->IsOld());
+	local_.Pop(1);
+}
+
+TEST_F(ObjectManagementTest, RememberedSet) {
+	Environment *env = obm_->NewEnvironment(obm_->GlobalEnvironment());
+	Object *pair = obm_->Cons(obm_->Constant(kEmptyList),
+			obm_->Constant(kEmptyList));
+	Object *name = obm_->NewSymbol("a");
+	local_.Push(name);
+	local_.Push(pair);
+	env_.Push(env);
+	obm_->MinorGc(&local_, &env_);
+	ASSERT_TRUE(pair->IsOld());
+	ASSERT_TRUE(env->IsOld());
+	size_t allocated = obm_->Allocated();
+
+	// Young ones only be reachable from old ones.
+	obm_->SetCar(pair, obm_->NewFixed(LLONG_MAX));
+	env->Define(name->Symbol(), obm_->NewFixed(LLONG_MAX - 1));
+	obm_->WriteBarrier(env, env->Lookup("a"));
+	obm_->NewFixed(LLONG_MAX); // Garbage
+
+	obm_->MinorGc(&local_, &env_);
+	ASSERT_EQ(allocated + 2 * sizeof(Object), obm_->Allocated());
+	ASSERT_TRUE(car(pair)->IsOld());
+	ASSERT_EQ(LLONG_MAX, Object::Fixed(car(pair)));
+	ASSERT_EQ(LLONG_MAX - 1, Object::Fixed(env->Lookup("a")));
+	local_.Pop(2);
+	env_.Pop(1);
+}
+
+TEST_F(ObjectManagementTest, DeepStructure) {
+	RunCycle();
+	size_t allocated = obm_->Allocated();
+
+	// A long chain nested by car, like (((... ()))).
+	const int n = 1000000;
+	Object *chain = obm_->Constant(kEmptyList);
+	for (int i = 0; i < n; ++i)
+		chain = obm_->Cons(chain, obm_->Constant(kEmptyList));
+	local_.Push(chain);
+	obm_->MinorGc(&local_, &env_);
+	RunCycle();
+	ASSERT_EQ(allocated + n * sizeof(Object), obm_->Allocated());
+	local_.Pop(1);
+	RunCycle();
+	ASSERT_EQ(allocated, obm_->Allocated());
+}
+
+TEST_F(ObjectManagementTest, MarkStackOverflow) {
+	obm_->SetMarkStackLimit(4);
+	RunCycle();
+	size_t allocated = obm_->Allocated();
+
+	// A full binary tree, more gray ones than the mark stack can hold.
+	std::vector<Object*> level;
+	for (int i = 0; i < 1024; ++i)
+		level.push_back(obm_->NewFixed(LLONG_MAX - i));
+	while (level.size() > 1) {
+		std::vector<Object*> up;
+		for (size_t i = 0; i < level.size(); i += 2)
+			up.push_back(obm_->Cons(level[i], level[i + 1]));
+		level.swap(up);
+	}
+	local_.Push(level[0]);
+	obm_->MinorGc(&local_, &env_);
+	ASSERT_EQ(allocated + 2047 * sizeof(Object), obm_->Allocated());
+	RunCycle();
+	ASSERT_EQ(allocated + 2047 * sizeof(Object), obm_->Allocated());
+
+	Object *leaf = level[0];
+	while (Object::IsPair(leaf))
+		leaf = car(leaf);
+	ASSERT_EQ(LLONG_MAX, Object::Fixed(leaf));
+	local_.Pop(1);
+}
+
+TEST_F(ObjectManagementTest, LazySweeping) {
+	RunCycle();
+	size_t allocated = obm_->Allocated();
+	for (int i = 0; i < 10000; ++i)
+		obm_->NewFixed(LLONG_MAX);
+	obm_->MinorGc(&local_, &env_);
+	ASSERT_EQ(allocated, obm_->Allocated());
+
+	// Promoted garbage, it is not swept at the end of cycle.
+	for (int i = 0; i < 10000; ++i)
+		local_.Push(obm_->NewFixed(LLONG_MAX));
+	obm_->MinorGc(&local_, &env_);
+	local_.Pop(10000);
+	StartCycle();
+	while (obm_->GcState() != ObjectManagement::kPause)
+		obm_->GcTick(&local_, &env_);
+	ASSERT_EQ(allocated + 10000 * sizeof(Object), obm_->Allocated());
+
+	// Swept by allocating, the freed slots be reused.
+	size_t pages = obm_->GcStats().pages_swept;
+	for (int i = 0; i < 10000; ++i)
+		local_.Push(obm_->NewFixed(LLONG_MAX));
+	ASSERT_LT(pages, obm_->GcStats().pages_swept);
+	local_.Pop(10000);
+	obm_->FinishSweeping();
+	ASSERT_EQ(allocated + 10000 * sizeof(Object), obm_->Allocated());
+
+	// Paced again after the last page be swept.
+	StartCycle();
+	while (obm_->GcState() != ObjectManagement::kPause)
+		obm_->GcTick(&local_, &env_);
+	obm_->FinishSweeping();
+	ASSERT_EQ(allocated, obm_->Allocated());
+	ASSERT_EQ(obm_->PaceThreshold(obm_->Allocated()), obm_->Threshold());
+}
+
+TEST_F(ObjectManagementTest, SideMarks) {
+	Object *list = obm_->Constant(kEmptyList);
+	for (int i = 0; i < 1000; ++i)
+		list = obm_->Cons(obm_->NewFixed(LLONG_MAX), list);
+	local_.Push(list);
+	obm_->MinorGc(&local_, &env_);
+	unsigned white = list->TestWhite(Reachable::WHITE_BIT0) ?
+		Reachable::WHITE_BIT0 : Reachable::WHITE_BIT1;
+
+	// Marking and sweeping never write to the old objects, the marks are
+	// cleared by sweeping.
+	RunCycle();
+	obm_->SetGcThreads(2);
+	obm_->SetGcConcurrentSweep(true);
+	RunCycle();
+	for (Object *i = list; !obm_->Null(i); i = cdr(i)) {
+		ASSERT_TRUE(i->TestWhite(white));
+		ASSERT_TRUE(car(i)->TestWhite(white));
+		ASSERT_FALSE(ObjectSpace::IsMarked(i));
+		ASSERT_FALSE(ObjectSpace::IsMarked(car(i)));
+	}
+	local_.Pop(1);
+}
+
+TEST_F(ObjectManagementTest, ParallelMarking) {
+	obm_->SetGcThreads(4);
+	obm_->SetMarkStackLimit(4);
+	RunCycle();
+	size_t allocated = obm_->Allocated();
+
+	Environment *frame = obm_->NewEnvironment(obm_->GlobalEnvironment());
+	env_.Push(frame);
+	std::vector<Object*> level;
+	for (int i = 0; i < 1024; ++i)
+		level.push_back(obm_->NewFixed(LLONG_MAX - i));
+	while (level.size() > 1) {
+		std::vector<Object*> up;
+		for (size_t i = 0; i < level.size(); i += 2)
+			up.push_back(obm_->Cons(level[i], level[i + 1]));
+		level.swap(up);
+	}
+	frame->Define(obm_->NewSymbol("tree")->Symbol(), level[0]);
+	obm_->MinorGc(&local_, &env_);
+	size_t live = obm_->Allocated() - allocated;
+	ASSERT_LT(2047 * sizeof(Object), live);
+
+	// Promoted garbage, collected by major gc.
+	for (int i = 0; i < 100; ++i)
+		local_.Push(obm_->Cons(obm_->NewFixed(LLONG_MAX), level[0]));
+	obm_->MinorGc(&local_, &env_);
+	local_.Pop(100);
+	ASSERT_EQ(allocated + live + 200 * sizeof(Object), obm_->Allocated());
+
+	RunCycle();
+	ASSERT_EQ(allocated + live, obm_->Allocated());
+	ASSERT_EQ(level[0], frame->Lookup("tree"));
+	env_.Pop(1);
+
+	obm_->SetGcThreads(1);
+	RunCycle();
+	ASSERT_EQ(allocated, obm_->Allocated());
+}
+
+TEST_F(ObjectManagementTest, ConcurrentSweep) {
+	obm_->SetGcConcurrentSweep(true);
+	RunCycle();
+	size_t allocated = obm_->Allocated();
+
+	// Promoted garbage: objects, environments and a symbol.
+	for (int i = 0; i < 10000; ++i)
+		local_.Push(obm_->Cons(obm_->NewFixed(LLONG_MAX),
+				obm_->Constant(kEmptyList)));
+	for (int i = 0; i < 100; ++i)
+		env_.Push(obm_->NewEnvironment(obm_->GlobalEnvironment()));
+	local_.Push(obm_->NewSymbol("sweeper.dead"));
+	obm_->MinorGc(&local_, &env_);
+	local_.Pop(10001);
+	env_.Pop(100);
+	ASSERT_LT(allocated + 20001 * sizeof(Object), obm_->Allocated());
+
+	// The mutator keeps allocating in sweeping.
+	StartCycle();
+	while (obm_->GcState() != ObjectManagement::kPause)
+		obm_->GcTick(&local_, &env_);
+	Object *list = obm_->Constant(kEmptyList);
+	local_.Push(list);
+	for (int i = 0; i < 10000; ++i) {
+		list = obm_->Cons(obm_->NewFixed(LLONG_MAX - i), list);
+		local_.Pop(1);
+		local_.Push(list);
+	}
+	obm_->MinorGc(&local_, &env_);
+	obm_->FinishSweeping();
+	ASSERT_EQ(allocated + 20000 * sizeof(Object), obm_->Allocated());
+
+	for (int i = 0; i < 10000; ++i) {
+		ASSERT_EQ(LLONG_MAX - 9999 + i, Object::Fixed(car(list)));
+		list = cdr(list);
+	}
+	local_.Pop(1);
+	RunCycle();
+	ASSERT_EQ(allocated, obm_->Allocated());
+}
+
+TEST_F(ObjectManagementTest, Seal) {
+	Environment *global = obm_->GlobalEnvironment();
+	Object *list = obm_->Constant(kEmptyList);
+	for (int i = 0; i < 1000; ++i)
+		list = obm_->Cons(obm_->NewFixed(LLONG_MAX - i), list);
+	global->Define(obm_->NewSymbol("sealed")->Symbol(), list);
+	obm_->WriteBarrier(global, list);
+	Object *garbage = obm_->Cons(obm_->NewFixed(LLONG_MAX), list);
+
+	obm_->RequestSeal();
+	obm_->GcTick(&local_, &env_);
+	ASSERT_TRUE(global->IsPermanent());
+	ASSERT_TRUE(list->IsPermanent());
+	ASSERT_TRUE(car(list)->IsPermanent());
+	ASSERT_FALSE(garbage->IsPermanent());
+	ASSERT_LE(2000U, obm_->GcStats().permanent_objects);
+	ASSERT_EQ(1U, obm_->GcStats().permanent_envs);
+	RunCycle();
+	size_t allocated = obm_->Allocated();
+	RunCycle();
+	ASSERT_EQ(allocated, obm_->Allocated());
+	ASSERT_TRUE(list->IsPermanent());
+
+	// The permanent holder points to a young one.
+	obm_->SetCar(list, obm_->NewFixed(LLONG_MIN));
+	obm_->MinorGc(&local_, &env_);
+	RunCycle();
+	ASSERT_EQ(allocated + sizeof(Object), obm_->Allocated());
+	ASSERT_EQ(LLONG_MIN, Object::Fixed(car(list)));
+	ASSERT_FALSE(car(list)->IsPermanent());
+
+	// Sealed again, the holder be forgotten.
+	obm_->Seal(&local_, &env_);
+	ASSERT_TRUE(car(list)->IsPermanent());
+	obm_->SetCar(list, obm_->NewFixed(0));
+	RunCycle();
+	ASSERT_EQ(allocated + sizeof(Object), obm_->Allocated());
+}
+
+TEST_F(ObjectManagementTest, CompressedRefs) {
+	const long long big = 1LL << 40;
+	Object *small = Object::MakeFixed(-1);
+	Object *pair = obm_->Cons(Object::MakeFixed(big), small);
+	ASSERT_EQ(big, Object::Fixed(car(pair)));
+	ASSERT_EQ(small, cdr(pair));
+	obm_->SetCdr(pair, Object::MakeFixed(-big));
+	ASSERT_EQ(-big, Object::Fixed(cdr(pair)));
+#if defined(AJIMU_COMPRESSED_REFS)
+	// Out of 31 bits, it be boxed in heap.
+	ASSERT_FALSE(Object::IsImmediate(car(pair)));
+	ASSERT_EQ(2 * sizeof(void *), sizeof(Object));
+#else
+	ASSERT_TRUE(Object::IsImmediate(car(pair)));
+#endif
+	local_.Push(pair);
+	RunCycle();
+	ASSERT_EQ(big, Object::Fixed(car(pair)));
+	ASSERT_EQ(-big, Object::Fixed(cdr(pair)));
+	local_.Pop(1);
+}
+
+TEST_F(ObjectManagementTest, ConservativeRoots) {
+	obm_->SetGcConservative(true);
+	ASSERT_TRUE(obm_->GcConservative());
+
+	// Only be held by the C++ local.
+	Object *held = obm_->Cons(obm_->NewFixed(LLONG_MAX),
+			obm_->Constant(kEmptyList));
+	obm_->MinorGc(&local_, &env_);
+	ASSERT_TRUE(held->IsOld());
+	RunCycle();
+	RunCycle();
+	ASSERT_FALSE(ObjectSpace::IsFree(held));
+	ASSERT_EQ(LLONG_MAX, Object::Fixed(car(held)));
+	ASSERT_LT(0U, obm_->GcStats().stack_roots);
+
+	obm_->SetGcConservative(false);
+	ASSERT_FALSE(obm_->GcConservative());
+}
+
 } // namespace values
 } // namespace ajimu
 
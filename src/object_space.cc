@@ -0,0 +1,164 @@
+#include "object_space.h"
+#include "glog/logging.h"
+#include <stdlib.h>
+#include <algorithm>
+#if defined(AJIMU_COMPRESSED_REFS)
+#include <sys/mman.h>
+#include <mutex>
+#endif
+
+namespace ajimu {
+namespace values {
+
+#if defined(AJIMU_COMPRESSED_REFS)
+namespace {
+
+//
+// All object pages in one reserved range of 4 GB, so the compressed ref
+// is the offset from base of the range. The range be shared by all
+// spaces, the pages be returned to system but the addresses be reused.
+//
+class PageArena {
+public:
+	PageArena() : base_(0), top_(0), limit_(0) {
+		const size_t size = (1ULL << 32) + ObjectSpace::kPageSize;
+		void *range = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (range == MAP_FAILED) {
+			LOG(FATAL) << "Object pages range reserving fail.";
+			return;
+		}
+		uintptr_t base = reinterpret_cast<uintptr_t>(range);
+		base = (base + ObjectSpace::kPageSize - 1) &
+			~static_cast<uintptr_t>(ObjectSpace::kPageSize - 1);
+		base_  = base;
+		top_   = base;
+		limit_ = base + (1ULL << 32);
+	}
+
+	void *Allocate() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!free_.empty()) {
+			void *page = free_.back();
+			free_.pop_back();
+			return page;
+		}
+		if (top_ + ObjectSpace::kPageSize > limit_)
+			return nullptr;
+		void *page = reinterpret_cast<void *>(top_);
+		top_ += ObjectSpace::kPageSize;
+		return page;
+	}
+
+	void Free(void *page) {
+		madvise(page, ObjectSpace::kPageSize, MADV_DONTNEED);
+		std::lock_guard<std::mutex> lock(mutex_);
+		free_.push_back(page);
+	}
+
+	uintptr_t Base() const {
+		return base_;
+	}
+
+	static PageArena *Get() {
+		static PageArena *arena = new PageArena;
+		return arena;
+	}
+
+private:
+	uintptr_t base_;
+	uintptr_t top_;
+	uintptr_t limit_;
+	std::vector<void *> free_;
+	std::mutex mutex_;
+}; // class PageArena
+
+} // namespace
+
+static void *AllocatePage() {
+	return PageArena::Get()->Allocate();
+}
+
+static void FreePage(void *page) {
+	PageArena::Get()->Free(page);
+}
+#else
+static void *AllocatePage() {
+	void *blob = nullptr;
+	if (posix_memalign(&blob, ObjectSpace::kPageSize,
+			ObjectSpace::kPageSize) != 0)
+		return nullptr;
+	return blob;
+}
+
+static void FreePage(void *page) {
+	free(page);
+}
+#endif
+
+const size_t ObjectSpace::kSlotsPerPage;
+const size_t ObjectSpace::kBitmapWords;
+
+ObjectSpace::ObjectSpace()
+	: pages_(nullptr)
+	, unswept_(nullptr)
+	, free_(nullptr)
+	, page_count_(0)
+	, marking_(false)
+	, lowest_(UINTPTR_MAX)
+	, highest_(0) {
+	static_assert(sizeof(Page) % sizeof(void *) == 0,
+			"Slots must be aligned to pointer.");
+#if defined(AJIMU_COMPRESSED_REFS)
+	Object::ref_base_ = PageArena::Get()->Base();
+#endif
+}
+
+ObjectSpace::~ObjectSpace() {
+	Page *i = pages_, *p;
+	while (i) {
+		p = i;
+		i = i->next;
+		free(p->marks);
+		FreePage(p);
+	}
+}
+
+void ObjectSpace::AddPage() {
+	void *blob = AllocatePage();
+	if (!blob) {
+		LOG(FATAL) << "Object page allocation fail.";
+		return;
+	}
+	Page *page = static_cast<Page *>(blob);
+	page->next = pages_;
+	page->young = 0;
+	page->marking = marking_ ? 1 : 0;
+	page->marks = static_cast<uint64_t *>(
+			calloc(2 * kBitmapWords, sizeof(uint64_t)));
+	if (!page->marks) {
+		LOG(FATAL) << "Mark bitmaps allocation fail.";
+		return;
+	}
+	pages_ = page;
+	++page_count_;
+	page_set_.insert(page);
+	lowest_  = std::min(lowest_, reinterpret_cast<uintptr_t>(page));
+	highest_ = std::max(highest_, reinterpret_cast<uintptr_t>(page) +
+			kPageSize);
+
+	// Push in reverse order, so the slots be allocated in address order.
+	for (Object *o = page->End(); o-- != page->Begin();)
+		Free(o);
+}
+
+void ObjectSpace::StartMarking() {
+	for (Page *page = pages_; page; page = page->next) {
+		DCHECK(!page->marking);
+		page->marking = 1;
+	}
+	marking_ = true;
+}
+
+} // namespace values
+} // namespace ajimu
@@ -0,0 +1,290 @@
+#ifndef AJIMU_VALUES_OBJECT_SPACE_H
+#define AJIMU_VALUES_OBJECT_SPACE_H
+
+#include "object.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <unordered_set>
+
+namespace ajimu {
+namespace values {
+
+//
+// Pages of objects. All objects have the same size, so a page is an
+// array of slots. The free slots have FREE color and be linked by their
+// payload in the free list.
+//
+// Objects are not linked, they are found by walking the pages. The pages
+// have young objects be recorded, the minor gc only walks them.
+//
+// Marks of major gc are in side bitmaps of pages, one bit per slot. The
+// marking and sweeping never write to the old objects, so their pages
+// stay clean (and shared after fork). A page uses its bitmaps from the
+// start of marking until it be swept; the slots be allocated in this
+// time are marked too.
+//
+// After marking, all pages become unswept. The owner sweeps them lazily:
+// by allocating if the free list is empty, or page by page before the
+// next marking.
+//
+class ObjectSpace {
+public:
+	enum {
+		kPageShift = 16,
+		kPageSize  = 1 << kPageShift, // 64 KB
+		kBitsPerWord = 64,
+	};
+
+	struct Page {
+		Page *next;
+		uint32_t young;   // In the young pages
+		uint32_t marking; // Bitmaps in use, not swept yet
+		uint64_t *marks;  // Mark bits, then gray bits, out of the page
+		size_t padding;
+
+		uint64_t *Grays() {
+			return marks + kBitmapWords;
+		}
+
+		Object *Begin() {
+			return reinterpret_cast<Object *>(this + 1);
+		}
+
+		Object *End() {
+			return Begin() + kSlotsPerPage;
+		}
+	};
+
+	static const size_t kSlotsPerPage =
+		(kPageSize - sizeof(Page)) / sizeof(Object);
+
+	static const size_t kBitmapWords =
+		(kSlotsPerPage + kBitsPerWord - 1) / kBitsPerWord;
+
+	ObjectSpace();
+
+	// Objects in pages must be destroyed by owner first.
+	~ObjectSpace();
+
+	// Pop a free slot, or nullptr if the free list is empty.
+	// The slot is marked if its page be in marking or not swept.
+	void *Allocate() {
+		Object *slot = free_;
+		if (!slot)
+			return nullptr;
+		free_ = slot->next_free_;
+		Retain(slot);
+		return slot;
+	}
+
+	// Push the slot of the destroyed object to free list.
+	void Free(void *p) {
+		Object *slot = static_cast<Object *>(p);
+		slot->next_free_ = free_;
+		slot->color_ = Reachable::FREE;
+		free_ = slot;
+	}
+
+	static Page *PageOf(const void *p) {
+		return reinterpret_cast<Page *>(
+				reinterpret_cast<uintptr_t>(p) &
+				~static_cast<uintptr_t>(kPageSize - 1));
+	}
+
+	//
+	// Mark bits:
+	//
+	static bool IsMarked(const Object *o) {
+		Page *page = PageOf(o);
+		size_t i = o - page->Begin();
+		return (page->marks[i / kBitsPerWord] & Bit(i)) != 0;
+	}
+
+	// Returns false if it has been marked.
+	static bool Mark(Object *o) {
+		Page *page = PageOf(o);
+		size_t i = o - page->Begin();
+		uint64_t *word = page->marks + i / kBitsPerWord;
+		if (*word & Bit(i))
+			return false;
+		*word |= Bit(i);
+		return true;
+	}
+
+	// For marking by threads: Only one thread can mark it.
+	static bool AtomicMark(Object *o) {
+		Page *page = PageOf(o);
+		size_t i = o - page->Begin();
+		return (__atomic_fetch_or(page->marks + i / kBitsPerWord, Bit(i),
+				__ATOMIC_RELAXED) & Bit(i)) == 0;
+	}
+
+	// The marked one be dropped by the overflowed mark stack, it must be
+	// found by FindGray() later.
+	static void AtomicMarkGray(Object *o) {
+		Page *page = PageOf(o);
+		size_t i = o - page->Begin();
+		__atomic_fetch_or(page->Grays() + i / kBitsPerWord, Bit(i),
+				__ATOMIC_RELAXED);
+	}
+
+	// Keep it from the sweeping of its page in this cycle.
+	static void Retain(Object *o) {
+		Page *page = PageOf(o);
+		if (page->marking)
+			Mark(o);
+	}
+
+	// Pop the gray ones of page to stack, until the stack is full.
+	template<class Stack>
+	static bool FindGray(Page *page, Stack *stack) {
+		uint64_t *grays = page->Grays();
+		for (size_t w = 0; w < kBitmapWords; ++w) {
+			while (grays[w]) {
+				size_t i = w * kBitsPerWord + __builtin_ctzll(grays[w]);
+				if (!stack->Push(page->Begin() + i))
+					return false;
+				grays[w] &= ~Bit(i);
+			}
+		}
+		return true;
+	}
+
+	// Call back the unmarked slots of page, the free ones are included.
+	// The bitmap be scanned a word at a time, full words be skipped.
+	template<class Callback>
+	static void ForEachUnmarked(Page *page, Callback callback) {
+		for (size_t w = 0; w < kBitmapWords; ++w) {
+			uint64_t unmarked = ~page->marks[w];
+			Object *base = page->Begin() + w * kBitsPerWord;
+			while (unmarked) {
+				Object *o = base + __builtin_ctzll(unmarked);
+				if (o >= page->End())
+					break;
+				unmarked &= unmarked - 1;
+				callback(o);
+			}
+		}
+	}
+
+	// The page be swept, its marks are not used until next marking.
+	static void ClearMarks(Page *page) {
+		memset(page->marks, 0, 2 * kBitmapWords * sizeof(uint64_t));
+		page->marking = 0;
+	}
+
+	// Start marking: All pages use their bitmaps, and the new ones too
+	// until sweeping.
+	void StartMarking();
+
+	// The young object be allocated in the slot.
+	void RecordYoung(const void *p) {
+		Page *page = PageOf(p);
+		if (!page->young) {
+			page->young = 1;
+			young_pages_.push_back(page);
+		}
+	}
+
+	const std::vector<Page*> &YoungPages() const {
+		return young_pages_;
+	}
+
+	// All young objects be promoted or collected.
+	void ClearYoungPages() {
+		for (auto page : young_pages_)
+			page->young = 0;
+		young_pages_.clear();
+	}
+
+	// All slots of the new page be pushed to free list.
+	void AddPage();
+
+	// Forget the free list, the pages will be swept in background and
+	// their free slots be linked again. The new pages are not swept, so
+	// they have no marks.
+	void ResetFreeList() {
+		free_ = nullptr;
+		marking_ = false;
+	}
+
+	// Push a chain of free slots be linked by the sweeper.
+	void AddFreeSlots(Object *head, Object *tail) {
+		tail->next_free_ = free_;
+		free_ = head;
+	}
+
+	// The slot contains the address, or nullptr if it is not in pages.
+	// The slot may be free, the caller must check it.
+	Object *FindSlot(uintptr_t addr) const {
+		if (addr < lowest_ || addr >= highest_)
+			return nullptr;
+		Page *page = PageOf(reinterpret_cast<void *>(addr));
+		if (page_set_.find(page) == page_set_.end())
+			return nullptr;
+		uintptr_t begin = reinterpret_cast<uintptr_t>(page->Begin());
+		if (addr < begin)
+			return nullptr;
+		size_t i = (addr - begin) / sizeof(Object);
+		return i < kSlotsPerPage ? page->Begin() + i : nullptr;
+	}
+
+	static bool IsFree(const Object *o) {
+		return o->color_ == Reachable::FREE;
+	}
+
+	size_t PageCount() const {
+		return page_count_;
+	}
+
+	Page *Pages() const {
+		return pages_;
+	}
+
+	//
+	// Lazy sweeping:
+	//
+	void StartSweeping() {
+		unswept_ = pages_;
+		marking_ = false;
+	}
+
+	bool Sweeping() const {
+		return unswept_ != nullptr;
+	}
+
+	// The next page to sweep, nullptr if all pages be swept.
+	Page *NextUnswept() {
+		Page *page = unswept_;
+		if (page)
+			unswept_ = page->next;
+		return page;
+	}
+
+private:
+	ObjectSpace(const ObjectSpace &) = delete;
+	void operator = (const ObjectSpace &) = delete;
+
+	static uint64_t Bit(size_t i) {
+		return 1ULL << (i % kBitsPerWord);
+	}
+
+	Page *pages_;
+	Page *unswept_; // New pages are linked at head, never unswept
+	Object *free_;
+	size_t page_count_;
+	bool marking_; // The new pages be marked too
+	std::vector<Page*> young_pages_;
+
+	// For finding the slot by address
+	std::unordered_set<Page*> page_set_;
+	uintptr_t lowest_;
+	uintptr_t highest_;
+}; // class ObjectSpace
+
+} // namespace values
+} // namespace ajimu
+
+#endif //AJIMU_VALUES_OBJECT_SPACE_H
@@ -0,0 +1,174 @@
+#include "object_space.h"
+#include "mark_stack.h"
+#include "gmock/gmock.h"
+#include <vector>
+
+namespace ajimu {
+namespace values {
+
+TEST(ObjectSpaceTest, Sanity) {
+	ObjectSpace space;
+	ASSERT_EQ(nullptr, space.Allocate());
+	ASSERT_EQ(0U, space.PageCount());
+
+	space.AddPage();
+	ASSERT_EQ(1U, space.PageCount());
+	ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(space.Pages()) %
+			ObjectSpace::kPageSize);
+
+	// Slots be allocated in address order.
+	Object *a = static_cast<Object *>(space.Allocate());
+	Object *b = static_cast<Object *>(space.Allocate());
+	ASSERT_EQ(space.Pages()->Begin(), a);
+	ASSERT_EQ(a + 1, b);
+	ASSERT_LE(reinterpret_cast<char *>(space.Pages()->End()),
+			reinterpret_cast<char *>(space.Pages()) + ObjectSpace::kPageSize);
+
+	// Freed slot be reused first
+	space.Free(a);
+	ASSERT_TRUE(ObjectSpace::IsFree(a));
+	ASSERT_EQ(a, space.Allocate());
+}
+
+TEST(ObjectSpaceTest, FullPage) {
+	ObjectSpace space;
+	space.AddPage();
+	std::vector<void *> slots;
+	for (size_t i = 0; i < ObjectSpace::kSlotsPerPage; ++i)
+		slots.push_back(space.Allocate());
+	ASSERT_EQ(nullptr, space.Allocate());
+	for (auto slot : slots)
+		space.Free(slot);
+	space.AddPage();
+	ASSERT_EQ(2U, space.PageCount());
+}
+
+TEST(ObjectSpaceTest, Unswept) {
+	ObjectSpace space;
+	space.AddPage();
+	space.AddPage();
+	ASSERT_FALSE(space.Sweeping());
+
+	space.StartSweeping();
+	ASSERT_TRUE(space.Sweeping());
+	ObjectSpace::Page *page = space.NextUnswept();
+	ASSERT_EQ(space.Pages(), page);
+	ASSERT_EQ(page->next, space.NextUnswept());
+	ASSERT_FALSE(space.Sweeping());
+	ASSERT_EQ(nullptr, space.NextUnswept());
+}
+
+TEST(ObjectSpaceTest, YoungPages) {
+	ObjectSpace space;
+	space.AddPage();
+	space.AddPage();
+	ObjectSpace::Page *page = space.Pages();
+	void *a = space.Allocate();
+	void *b = space.Allocate();
+	ASSERT_EQ(page, ObjectSpace::PageOf(a));
+	ASSERT_EQ(page, ObjectSpace::PageOf(page->End() - 1));
+	ASSERT_TRUE(space.YoungPages().empty());
+
+	// A page be recorded once.
+	space.RecordYoung(a);
+	space.RecordYoung(b);
+	ASSERT_EQ(1U, space.YoungPages().size());
+	ASSERT_EQ(page, space.YoungPages()[0]);
+
+	space.RecordYoung(page->next->Begin());
+	ASSERT_EQ(2U, space.YoungPages().size());
+
+	space.ClearYoungPages();
+	ASSERT_TRUE(space.YoungPages().empty());
+	space.RecordYoung(a);
+	ASSERT_EQ(1U, space.YoungPages().size());
+}
+
+TEST(ObjectSpaceTest, MarkBits) {
+	ObjectSpace space;
+	space.AddPage();
+	ObjectSpace::Page *page = space.Pages();
+	Object *a = page->Begin();
+	Object *b = page->End() - 1;
+	ASSERT_FALSE(ObjectSpace::IsMarked(a));
+	ASSERT_TRUE(ObjectSpace::Mark(a));
+	ASSERT_FALSE(ObjectSpace::Mark(a));
+	ASSERT_TRUE(ObjectSpace::AtomicMark(b));
+	ASSERT_FALSE(ObjectSpace::AtomicMark(b));
+	ASSERT_TRUE(ObjectSpace::IsMarked(a));
+	ASSERT_TRUE(ObjectSpace::IsMarked(b));
+
+	size_t unmarked = 0;
+	ObjectSpace::ForEachUnmarked(page, [&] (Object *o) {
+		ASSERT_TRUE(o != a && o != b);
+		ASSERT_TRUE(o >= page->Begin() && o < page->End());
+		++unmarked;
+	});
+	ASSERT_EQ(ObjectSpace::kSlotsPerPage - 2, unmarked);
+
+	// The gray ones be found until the stack is full.
+	ObjectSpace::AtomicMarkGray(a);
+	ObjectSpace::AtomicMarkGray(b);
+	MarkStack<Object*> stack;
+	stack.SetLimit(1);
+	ASSERT_FALSE(ObjectSpace::FindGray(page, &stack));
+	ASSERT_EQ(a, stack.Pop());
+	ASSERT_TRUE(ObjectSpace::FindGray(page, &stack));
+	ASSERT_EQ(b, stack.Pop());
+
+	ObjectSpace::ClearMarks(page);
+	ASSERT_FALSE(ObjectSpace::IsMarked(a));
+	ASSERT_FALSE(ObjectSpace::IsMarked(b));
+	ASSERT_TRUE(ObjectSpace::FindGray(page, &stack));
+	ASSERT_TRUE(stack.Empty());
+}
+
+TEST(ObjectSpaceTest, Marking) {
+	ObjectSpace space;
+	space.AddPage();
+	ASSERT_FALSE(space.Pages()->marking);
+
+	// Allocated ones are marked from marking until sweeping.
+	space.StartMarking();
+	ASSERT_TRUE(space.Pages()->marking);
+	Object *a = static_cast<Object *>(space.Allocate());
+	ASSERT_TRUE(ObjectSpace::IsMarked(a));
+	space.AddPage();
+	ASSERT_TRUE(space.Pages()->marking);
+
+	space.StartSweeping();
+	space.AddPage();
+	ASSERT_FALSE(space.Pages()->marking);
+	Object *b = static_cast<Object *>(space.Allocate());
+	ASSERT_FALSE(ObjectSpace::IsMarked(b));
+
+	ObjectSpace::Page *page;
+	while ((page = space.NextUnswept()) != nullptr)
+		ObjectSpace::ClearMarks(page);
+	ASSERT_FALSE(ObjectSpace::IsMarked(a));
+	space.Free(a);
+	ASSERT_FALSE(ObjectSpace::IsMarked(
+			static_cast<Object *>(space.Allocate())));
+}
+
+TEST(ObjectSpaceTest, FindSlot) {
+	ObjectSpace space;
+	ASSERT_EQ(nullptr, space.FindSlot(0));
+	space.AddPage();
+	Object *a = static_cast<Object *>(space.Allocate());
+	uintptr_t addr = reinterpret_cast<uintptr_t>(a);
+	ASSERT_EQ(a, space.FindSlot(addr));
+	ASSERT_EQ(a, space.FindSlot(addr + sizeof(Object) - 1));
+	ASSERT_EQ(a + 1, space.FindSlot(addr + sizeof(Object)));
+
+	// Not in the slots of pages.
+	ASSERT_EQ(nullptr, space.FindSlot(
+			reinterpret_cast<uintptr_t>(space.Pages())));
+	ASSERT_EQ(nullptr, space.FindSlot(
+			reinterpret_cast<uintptr_t>(space.Pages()) +
+			ObjectSpace::kPageSize));
+	ASSERT_EQ(nullptr, space.FindSlot(reinterpret_cast<uintptr_t>(&space)));
+}
+
+} // namespace values
+} // namespace ajimu
@@ -1,6 +1,7 @@
 #include "object.h"
 #include "gmock/gmock.h"
 #include "glog/logging.h"
+#include <stdint.h>
 
 namespace ajimu {
 namespace values {
@@ -10,6 +11,37 @@ TEST(ObjectTest, Sanity) {
 	printf("sizeof(Object*): %zd\n", sizeof(Object*));
 }
 
+TEST(ObjectTest, Immediate) {
+	Object *o = Object::MakeFixed(-100);
+	ASSERT_TRUE(Object::IsImmediate(o));
+	ASSERT_EQ(FIXED, Object::TypeOf(o));
+	ASSERT_TRUE(Object::IsFixed(o));
+	ASSERT_FALSE(Object::IsReal(o));
+	ASSERT_EQ(-100LL, Object::Fixed(o));
+	ASSERT_EQ(o, Object::MakeFixed(-100));
+
+	long long max = INTPTR_MAX >> 1;
+	ASSERT_TRUE(Object::FitsFixed(max));
+	ASSERT_FALSE(Object::FitsFixed(max + 1));
+	ASSERT_EQ(max, Object::Fixed(Object::MakeFixed(max)));
+
+	o = Object::MakeCharacter('\xff');
+	ASSERT_EQ(CHARACTER, Object::TypeOf(o));
+	ASSERT_TRUE(Object::IsCharacter(o));
+	ASSERT_EQ('\xff', Object::Character(o));
+
+	o = Object::MakeBoolean(true);
+	ASSERT_EQ(BOOLEAN, Object::TypeOf(o));
+	ASSERT_TRUE(Object::Boolean(o));
+	ASSERT_FALSE(Object::Boolean(Object::MakeBoolean(false)));
+	ASSERT_FALSE(Object::IsCharacter(o));
+
+	o = Object::MakeEmptyList();
+	ASSERT_EQ(PAIR, Object::TypeOf(o));
+	ASSERT_TRUE(Object::IsPair(o));
+	ASSERT_FALSE(Object::IsHeapObject(o));
+}
+
 } // namespace values
 } // namespace ajimu
 
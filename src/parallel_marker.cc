@@ -0,0 +1,255 @@
+#include "parallel_marker.h"
+#include "object.h"
+#include "string.h"
+#include "environment.h"
+#include "continuation.h"
+#include "object_space.h"
+#include "glog/logging.h"
+
+namespace ajimu {
+namespace values {
+
+using vm::Environment;
+
+ParallelMarker::ParallelMarker(int threads, const SymbolMap *symbols)
+	: symbols_(DCHECK_NOTNULL(symbols))
+	, last_white_(Reachable::WHITE_BIT0)
+	, idle_(0)
+	, round_(0)
+	, running_(0)
+	, shutdown_(false) {
+	DCHECK_GE(threads, 1);
+	for (int i = 0; i < threads; ++i) {
+		workers_.emplace_back(new Worker);
+		workers_.back()->scanned = 0;
+	}
+	// The first one is the caller of Mark().
+	for (int i = 1; i < threads; ++i) {
+		Worker *worker = workers_[i].get();
+		worker->thread = std::thread([this, worker] () {
+			ThreadMain(worker);
+		});
+	}
+}
+
+ParallelMarker::~ParallelMarker() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		shutdown_ = true;
+	}
+	round_cv_.notify_all();
+	for (auto &worker : workers_) {
+		if (worker->thread.joinable())
+			worker->thread.join();
+	}
+}
+
+void ParallelMarker::SetMarkStackLimit(size_t limit) {
+	for (auto &worker : workers_) {
+		worker->gray_obj.SetLimit(limit);
+		worker->gray_env.SetLimit(limit);
+	}
+}
+
+bool ParallelMarker::Mark(MarkStack<Object*> *gray_obj,
+		MarkStack<Environment*> *gray_env, unsigned white) {
+	last_white_ = InvWhite(white);
+	bool overflowed = gray_obj->Overflowed() || gray_env->Overflowed();
+	gray_obj->ClearOverflowed();
+	gray_env->ClearOverflowed();
+
+	// Deal the gray ones to threads, the dropped ones are still gray.
+	size_t i = 0;
+	while (!gray_obj->Empty())
+		workers_[i++ % workers_.size()]->gray_obj.Push(gray_obj->Pop());
+	while (!gray_env->Empty())
+		workers_[i++ % workers_.size()]->gray_env.Push(gray_env->Pop());
+	for (auto &worker : workers_)
+		worker->scanned = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		idle_ = 0;
+		running_ = Threads() - 1;
+		++round_;
+	}
+	round_cv_.notify_all();
+	Run(workers_[0].get());
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		round_cv_.wait(lock, [this] () { return running_ == 0; });
+	}
+
+	for (auto &worker : workers_) {
+		if (worker->gray_obj.Overflowed() || worker->gray_env.Overflowed())
+			overflowed = true;
+		worker->gray_obj.ClearOverflowed();
+		worker->gray_env.ClearOverflowed();
+	}
+	return overflowed;
+}
+
+size_t ParallelMarker::Scanned() const {
+	size_t scanned = 0;
+	for (auto &worker : workers_)
+		scanned += worker->scanned;
+	return scanned;
+}
+
+void ParallelMarker::ThreadMain(Worker *worker) {
+	unsigned round = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			round_cv_.wait(lock, [this, round] () {
+				return shutdown_ || round_ != round;
+			});
+			if (shutdown_)
+				return;
+			round = round_;
+		}
+		Run(worker);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (--running_ == 0)
+				round_cv_.notify_all();
+		}
+	}
+}
+
+void ParallelMarker::Run(Worker *worker) {
+	for (;;) {
+		Drain(worker);
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		++idle_;
+		// No gray one be published, and no thread can publish: finished.
+		work_cv_.wait(lock, [this] () {
+			return !pool_.empty() || idle_ == Threads();
+		});
+		if (pool_.empty()) {
+			work_cv_.notify_all();
+			return;
+		}
+		--idle_;
+		Packet packet(std::move(pool_.back()));
+		pool_.pop_back();
+		lock.unlock();
+
+		for (auto o : packet.obj)
+			worker->gray_obj.Push(o);
+		for (auto env : packet.env)
+			worker->gray_env.Push(env);
+	}
+}
+
+void ParallelMarker::Drain(Worker *worker) {
+	size_t n = 0;
+	for (;;) {
+		if (!worker->gray_obj.Empty())
+			ScanObject(worker, worker->gray_obj.Pop());
+		else if (!worker->gray_env.Empty())
+			ScanEnvironment(worker, worker->gray_env.Pop());
+		else
+			return;
+		if (++n % kShareCheck == 0 && idle_.load(std::memory_order_relaxed) > 0)
+			Share(worker);
+	}
+}
+
+void ParallelMarker::Share(Worker *worker) {
+	// Keep a packet at least for itself.
+	if (worker->gray_obj.Size() + worker->gray_env.Size() <= kPacketSize)
+		return;
+	Packet packet;
+	while (packet.obj.size() < kPacketSize && !worker->gray_obj.Empty())
+		packet.obj.push_back(worker->gray_obj.Pop());
+	while (packet.obj.size() + packet.env.size() < kPacketSize &&
+			!worker->gray_env.Empty())
+		packet.env.push_back(worker->gray_env.Pop());
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pool_.push_back(std::move(packet));
+	}
+	work_cv_.notify_one();
+}
+
+void ParallelMarker::MarkObject(Worker *worker, Object *o) {
+	if (Object::IsImmediate(o) || o->IsPermanent())
+		return;
+	if (!ObjectSpace::AtomicMark(o))
+		return;
+	switch (Object::TypeOf(o)) {
+	case BOOLEAN:
+	case CHARACTER:
+		DLOG(FATAL) << "No reached!";
+		break;
+	case SYMBOL:
+	case FIXED:
+	case REAL:
+	case PRIMITIVE:
+		break;
+	case STRING:
+		o->String()->AtomicShade(last_white_, Reachable::BLACK);
+		break;
+	case CLOSURE:
+	case PAIR:
+	case CONTINUATION:
+		// Dropped by overflow, it will be found by the gray bits.
+		if (!worker->gray_obj.Push(o))
+			ObjectSpace::AtomicMarkGray(o);
+		break;
+	}
+}
+
+void ParallelMarker::MarkEnvironment(Worker *worker, Environment *env) {
+	if (env->AtomicShade(last_white_, Reachable::GRAY))
+		worker->gray_env.Push(env);
+}
+
+void ParallelMarker::ScanObject(Worker *worker, Object *o) {
+	switch (Object::TypeOf(o)) {
+	case CLOSURE:
+		MarkObject(worker, o->Params());
+		MarkObject(worker, o->Body());
+		MarkObject(worker, o->Expanded());
+		MarkEnvironment(worker, o->Environment());
+		break;
+	case PAIR:
+		MarkObject(worker, car(o));
+		MarkObject(worker, cdr(o));
+		break;
+	case CONTINUATION:
+		o->Continuation()->ForEach([this, worker] (Object *val) {
+			MarkObject(worker, val);
+		}, [this, worker] (Environment *val) {
+			MarkEnvironment(worker, val);
+		});
+		break;
+	default:
+		DLOG(FATAL) << "No reached!";
+		break;
+	}
+	++worker->scanned;
+}
+
+void ParallelMarker::ScanEnvironment(Worker *worker, Environment *env) {
+	env->AtomicToBlack();
+	if (env->Next())
+		MarkEnvironment(worker, env->Next());
+	if (env->Closure())
+		MarkObject(worker, env->Closure());
+	for (size_t i = 0; i < env->Count(); ++i)
+		MarkObject(worker, env->At(i));
+	for (const auto &entry : env->Entries()) {
+		auto iter = symbols_->find(entry.first);
+		DCHECK(iter != symbols_->end()) << "Symbol table has not: "
+				<< entry.first << " for mark!";
+		MarkObject(worker, iter->second);
+	}
+	++worker->scanned;
+}
+
+} // namespace values
+} // namespace ajimu
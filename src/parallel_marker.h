@@ -0,0 +1,117 @@
+#ifndef AJIMU_VALUES_PARALLEL_MARKER_H
+#define AJIMU_VALUES_PARALLEL_MARKER_H
+
+#include "mark_stack.h"
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+namespace ajimu {
+namespace vm {
+class Environment;
+} // namespace vm
+namespace values {
+class Object;
+
+//
+// Marking by a pool of threads, the caller is one of them. Each thread
+// scans the gray ones from its own mark stacks; a busy thread publishes
+// packets of its gray ones when some threads are idle, and the idle
+// threads steal them. Mark bits of objects and colors of environments
+// are set by atomic operations, so one only be scanned by one thread.
+//
+// The mutator must be stopped in marking, the fields of objects and
+// environments are not changed.
+//
+class ParallelMarker {
+public:
+	typedef std::unordered_map<std::string, Object*> SymbolMap;
+
+	// threads: Number of marking threads, includes the caller.
+	// symbols: For marking the names of environment.
+	ParallelMarker(int threads, const SymbolMap *symbols);
+
+	~ParallelMarker();
+
+	int Threads() const {
+		return static_cast<int>(workers_.size());
+	}
+
+	void SetMarkStackLimit(size_t limit);
+
+	// Scan the gray ones in the stacks, until no more gray one.
+	// white: Current white, the ones of last white be marked.
+	// Returns true if some gray ones be dropped by overflowed stacks, the
+	// caller must find them in heap and mark again.
+	bool Mark(MarkStack<Object*> *gray_obj,
+			MarkStack<vm::Environment*> *gray_env, unsigned white);
+
+	// Objects and environments be scanned by the last Mark().
+	size_t Scanned() const;
+
+private:
+	ParallelMarker(const ParallelMarker &) = delete;
+	void operator = (const ParallelMarker &) = delete;
+
+	enum {
+		kPacketSize = 64,  // Gray ones in one published packet
+		kShareCheck = 32,  // Scanned ones between two checks of idle
+	};
+
+	struct Packet {
+		std::vector<Object*> obj;
+		std::vector<vm::Environment*> env;
+	};
+
+	struct Worker {
+		MarkStack<Object*> gray_obj;
+		MarkStack<vm::Environment*> gray_env;
+		size_t scanned;
+		std::thread thread; // Not joinable for the caller
+	};
+
+	// Entry of pool thread: Wait for rounds of marking.
+	void ThreadMain(Worker *worker);
+
+	// One round of marking in one thread, returns when all are idle.
+	void Run(Worker *worker);
+
+	void Drain(Worker *worker);
+
+	// Move a packet of gray ones to the shared pool.
+	void Share(Worker *worker);
+
+	void MarkObject(Worker *worker, Object *o);
+
+	void MarkEnvironment(Worker *worker, vm::Environment *env);
+
+	void ScanObject(Worker *worker, Object *o);
+
+	void ScanEnvironment(Worker *worker, vm::Environment *env);
+
+	const SymbolMap *symbols_;
+	unsigned last_white_; // Color of the ones be marked in this round
+	std::vector<std::unique_ptr<Worker>> workers_;
+
+	// Shared pool of gray packets, and termination of round
+	std::mutex mutex_;
+	std::condition_variable work_cv_;
+	std::vector<Packet> pool_;
+	std::atomic<int> idle_;
+
+	// Rounds for pool threads
+	std::condition_variable round_cv_;
+	unsigned round_;
+	int running_; // Pool threads still in this round
+	bool shutdown_;
+}; // class ParallelMarker
+
+} // namespace values
+} // namespace ajimu
+
+#endif //AJIMU_VALUES_PARALLEL_MARKER_H
@@ -0,0 +1,123 @@
+#include "parallel_marker.h"
+#include "object_management.h"
+#include "object_space.h"
+#include "object.h"
+#include "gmock/gmock.h"
+#include <limits.h>
+#include <chrono>
+
+namespace ajimu {
+namespace values {
+
+class ParallelMarkerTest : public ::testing::Test {
+protected:
+	virtual void SetUp() override {
+		obm_ = new ObjectManagement();
+		obm_->Init();
+	}
+
+	virtual void TearDown() override {
+		delete obm_;
+		obm_ = nullptr;
+	}
+
+	// A full binary tree of pairs, the leaves are boxed fixed numbers.
+	Object *MakeTree(int depth) {
+		if (depth == 0)
+			return obm_->NewFixed(LLONG_MAX);
+		Object *left = MakeTree(depth - 1);
+		return obm_->Cons(left, MakeTree(depth - 1));
+	}
+
+	size_t CountMarked(Object *o) {
+		size_t n = ObjectSpace::IsMarked(o) ? 1 : 0;
+		if (Object::IsPair(o))
+			n += CountMarked(car(o)) + CountMarked(cdr(o));
+		return n;
+	}
+
+	// The gray one has been marked.
+	void PushGray(MarkStack<Object*> *gray_obj, Object *o) {
+		ObjectSpace::Mark(o);
+		gray_obj->Push(o);
+	}
+
+	// The new objects have current white, so mark them as last white.
+	unsigned MarkingWhite() {
+		Object *o = obm_->NewFixed(LLONG_MAX);
+		return o->TestWhite(Reachable::WHITE_BIT0) ?
+			Reachable::WHITE_BIT1 : Reachable::WHITE_BIT0;
+	}
+
+	ObjectManagement *obm_;
+	ParallelMarker::SymbolMap symbols_;
+};
+
+TEST_F(ParallelMarkerTest, Sanity) {
+	Object *tree = MakeTree(12);
+	MarkStack<Object*> gray_obj;
+	MarkStack<vm::Environment*> gray_env;
+	PushGray(&gray_obj, tree);
+
+	ParallelMarker marker(4, &symbols_);
+	ASSERT_EQ(4, marker.Threads());
+	ASSERT_FALSE(marker.Mark(&gray_obj, &gray_env, MarkingWhite()));
+	ASSERT_TRUE(gray_obj.Empty());
+	ASSERT_EQ((1U << 13) - 1, CountMarked(tree));
+	ASSERT_EQ((1U << 12) - 1, marker.Scanned());
+}
+
+TEST_F(ParallelMarkerTest, Rounds) {
+	ParallelMarker marker(3, &symbols_);
+	unsigned white = MarkingWhite();
+	for (int i = 0; i < 8; ++i) {
+		Object *tree = MakeTree(6);
+		MarkStack<Object*> gray_obj;
+		MarkStack<vm::Environment*> gray_env;
+		PushGray(&gray_obj, tree);
+		ASSERT_FALSE(marker.Mark(&gray_obj, &gray_env, white));
+		ASSERT_EQ((1U << 7) - 1, CountMarked(tree));
+	}
+	// Nothing to mark
+	MarkStack<Object*> gray_obj;
+	MarkStack<vm::Environment*> gray_env;
+	ASSERT_FALSE(marker.Mark(&gray_obj, &gray_env, white));
+	ASSERT_EQ(0U, marker.Scanned());
+}
+
+TEST_F(ParallelMarkerTest, Overflow) {
+	Object *tree = MakeTree(10);
+	MarkStack<Object*> gray_obj;
+	MarkStack<vm::Environment*> gray_env;
+	PushGray(&gray_obj, tree);
+
+	ParallelMarker marker(2, &symbols_);
+	marker.SetMarkStackLimit(2);
+	ASSERT_TRUE(marker.Mark(&gray_obj, &gray_env, MarkingWhite()));
+	ASSERT_GT((1U << 11) - 1, CountMarked(tree));
+}
+
+//
+// Marking throughput: 1 thread vs. 4 threads, it scales only if the
+// machine has the cores.
+//
+TEST_F(ParallelMarkerTest, Benchmark) {
+	unsigned white = MarkingWhite();
+	long long us[2];
+	int threads[2] = { 1, 4 };
+	for (int i = 0; i < 2; ++i) {
+		ParallelMarker marker(threads[i], &symbols_);
+		MarkStack<Object*> gray_obj;
+		MarkStack<vm::Environment*> gray_env;
+		PushGray(&gray_obj, MakeTree(18));
+		auto start = std::chrono::steady_clock::now();
+		marker.Mark(&gray_obj, &gray_env, white);
+		us[i] = std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start).count();
+	}
+	printf("1 thread: %lld us, 4 threads: %lld us, %d objects\n",
+			us[0], us[1], (1 << 19) - 1);
+}
+
+} // namespace values
+} // namespace ajimu
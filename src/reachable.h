@@ -2,25 +2,38 @@
 #define AJIMU_VALUES_REACHABLE_H
 
 #include "glog/logging.h"
+#include <stdint.h>
 
 namespace ajimu {
 namespace values {
 class ObjectManagement;
+class ObjectSpace;
+class ParallelMarker;
+class Sweeper;
 class StringPool;
 
 inline unsigned InvWhite(unsigned white);
 inline unsigned White(unsigned white);
 
-class Reachable {
+//
+// Color and generation bits of a gc one, packed in one word with the
+// type of object. Objects have no list link, they are found by pages.
+// In major gc objects are marked in the bitmaps of pages, their colors
+// are only changed by minor gc.
+//
+class GcHeader {
 public:
 	enum Flags {
+		FREE       = 0, // Free slot of object page, it's not an object.
 		WHITE_BIT0 = 1 << 0,
 		WHITE_BIT1 = 1 << 1,
 		WHITE_MASK = (WHITE_BIT0 | WHITE_BIT1),
 		BLACK = 1 << 2,
+		GRAY  = 1 << 3, // Marked, but children not be scanned yet.
+		PERMANENT = 1 << 4, // Sealed, never be marked or swept again.
 	};
 
-	~Reachable() {}
+	~GcHeader() {}
 
 	bool TestInvWhite(unsigned white) const {
 		return color_ == InvWhite(white);
@@ -34,45 +47,113 @@ public:
 		return (color_ == BLACK);
 	}
 
+	bool IsGray() const {
+		return (color_ == GRAY);
+	}
+
+	bool IsPermanent() const {
+		return (color_ == PERMANENT);
+	}
+
+	// Survived a minor gc, or allocated in marking of major gc.
+	bool IsOld() const {
+		return old_;
+	}
+
 	friend class ObjectManagement;
+	friend class ObjectSpace;
+	friend class ParallelMarker;
+	friend class Sweeper;
 	friend class StringPool;
 protected:
-	Reachable(Reachable *next, unsigned white)
-		: next_(next)
-		, color_(white) {
+	explicit GcHeader(unsigned white)
+		: color_(static_cast<uint8_t>(white))
+		, old_(false)
+		, remembered_(false) {
 		DCHECK(white == WHITE_BIT0 || white == WHITE_BIT1);
 	}
 
 private:
-	Reachable(const Reachable &) = delete;
-	void operator = (const Reachable &) = delete;
+	GcHeader(const GcHeader &) = delete;
+	void operator = (const GcHeader &) = delete;
 
 	void ToBlack() {
 		color_ = BLACK;
 	}
 
+	void ToGray() {
+		color_ = GRAY;
+	}
+
+	// The permanent ones are kept, sweeping never changes them.
 	void ToWhite(unsigned white) {
-		DCHECK(Reachable::WHITE_BIT0 == white ||
-				Reachable::WHITE_BIT1 == white);
-		color_ = white;
+		DCHECK(GcHeader::WHITE_BIT0 == white ||
+				GcHeader::WHITE_BIT1 == white);
+		if (color_ != PERMANENT)
+			color_ = static_cast<uint8_t>(white);
+	}
+
+	void ToPermanent() {
+		color_ = PERMANENT;
+		old_ = true;
+	}
+
+	// For marking by threads: Only one thread can shade the white one.
+	// Returns false if it has been shaded by others.
+	bool AtomicShade(unsigned white, unsigned color) {
+		uint8_t expected = static_cast<uint8_t>(white);
+		return __atomic_compare_exchange_n(&color_, &expected,
+				static_cast<uint8_t>(color), false, __ATOMIC_RELAXED,
+				__ATOMIC_RELAXED);
 	}
 
+	void AtomicToBlack() {
+		__atomic_store_n(&color_, static_cast<uint8_t>(BLACK),
+				__ATOMIC_RELAXED);
+	}
+
+	uint8_t color_;
+	bool old_;
+	bool remembered_; // Old one in remembered set, it points to young ones,
+	                  // or permanent one points to not permanent ones.
+}; // class GcHeader
+
+//
+// Environments and strings are linked in lists of their owner.
+//
+class Reachable : public GcHeader {
+public:
+	~Reachable() {}
+
+	friend class ObjectManagement;
+	friend class ObjectSpace;
+	friend class Sweeper;
+	friend class StringPool;
+protected:
+	Reachable(Reachable *next, unsigned white)
+		: GcHeader(white)
+		, next_(next) {
+	}
+
+private:
+	Reachable(const Reachable &) = delete;
+	void operator = (const Reachable &) = delete;
+
 	Reachable *next_;
-	unsigned color_;
 }; // class Reachable
 
 inline unsigned InvWhite(unsigned white) {
-	DCHECK(Reachable::WHITE_BIT0 == white ||
-			Reachable::WHITE_BIT1 == white);
+	DCHECK(GcHeader::WHITE_BIT0 == white ||
+			GcHeader::WHITE_BIT1 == white);
 
-	return (white == Reachable::WHITE_BIT0) ?
-		Reachable::WHITE_BIT1 :
-		Reachable::WHITE_BIT0;
+	return (white == GcHeader::WHITE_BIT0) ?
+		GcHeader::WHITE_BIT1 :
+		GcHeader::WHITE_BIT0;
 }
 
 inline unsigned White(unsigned white) {
-	DCHECK(Reachable::WHITE_BIT0 == white ||
-			Reachable::WHITE_BIT1 == white);
+	DCHECK(GcHeader::WHITE_BIT0 == white ||
+			GcHeader::WHITE_BIT1 == white);
 	return white;
 }
 
@@ -36,14 +36,6 @@ static const char *kDesc = \
 "Ajimu scheme shell.\n"
 "Ctrl+D or Ctrl+C for exit.\n";
 
-void *PrimitiveMethod2Pv(values::PrimitiveMethodPtr ptr) {
-	union {
-		values::PrimitiveMethodPtr pfn;
-		void *pv;
-	};
-	pfn = ptr; return pv;
-}
-
 ReplApplication::ReplApplication()
 	: color_mode_(AUTO)
 	, mach_(new vm::Mach())
@@ -124,11 +116,11 @@ const char *ReplApplication::Paint(const char *esc) {
 
 void ReplApplication::Print(values::Object *o) {
 	bool rest = false;
-	switch (o->OwnedType()) {
+	switch (values::Object::TypeOf(o)) {
 	case values::BOOLEAN:
 		fprintf(output_, "%s%s%s",
 				Paint(cDARK_RED),
-				o->Boolean() ? "#t" : "#f",
+				values::Object::Boolean(o) ? "#t" : "#f",
 				Paint(cEND));
 		break;
 	case values::SYMBOL:
@@ -140,7 +132,7 @@ void ReplApplication::Print(values::Object *o) {
 	case values::FIXED:
 		fprintf(output_, "%s%lld%s",
 				Paint(cDARK_AZURE),
-				o->Fixed(),
+				values::Object::Fixed(o),
 				Paint(cEND));
 		break;
 	case values::REAL:
@@ -152,7 +144,7 @@ void ReplApplication::Print(values::Object *o) {
 	case values::CHARACTER:
 		fprintf(output_, "%s#%c%s",
 				Paint(cDARK_RED),
-				o->Character(),
+				values::Object::Character(o),
 				Paint(cEND));
 		break;
 	case values::STRING:
@@ -190,11 +182,15 @@ void ReplApplication::Print(values::Object *o) {
 		Print(o->Body());
 		break;
 	case values::PRIMITIVE:
-		fprintf(output_, "%s<primitive:%p>%s",
+		fprintf(output_, "%s<primitive:%s>%s",
 				Paint(cDARK_YELLOW),
-				PrimitiveMethod2Pv(o->Primitive()),
+				o->Primitive()->name,
 				Paint(cEND));
 		break;
+	case values::CONTINUATION:
+		fprintf(output_, "%s<continuation>%s",
+				Paint(cDARK_YELLOW), Paint(cEND));
+		break;
 	}
 }
 
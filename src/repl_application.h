@@ -40,6 +40,10 @@ public:
 		output_ = DCHECK_NOTNULL(fp);
 	}
 
+	vm::Mach *Mach() const {
+		return mach_.get();
+	}
+
 	values::Object *Load(const char *lib);
 
 	int Run();
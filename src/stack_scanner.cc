@@ -0,0 +1,25 @@
+#include "stack_scanner.h"
+#include "glog/logging.h"
+#include <pthread.h>
+
+namespace ajimu {
+namespace values {
+
+StackScanner::StackScanner()
+	: base_(0)
+	, limit_(0) {
+	pthread_attr_t attr;
+	void *addr = nullptr;
+	size_t size = 0;
+	if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+		LOG(FATAL) << "Can not get the stack of thread.";
+		return;
+	}
+	pthread_attr_getstack(&attr, &addr, &size);
+	pthread_attr_destroy(&attr);
+	base_  = reinterpret_cast<uintptr_t>(addr) + size;
+	limit_ = reinterpret_cast<uintptr_t>(addr);
+}
+
+} // namespace values
+} // namespace ajimu
@@ -0,0 +1,70 @@
+#ifndef AJIMU_VALUES_STACK_SCANNER_H
+#define AJIMU_VALUES_STACK_SCANNER_H
+
+#include <stdint.h>
+
+#if defined(__clang__) || defined(__GNUC__)
+#define AJIMU_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#define AJIMU_NOINLINE __attribute__((noinline))
+#else
+#define AJIMU_NO_SANITIZE_ADDRESS
+#define AJIMU_NOINLINE
+#endif
+
+namespace ajimu {
+namespace values {
+
+//
+// Conservative scanning of the native stack of one thread. Every aligned
+// word from the frame of caller to the base of stack, and the registers,
+// be treated as a possible pointer; the callback must check it.
+//
+// Only the thread be created it can scan.
+//
+class StackScanner {
+public:
+	// Bounds of the stack of current thread.
+	StackScanner();
+
+	uintptr_t Base() const {
+		return base_;
+	}
+
+	// The lowest address of stack, it can not grow over it.
+	uintptr_t Limit() const {
+		return limit_;
+	}
+
+	// Not inlined, so all frames of callers are above this one.
+	template<class Callback>
+	AJIMU_NOINLINE
+	void Scan(Callback callback) const {
+		// Spill the callee saved registers into this frame, they are
+		// above the locals.
+		__builtin_unwind_init();
+		uintptr_t top = 0;
+		ScanRange(&top, reinterpret_cast<const uintptr_t *>(base_),
+				callback);
+	}
+
+private:
+	StackScanner(const StackScanner &) = delete;
+	void operator = (const StackScanner &) = delete;
+
+	// The words between frames may be poisoned by address sanitizer.
+	template<class Callback>
+	AJIMU_NO_SANITIZE_ADDRESS
+	static void ScanRange(const uintptr_t *begin, const uintptr_t *end,
+			Callback callback) {
+		for (const uintptr_t *i = begin; i < end; ++i)
+			callback(*i);
+	}
+
+	uintptr_t base_; // The stack grows down from it
+	uintptr_t limit_;
+}; // class StackScanner
+
+} // namespace values
+} // namespace ajimu
+
+#endif //AJIMU_VALUES_STACK_SCANNER_H
@@ -0,0 +1,24 @@
+#include "stack_scanner.h"
+#include "gmock/gmock.h"
+
+namespace ajimu {
+namespace values {
+
+TEST(StackScannerTest, Sanity) {
+	StackScanner scanner;
+	int local = 0;
+	ASSERT_LT(reinterpret_cast<uintptr_t>(&local), scanner.Base());
+	ASSERT_GT(reinterpret_cast<uintptr_t>(&local), scanner.Limit());
+
+	// The value be held in frame of caller.
+	volatile uintptr_t held = 0x5a5a5a5a5a5a5a50ULL;
+	bool found = false;
+	scanner.Scan([&found, &held] (uintptr_t word) {
+		if (word == held)
+			found = true;
+	});
+	ASSERT_TRUE(found);
+}
+
+} // namespace values
+} // namespace ajimu
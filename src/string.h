@@ -2,6 +2,7 @@
 #define AJIMU_VALUES_STRING_H
 
 #include "reachable.h"
+#include "heap.h"
 #include "glog/logging.h"
 #include <stddef.h>
 #include <string.h>
@@ -58,6 +59,12 @@ public:
 		return New(naked, strlen(naked), next, white);
 	}
 
+	static String *New(Heap *heap, const char *naked, size_t len,
+			Reachable *next, unsigned white) {
+		void *blob = heap->Allocate(sizeof(String) + len + 1);
+		return ::new (blob) String(naked, len, next, white);
+	}
+
 	static size_t Delete(const String *o) {
 		union {
 			const char   *raw;
@@ -70,6 +77,13 @@ public:
 		return rv;
 	}
 
+	static size_t Delete(Heap *heap, const String *o) {
+		size_t rv = o->Allocated();
+		o->~String();
+		heap->Free(const_cast<String *>(o), rv + 1);
+		return rv;
+	}
+
 	static size_t ToHash(const char *z, size_t len) {
 		size_t n = 1315423911U;
 		while(len--)
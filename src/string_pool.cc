@@ -1,12 +1,14 @@
 #include "string_pool.h"
 #include "string.h"
 #include "reachable.h"
+#include "heap.h"
 
 namespace ajimu {
 namespace values {
 
-StringPool::StringPool()
-	: slot_(nullptr)
+StringPool::StringPool(Heap *heap)
+	: heap_(DCHECK_NOTNULL(heap))
+	, slot_(nullptr)
 	, large_list_(nullptr)
 	, shift_(8)
 	, used_(0)
@@ -24,7 +26,7 @@ StringPool::~StringPool() {
 			while (x) {
 				p = x;
 				x = x->next_;
-				String::Delete(static_cast<String*>(p));
+				String::Delete(heap_, static_cast<String*>(p));
 				--used_;
 			}
 		}
@@ -37,14 +39,14 @@ StringPool::~StringPool() {
 	while (i) {
 		p = i;
 		i = i->next_;
-		String::Delete(static_cast<String*>(p));
+		String::Delete(heap_, static_cast<String*>(p));
 	}
 }
 
 String *StringPool::NewString(const char *raw, size_t len,
 		unsigned white) {
 	if (len > String::MAX_POOL_STRING_LEN) {
-		String *rv = String::New(raw, len, large_list_, white);
+		String *rv = String::New(heap_, raw, len, large_list_, white);
 		allocated_ += rv->Allocated();
 		large_list_ = rv;
 		return rv;
@@ -54,8 +56,12 @@ String *StringPool::NewString(const char *raw, size_t len,
 	Reachable *list = slot_[String::ToHash(raw, len) % SlotSize()];
 	for (Reachable *i = list; i != nullptr; i = i->next_) {
 		String *x = static_cast<String *>(i);
-		if (x->Length() == len && x->Equal(raw, len))
+		if (x->Length() == len && x->Equal(raw, len)) {
+			// Revive it, may be not marked in this cycle.
+			if (x->TestInvWhite(white))
+				x->ToWhite(white);
 			return x;
+		}
 	}
 	return Append(raw, len, white);
 }
@@ -65,7 +71,7 @@ String *StringPool::Append(const char *raw, size_t len, unsigned white) {
 		Resize(shift_ + 1);
 	size_t hash = String::ToHash(raw, len);
 	Reachable **list = slot_ + hash % SlotSize();
-	String *o = String::New(raw, len, *list, white);
+	String *o = String::New(heap_, raw, len, *list, white);
 	allocated_ += o->Allocated();
 	*list = o;
 	++used_;
@@ -100,11 +106,12 @@ void StringPool::Copy2(Reachable **slot, Reachable *x, int shift) {
 
 int StringPool::Sweep(unsigned white) {
 	int sweeped = 0;
+	size_t visited = 0;
 
 	// Sweep the large strings:
 	if (large_list_) {
 		Reachable prev(large_list_, white);
-		sweeped += DoSweep(large_list_, &prev, white);
+		sweeped += DoSweep(large_list_, &prev, white, &visited);
 		large_list_ = prev.next_;
 	}
 
@@ -114,7 +121,7 @@ int StringPool::Sweep(unsigned white) {
 		if (!*i)
 			continue;
 		Reachable prev(*i, white);
-		int rv = DoSweep(*i, &prev, white);
+		int rv = DoSweep(*i, &prev, white, &visited);
 		used_ -= rv;
 		sweeped += rv;
 		*i = prev.next_;
@@ -122,15 +129,46 @@ int StringPool::Sweep(unsigned white) {
 	return sweeped;
 }
 
+//
+// The pool may be resized between two steps, strings be moved to the
+// swept buckets are swept in next cycle. It's safe, they are still white.
+//
+bool StringPool::Sweep(unsigned white, int *cursor, size_t quantum,
+		int *sweeped) {
+	size_t visited = 0;
+	*sweeped = 0;
+	if (*cursor == kLargeListCursor) {
+		if (large_list_) {
+			Reachable prev(large_list_, white);
+			*sweeped += DoSweep(large_list_, &prev, white, &visited);
+			large_list_ = prev.next_;
+		}
+		++*cursor;
+	}
+	while (visited < quantum && *cursor < SlotSize()) {
+		Reachable **i = slot_ + (*cursor)++;
+		if (!*i)
+			continue;
+		Reachable prev(*i, white);
+		int rv = DoSweep(*i, &prev, white, &visited);
+		used_ -= rv;
+		*sweeped += rv;
+		*i = prev.next_;
+	}
+	return *cursor >= SlotSize();
+}
+
 //
 // x: header node
 // p: prev   node
-int StringPool::DoSweep(Reachable *x, Reachable *p, unsigned white) {
+int StringPool::DoSweep(Reachable *x, Reachable *p, unsigned white,
+		size_t *visited) {
 	int sweeped = 0;
 	while (x) {
+		++*visited;
 		if (x->TestInvWhite(white)) {
 			p->next_ = x->next_;
-			allocated_ -= String::Delete(static_cast<String*>(x));
+			allocated_ -= String::Delete(heap_, static_cast<String*>(x));
 			++sweeped;
 			x = p->next_;
 		} else {
@@ -8,10 +8,15 @@ namespace ajimu {
 namespace values {
 class String;
 class Reachable;
+class Heap;
 
 class StringPool {
 public:
-	StringPool();
+	enum {
+		kLargeListCursor = -1, // Sweeping starts from the large strings
+	};
+
+	explicit StringPool(Heap *heap);
 
 	~StringPool();
 
@@ -39,6 +44,13 @@ public:
 
 	int Sweep(unsigned white);
 
+	// Sweep incrementally, buckets be swept one by one until quantum
+	// strings be visited.
+	// cursor:  The next bucket to sweep, kLargeListCursor at beginning.
+	// sweeped: Number of strings be freed in this step.
+	// Returns true if all buckets be swept.
+	bool Sweep(unsigned white, int *cursor, size_t quantum, int *sweeped);
+
 private:
 	StringPool(const StringPool &) = delete;
 	void operator = (const StringPool &) = delete;
@@ -51,8 +63,10 @@ private:
 		return rv;
 	}
 
-	int DoSweep(Reachable *head, Reachable *prev, unsigned white);
+	int DoSweep(Reachable *head, Reachable *prev, unsigned white,
+			size_t *visited);
 
+	Heap *heap_;
 	Reachable **slot_;
 	Reachable *large_list_;
 	int shift_;
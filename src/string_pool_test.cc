@@ -2,6 +2,7 @@
 #include "string.h"
 #include "gmock/gmock.h"
 #include "reachable.h"
+#include "heap.h"
 
 namespace ajimu {
 namespace values {
@@ -10,14 +11,18 @@ class StringPoolTest : public ::testing::Test {
 protected:
 	virtual void SetUp() override {
 		srand(time(0));
-		pool_ = new StringPool();
+		heap_ = new Heap();
+		pool_ = new StringPool(heap_);
 	}
 
 	virtual void TearDown() override {
 		delete pool_;
 		pool_ = nullptr;
+		delete heap_;
+		heap_ = nullptr;
 	}
 
+	Heap *heap_;
 	StringPool *pool_;
 };
 
@@ -123,6 +128,32 @@ TEST_F(StringPoolTest, Sweeping) {
 	ASSERT_EQ(2, pool_->Sweep(Reachable::WHITE_BIT1));
 }
 
+TEST_F(StringPoolTest, ReviveInterned) {
+	String *s = pool_->NewString("revived", Reachable::WHITE_BIT0);
+	// Interned again in next cycle, it must not be swept.
+	ASSERT_EQ(s, pool_->NewString("revived", Reachable::WHITE_BIT1));
+	ASSERT_EQ(0, pool_->Sweep(Reachable::WHITE_BIT1));
+	ASSERT_STREQ("revived", s->c_str());
+}
+
+TEST_F(StringPoolTest, IncrementalSweeping) {
+	char buf[32];
+	for (int i = 0; i < 100; ++i) {
+		snprintf(buf, sizeof(buf), "s-%d", i);
+		pool_->NewString(buf, Reachable::WHITE_BIT0);
+	}
+	int cursor = StringPool::kLargeListCursor, sweeped, total = 0, steps = 0;
+	bool done = false;
+	while (!done) {
+		done = pool_->Sweep(Reachable::WHITE_BIT1, &cursor, 1, &sweeped);
+		total += sweeped;
+		++steps;
+	}
+	ASSERT_EQ(100, total);
+	ASSERT_LT(1, steps);
+	ASSERT_EQ(0U, pool_->HashedCount());
+}
+
 const char *kSweepingValues[] = {
 	"a",
 	"b",
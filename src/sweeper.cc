@@ -0,0 +1,136 @@
+#include "sweeper.h"
+#include "environment.h"
+#include "glog/logging.h"
+
+namespace ajimu {
+namespace values {
+
+using vm::Environment;
+
+Sweeper::Result::Result()
+	: free_head(nullptr)
+	, free_tail(nullptr)
+	, envs(nullptr)
+	, envs_tail(nullptr)
+	, pages_swept(0)
+	, objects_swept(0)
+	, object_bytes_swept(0)
+	, envs_swept(0)
+	, env_bytes_swept(0) {
+}
+
+Sweeper::Sweeper()
+	: pages_(nullptr)
+	, envs_(nullptr)
+	, white_(Reachable::WHITE_BIT0)
+	, sweeping_(false)
+	, done_(false) {
+}
+
+Sweeper::~Sweeper() {
+	if (thread_.joinable())
+		thread_.join();
+}
+
+void Sweeper::Start(ObjectSpace::Page *pages, Reachable *envs,
+		unsigned white) {
+	DCHECK(!sweeping_);
+	pages_ = pages;
+	envs_  = envs;
+	white_ = white;
+	sweeping_ = true;
+	done_ = false;
+	thread_ = std::thread([this] () { Run(); });
+}
+
+bool Sweeper::Take(Result *result, bool wait) {
+	DCHECK(sweeping_);
+	bool done;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (wait)
+			done_cv_.wait(lock, [this] () { return done_; });
+		*result = std::move(pending_);
+		pending_ = Result();
+		done = done_;
+	}
+	if (done) {
+		thread_.join();
+		sweeping_ = false;
+	}
+	return done;
+}
+
+void Sweeper::Run() {
+	for (ObjectSpace::Page *page = pages_; page; page = page->next)
+		SweepPage(page);
+	SweepEnvironments();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	done_ = true;
+	done_cv_.notify_all();
+}
+
+void Sweeper::SweepPage(ObjectSpace::Page *page) {
+	Object *head = nullptr, *tail = nullptr;
+	size_t swept = 0;
+	// Link all free slots of page again, the marked ones are not touched.
+	ObjectSpace::ForEachUnmarked(page, [&] (Object *o) {
+		if (o->IsPermanent())
+			return;
+		if (!ObjectSpace::IsFree(o)) {
+			o->~Object();
+			++swept;
+		}
+		o->color_ = Reachable::FREE;
+		o->next_free_ = head;
+		head = o;
+		if (!tail)
+			tail = o;
+	});
+	ObjectSpace::ClearMarks(page);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (head) {
+		tail->next_free_ = pending_.free_head;
+		pending_.free_head = head;
+		if (!pending_.free_tail)
+			pending_.free_tail = tail;
+	}
+	++pending_.pages_swept;
+	pending_.objects_swept += swept;
+	pending_.object_bytes_swept += swept * sizeof(Object);
+}
+
+void Sweeper::SweepEnvironments() {
+	Reachable *head = nullptr, *tail = nullptr, *next;
+	std::vector<std::pair<void*, size_t>> dead;
+	size_t bytes = 0;
+	for (Reachable *x = envs_; x; x = next) {
+		next = x->next_;
+		if (x->TestInvWhite(white_)) {
+			Environment *env = static_cast<Environment *>(x);
+			size_t size = env->AllocatedSize();
+			env->~Environment();
+			dead.push_back(std::make_pair(static_cast<void *>(env), size));
+			bytes += size;
+		} else {
+			x->ToWhite(white_);
+			x->next_ = head;
+			head = x;
+			if (!tail)
+				tail = x;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	pending_.envs = head;
+	pending_.envs_tail = tail;
+	pending_.envs_swept += dead.size();
+	pending_.env_bytes_swept += bytes;
+	pending_.dead_envs.insert(pending_.dead_envs.end(), dead.begin(),
+			dead.end());
+}
+
+} // namespace values
+} // namespace ajimu
@@ -0,0 +1,95 @@
+#ifndef AJIMU_VALUES_SWEEPER_H
+#define AJIMU_VALUES_SWEEPER_H
+
+#include "object_space.h"
+#include <vector>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace ajimu {
+namespace values {
+
+//
+// Sweeping the object pages and the old environments by a background
+// thread, after marking. The mutator keeps running, it shares nothing
+// with the sweeper but the results:
+//
+// - The free list of space be reset before starting, the mutator only
+//   allocates in new pages or the swept ones be taken.
+// - The environment list be detached, the survivors be taken at the end.
+// - The dead environments are destroyed, but the chunks must be freed by
+//   the owner of heap.
+// - The dead symbols must be dropped from the symbol table before
+//   starting, the table is owned by mutator.
+// - The marked objects are never touched, only the bitmaps of pages.
+//
+class Sweeper {
+public:
+	struct Result {
+		Result();
+
+		// Free slots of swept pages
+		Object *free_head;
+		Object *free_tail;
+
+		// Chunks of destroyed environments, and their size
+		std::vector<std::pair<void*, size_t>> dead_envs;
+
+		// Survived environments, only be set at the end of sweeping
+		Reachable *envs;
+		Reachable *envs_tail;
+
+		size_t pages_swept;
+		size_t objects_swept;
+		size_t object_bytes_swept;
+		size_t envs_swept;
+		size_t env_bytes_swept;
+	};
+
+	Sweeper();
+
+	~Sweeper();
+
+	// Started but the end not be taken.
+	bool Sweeping() const {
+		return sweeping_;
+	}
+
+	// pages: Sweep from it to the end of page list.
+	// envs:  Detached list of old environments.
+	// white: Current white, the environments of last white are dead.
+	void Start(ObjectSpace::Page *pages, Reachable *envs, unsigned white);
+
+	// Take the results be done since last taking.
+	// wait: Wait for the end of sweeping.
+	// Returns true if sweeping be finished.
+	bool Take(Result *result, bool wait);
+
+private:
+	Sweeper(const Sweeper &) = delete;
+	void operator = (const Sweeper &) = delete;
+
+	void Run();
+
+	void SweepPage(ObjectSpace::Page *page);
+
+	void SweepEnvironments();
+
+	ObjectSpace::Page *pages_;
+	Reachable *envs_;
+	unsigned white_;
+	bool sweeping_;
+	std::thread thread_;
+
+	std::mutex mutex_;
+	std::condition_variable done_cv_;
+	Result pending_;
+	bool done_;
+}; // class Sweeper
+
+} // namespace values
+} // namespace ajimu
+
+#endif //AJIMU_VALUES_SWEEPER_H